@@ -0,0 +1,96 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package main
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"mhs/src/monorail"
+	"os"
+	"path/filepath"
+	"strings"
+)
+
+// config describes the hansoft database, and the pairs of projects to keep in
+// sync
+type config struct {
+	Hansoft struct {
+		Address  string
+		Port     int
+		Database string
+	}
+	Projects []projectConfig
+	// Maximum number of project pairs synchronized at the same time
+	MaxConcurrent int
+}
+
+// projectConfig is a single monorail project to hansoft project mapping
+type projectConfig struct {
+	Monorail string // Name of the monorail project
+	Hansoft  string // Name of the hansoft project. Case insensitive.
+	// Additional monorail fields and labels synchronized to hansoft custom
+	// columns
+	Columns monorail.Mapping
+}
+
+// defaultConfig is used when there is no config file
+func defaultConfig() config {
+	cfg := config{
+		Projects:      []projectConfig{{Monorail: "tint", Hansoft: "tint"}},
+		MaxConcurrent: 1,
+	}
+	cfg.Hansoft.Address = "localhost"
+	cfg.Hansoft.Port = 50256
+	cfg.Hansoft.Database = "Tint"
+	return cfg
+}
+
+// loadConfig loads the config file at path, returning defaultConfig() if the
+// file does not exist
+func loadConfig(path string) (config, error) {
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return defaultConfig(), nil
+		}
+		return config{}, fmt.Errorf("Failed to load '%v': %w", path, err)
+	}
+	cfg := defaultConfig()
+	cfg.Projects = nil
+	cfg.MaxConcurrent = 0
+	if err := json.NewDecoder(bytes.NewReader(body)).Decode(&cfg); err != nil {
+		return config{}, fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	if len(cfg.Projects) == 0 {
+		return config{}, fmt.Errorf("'%v' does not list any projects", path)
+	}
+	if cfg.MaxConcurrent <= 0 {
+		cfg.MaxConcurrent = len(cfg.Projects)
+	}
+	return cfg, nil
+}
+
+// projectPath returns the path of the per-project file for the given project,
+// by inserting the project name before the extension of path.
+// An empty path is returned unmodified.
+func projectPath(path string, p projectConfig) string {
+	if path == "" {
+		return ""
+	}
+	ext := filepath.Ext(path)
+	return strings.TrimSuffix(path, ext) + "." + p.Monorail + ext
+}
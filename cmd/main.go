@@ -17,13 +17,48 @@ package main
 import (
 	"bytes"
 	"encoding/json"
+	"flag"
 	"fmt"
 	"io/ioutil"
+	"log"
 	"mhs/src/hansoft"
 	"mhs/src/monorail"
 	"mhs/src/projectsync"
 	"os"
+	"os/signal"
 	"strings"
+	"sync"
+	"syscall"
+	"time"
+)
+
+var (
+	daemon    = flag.Bool("daemon", false, "keep running, synchronizing the projects periodically and when hansoft changes")
+	interval  = flag.Duration("interval", 5*time.Minute, "maximum time between synchronizations in daemon mode")
+	debounce  = flag.Duration("debounce", 10*time.Second, "delay between a hansoft change and the synchronization in daemon mode")
+	metrics   = flag.String("metrics-address", "", "address to serve the hansoft SDK call and monorail RPC statistics (/debug/vars), the synchronization phase breakdowns (/debug/cycles) and the profiler (/debug/pprof/) on in daemon mode, such as localhost:8080. Empty disables the listener")
+	callStats = flag.Bool("call-stats", false, "print the hansoft SDK call and monorail RPC statistics at the end of a one-shot run")
+	chunkSize = flag.Int("chunk-size", 0, "number of issues reconciled at a time, bounding memory use on large projects. 0 reconciles all the issues at once")
+	writeBack = flag.Bool("write-back", false, "write fields changed in hansoft back to monorail, unless monorail changed them more recently")
+
+	monorailCache    = flag.String("monorail-cache", "", "path to the monorail issue cache used for incremental fetches, such as monorail-cache.json. Empty, the default, disables incremental fetches")
+	fullScanInterval = flag.Duration("full-scan-interval", 24*time.Hour, "maximum time between full scans of the monorail project, full reads of the hansoft tasks, and rebuilds of the hansoft task index")
+	fullScan         = flag.Bool("full-scan", false, "perform a full scan of the monorail project, ignoring the cached issues, and rebuild the hansoft task index")
+
+	fingerprintStore     = flag.String("fingerprints", "fingerprints.bin", "path to the store of the last synchronized state of each issue, used to skip reading unchanged hansoft tasks after the first sync. Empty disables the store")
+	taskIndex            = flag.String("task-index", "hansoft-task-index.gob", "path to the index of hansoft tasks linked to monorail issues, used to avoid reading every task's hyperlink. Empty disables the index")
+	hansoftMetadataCache = flag.String("hansoft-metadata-cache", "", "path to the hansoft project metadata snapshot used to speed up startup, such as hansoft-metadata.gob. Empty, the default, disables the snapshot")
+	monorailFieldCache   = flag.String("monorail-field-cache", "", "path to the monorail field definition cache, such as monorail-fields.json. Empty, the default, disables the cache")
+	nonBlocking          = flag.Bool("non-blocking", false, "issue hansoft writes without waiting for each to complete, waiting for them all at the end of each synchronization")
+	sessions             = flag.Int("sessions", 1, "number of hansoft connections used to spread batched reads")
+	metadataMaxAge       = flag.Duration("metadata-max-age", 24*time.Hour, "maximum age of the hansoft metadata snapshot and monorail field cache")
+	monorailUserCache    = flag.String("monorail-user-cache", "monorail-users.json", "path to the monorail user email cache. Empty disables the persistent cache")
+	userCacheTTL         = flag.Duration("user-cache-ttl", 7*24*time.Hour, "maximum age of a cached monorail user email address")
+	monorailRate         = flag.Float64("monorail-rate", monorail.DefaultLimits.Rate, "maximum number of monorail requests per second. 0 disables the rate limit")
+	monorailConcurrency  = flag.Int("monorail-concurrency", monorail.DefaultLimits.MaxConcurrency, "maximum number of monorail requests in flight. The limit is halved on quota or deadline errors, and recovers gradually")
+	monorailRetries      = flag.Int("monorail-retries", monorail.DefaultLimits.Retries, "maximum number of retries of a monorail read that failed with a transient error")
+
+	configPath = flag.String("config", "sync-config.json", "path to the JSON file listing the hansoft database and the project pairs to synchronize. If the file does not exist, the tint projects are synchronized")
 )
 
 type hansoftAuth struct {
@@ -32,6 +67,7 @@ type hansoftAuth struct {
 }
 
 func main() {
+	flag.Parse()
 	if err := run(); err != nil {
 		fmt.Println(err)
 		os.Exit(1)
@@ -39,20 +75,27 @@ func main() {
 }
 
 func run() error {
-	ha, err := loadHansoftAuth("hansoft-auth.json")
+	cfg, err := loadConfig(*configPath)
 	if err != nil {
 		return err
 	}
 
-	m, err := monorail.New("monorail-auth.json")
+	ha, err := loadHansoftAuth("hansoft-auth.json")
 	if err != nil {
 		return err
 	}
 
-	monorailTint, err := m.Project("tint")
+	limits := monorail.DefaultLimits
+	limits.Rate, limits.MaxConcurrency, limits.Retries = *monorailRate, *monorailConcurrency, *monorailRetries
+	m, err := monorail.New("monorail-auth.json", limits)
 	if err != nil {
 		return err
 	}
+	if *monorailUserCache != "" {
+		if err := m.LoadUsers(*monorailUserCache, *userCacheTTL); err != nil {
+			log.Printf("Ignoring monorail user cache: %v\n", err)
+		}
+	}
 
 	h, err := hansoft.New()
 	if err != nil {
@@ -61,36 +104,292 @@ func run() error {
 	// TODO(bclayton) - Attempting to destroy the hansoft instance crashes in the .so. Investigate.
 	// defer h.Destroy()
 
-	hansoftSession, err := h.Connect("localhost", 50256, "Tint", ha.User, ha.Password)
+	hansoftSession, err := h.ConnectPool(cfg.Hansoft.Address, cfg.Hansoft.Port, cfg.Hansoft.Database, ha.User, ha.Password, *sessions, !*nonBlocking)
 	if err != nil {
 		return err
 	}
 	// TODO(bclayton) - Attempting to destroy the hansoft session crashes in the .so. Investigate.
 	// defer hansoftSession.Destroy()
 
-	hansoftTint, err := hansoftTintProject(hansoftSession)
+	hansoftProjects, err := hansoftSession.Projects()
 	if err != nil {
 		return err
 	}
 
-	if err := projectsync.Sync(monorailTint, hansoftTint); err != nil {
+	pairs := make([]*projectPair, len(cfg.Projects))
+	for i, pc := range cfg.Projects {
+		pair, err := newProjectPair(pc, m, hansoftProjects)
+		if err != nil {
+			return err
+		}
+		pairs[i] = pair
+	}
+
+	sched := &scheduler{
+		monorail: m,
+		session:  hansoftSession,
+		slots:    cfg.MaxConcurrent,
+	}
+	if !*daemon {
+		err := sched.syncAll(pairs)
+		if *callStats {
+			printCallStats(os.Stdout, h.CallStats())
+			printRPCStats(os.Stdout, m.RPCStats())
+		}
 		return err
 	}
+	if *metrics != "" {
+		serveMetrics(*metrics, h, m, pairs)
+	}
+	return sched.runDaemon(pairs)
+}
 
-	return nil
+// projectPair is a monorail project and the hansoft project it is synchronized
+// with
+type projectPair struct {
+	name   string
+	h      hansoft.Project
+	syncer *projectsync.Syncer
+
+	metadataCache string // Path of the hansoft metadata snapshot
+	fingerprints  string // Path of the fingerprint store
+	taskIndex     string // Path of the hansoft task index
 }
 
-func hansoftTintProject(s hansoft.Session) (hansoft.Project, error) {
-	projects, err := s.Projects()
+func newProjectPair(pc projectConfig, m monorail.Monorail, hansoftProjects []hansoft.Project) (*projectPair, error) {
+	var mp monorail.Project
+	var err error
+	if path := projectPath(*monorailFieldCache, pc); path != "" {
+		mp, err = m.ProjectCached(pc.Monorail, pc.Columns, path, *metadataMaxAge)
+	} else {
+		mp, err = m.Project(pc.Monorail, pc.Columns)
+	}
 	if err != nil {
 		return nil, err
 	}
-	for _, p := range projects {
-		if strings.ToLower(p.Name()) == "tint" {
-			return p, nil
+	path := projectPath(*monorailCache, pc)
+	if path != "" && *chunkSize > 0 {
+		log.Printf("[%v] Ignoring the monorail issue cache, which cannot be used with -chunk-size\n", pc.Monorail)
+		path = ""
+	}
+	if path != "" {
+		incremental := monorail.NewIncremental(mp, path, *fullScanInterval)
+		if *fullScan {
+			incremental.ForceFullScan()
+		}
+		mp = incremental
+	}
+
+	var hp hansoft.Project
+	for _, p := range hansoftProjects {
+		if strings.EqualFold(p.Name(), pc.Hansoft) {
+			hp = p
+			break
+		}
+	}
+	if hp == nil {
+		return nil, fmt.Errorf("Couldn't find the %v hansoft project", pc.Hansoft)
+	}
+
+	pair := &projectPair{
+		name:          pc.Monorail,
+		h:             hp,
+		metadataCache: projectPath(*hansoftMetadataCache, pc),
+		fingerprints:  projectPath(*fingerprintStore, pc),
+		taskIndex:     projectPath(*taskIndex, pc),
+	}
+	if pair.metadataCache != "" {
+		loaded, err := hp.LoadMetadata(pair.metadataCache, *metadataMaxAge)
+		switch {
+		case err != nil:
+			log.Printf("[%v] Ignoring hansoft metadata snapshot: %v\n", pair.name, err)
+		case loaded:
+			log.Printf("[%v] Loaded hansoft metadata from '%v'\n", pair.name, pair.metadataCache)
+		}
+	}
+	pair.syncer = projectsync.New(mp, hp)
+	pair.syncer.SetWriteBack(*writeBack)
+	pair.syncer.SetChunkSize(*chunkSize)
+	if pair.fingerprints != "" {
+		if err := pair.syncer.LoadFingerprints(pair.fingerprints, *fullScanInterval); err != nil {
+			log.Printf("[%v] Ignoring fingerprint store: %v\n", pair.name, err)
+		}
+	}
+	if pair.taskIndex != "" {
+		if err := pair.syncer.LoadTaskIndex(pair.taskIndex, *fullScanInterval); err != nil {
+			log.Printf("[%v] Ignoring hansoft task index: %v\n", pair.name, err)
+		}
+		if *fullScan {
+			pair.syncer.RebuildTaskIndex()
+		}
+	}
+	return pair, nil
+}
+
+// saveState writes the hansoft metadata snapshot, the fingerprint store and
+// the task index, if enabled
+func (p *projectPair) saveState() {
+	if p.metadataCache != "" {
+		if err := p.h.SaveMetadata(p.metadataCache); err != nil {
+			log.Printf("[%v] Failed to write hansoft metadata snapshot: %v\n", p.name, err)
+		}
+	}
+	if p.fingerprints != "" {
+		if err := p.syncer.SaveFingerprints(p.fingerprints); err != nil {
+			log.Printf("[%v] Failed to write fingerprint store: %v\n", p.name, err)
 		}
 	}
-	return nil, fmt.Errorf("Couldn't find the tint hansoft project")
+	if p.taskIndex != "" {
+		if err := p.syncer.SaveTaskIndex(p.taskIndex); err != nil {
+			log.Printf("[%v] Failed to write hansoft task index: %v\n", p.name, err)
+		}
+	}
+}
+
+// scheduler synchronizes project pairs, running at most slots at a time.
+// Waiting pairs are queued, and granted a slot in the order they asked for
+// one, so a large project cannot starve the others.
+type scheduler struct {
+	monorail monorail.Monorail
+	session  hansoft.Session
+	slots    int
+
+	mutex   sync.Mutex
+	running int
+	waiting []chan struct{} // Closed when the waiting pair is granted a slot
+}
+
+// acquire blocks until a slot is granted to the caller
+func (s *scheduler) acquire() {
+	s.mutex.Lock()
+	if s.running < s.slots && len(s.waiting) == 0 {
+		s.running++
+		s.mutex.Unlock()
+		return
+	}
+	granted := make(chan struct{})
+	s.waiting = append(s.waiting, granted)
+	s.mutex.Unlock()
+	<-granted
+}
+
+// release passes the caller's slot to the longest waiting pair, if any
+func (s *scheduler) release() {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	if len(s.waiting) > 0 {
+		close(s.waiting[0])
+		s.waiting = s.waiting[1:]
+		return
+	}
+	s.running--
+}
+
+// sync performs a single synchronization of the pair, waiting for a free slot
+// and for the pair's hansoft writes to complete.
+func (s *scheduler) sync(p *projectPair) error {
+	s.acquire()
+	defer s.release()
+
+	start := time.Now()
+	err := p.syncer.Sync()
+	if flushErr := p.h.Flush(); flushErr != nil && err == nil {
+		err = flushErr
+	}
+	if err != nil {
+		log.Printf("[%v] Sync failed after %v: %v\n", p.name, time.Since(start), err)
+		return err
+	}
+	stats := s.session.ProcessStats()
+	log.Printf("[%v] Sync completed in %v (callback latency: mean %v, max %v)\n",
+		p.name, time.Since(start), stats.MeanLatency(), stats.MaxLatency)
+	log.Printf("[%v] Phases: %v\n", p.name, p.syncer.LastCycle())
+	p.saveState()
+	if *monorailUserCache != "" {
+		if err := s.monorail.SaveUsers(*monorailUserCache); err != nil {
+			log.Printf("Failed to write monorail user cache: %v\n", err)
+		}
+	}
+	return nil
+}
+
+// syncAll synchronizes all the pairs once, concurrently
+func (s *scheduler) syncAll(pairs []*projectPair) error {
+	errs := make([]error, len(pairs))
+	wg := sync.WaitGroup{}
+	wg.Add(len(pairs))
+	for i, p := range pairs {
+		go func(i int, p *projectPair) {
+			defer wg.Done()
+			errs[i] = s.sync(p)
+		}(i, p)
+	}
+	wg.Wait()
+	failed := []string{}
+	for i, err := range errs {
+		if err != nil {
+			failed = append(failed, fmt.Sprintf("%v: %v", pairs[i].name, err))
+		}
+	}
+	if len(failed) > 0 {
+		return fmt.Errorf("Sync failed for %v", strings.Join(failed, ", "))
+	}
+	return nil
+}
+
+// runDaemon repeatedly synchronizes each of the pairs, every interval, or
+// debounce after a change is made to the pair's hansoft project, until
+// interrupted. The hansoft session, monorail client and the syncers' caches
+// are kept alive between synchronizations.
+func (s *scheduler) runDaemon(pairs []*projectPair) error {
+	stop := make(chan struct{})
+	signals := make(chan os.Signal, 1)
+	signal.Notify(signals, os.Interrupt, syscall.SIGTERM)
+	go func() {
+		<-signals
+		close(stop)
+	}()
+
+	wg := sync.WaitGroup{}
+	wg.Add(len(pairs))
+	for _, p := range pairs {
+		go func(p *projectPair) {
+			defer wg.Done()
+			s.runPair(p, stop)
+		}(p)
+	}
+	wg.Wait()
+	return nil
+}
+
+// runPair is the daemon loop of a single pair
+func (s *scheduler) runPair(p *projectPair, stop <-chan struct{}) {
+	next := time.Now() // Time of the next periodic synchronization
+	timer := time.NewTimer(0)
+	for {
+		select {
+		case <-stop:
+			return
+		case <-p.h.Changed():
+			wait := *debounce
+			if untilNext := time.Until(next); untilNext < wait {
+				wait = untilNext
+			}
+			if !timer.Stop() {
+				select {
+				case <-timer.C:
+				default:
+				}
+			}
+			timer.Reset(wait)
+			continue
+		case <-timer.C:
+		}
+
+		s.sync(p)
+		next = time.Now().Add(*interval)
+		timer.Reset(*interval)
+	}
 }
 
 func loadHansoftAuth(path string) (hansoftAuth, error) {
@@ -0,0 +1,144 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package main
+
+import (
+	"encoding/json"
+	"expvar"
+	"fmt"
+	"io"
+	"log"
+	"mhs/src/hansoft"
+	"mhs/src/monorail"
+	"mhs/src/projectsync"
+	"net/http"
+	_ "net/http/pprof" // Registers the /debug/pprof/ handlers
+	"sort"
+	"text/tabwriter"
+)
+
+// sdkCallVar is the expvar representation of a hansoft.CallStats
+type sdkCallVar struct {
+	Calls   int64 `json:"calls"`
+	Errors  int64 `json:"errors"`
+	Items   int64 `json:"items"`
+	TotalNs int64 `json:"total_ns"`
+	P50Ns   int64 `json:"p50_ns"`
+	P99Ns   int64 `json:"p99_ns"`
+	// Number of calls by the exclusive upper bound of their latency. Empty
+	// buckets are omitted.
+	Histogram map[string]int64 `json:"histogram"`
+}
+
+// monorailRPCVar is the expvar representation of a monorail.RPCStats
+type monorailRPCVar struct {
+	Calls   int64 `json:"calls"`
+	Errors  int64 `json:"errors"`
+	Retries int64 `json:"retries"`
+	TotalNs int64 `json:"total_ns"`
+	MaxNs   int64 `json:"max_ns"`
+	WaitNs  int64 `json:"wait_ns"`
+}
+
+// serveMetrics serves on address:
+//
+//	/debug/vars    the statistics of the hansoft SDK calls and monorail API
+//	               requests, as the 'hansoft_sdk' and 'monorail_rpc' expvars
+//	/debug/cycles  the phase breakdown of the last synchronization of
+//	               each pair, as JSON
+//	/debug/pprof/  the profiler. CPU profile samples are labelled with the
+//	               'project' and 'phase' of the synchronization.
+func serveMetrics(address string, h hansoft.Hansoft, m monorail.Monorail, pairs []*projectPair) {
+	expvar.Publish("hansoft_sdk", expvar.Func(func() interface{} {
+		out := map[string]sdkCallVar{}
+		for _, s := range h.CallStats() {
+			v := sdkCallVar{
+				Calls:     s.Calls,
+				Errors:    s.Errors,
+				Items:     s.Items,
+				TotalNs:   s.TotalLatency.Nanoseconds(),
+				P50Ns:     s.Quantile(0.5).Nanoseconds(),
+				P99Ns:     s.Quantile(0.99).Nanoseconds(),
+				Histogram: map[string]int64{},
+			}
+			for i, n := range s.Histogram {
+				if n > 0 {
+					v.Histogram[hansoft.LatencyBound(i).String()] = n
+				}
+			}
+			out[s.Function] = v
+		}
+		return out
+	}))
+	expvar.Publish("monorail_rpc", expvar.Func(func() interface{} {
+		out := map[string]monorailRPCVar{}
+		for _, s := range m.RPCStats() {
+			out[s.Method] = monorailRPCVar{
+				Calls:   s.Calls,
+				Errors:  s.Errors,
+				Retries: s.Retries,
+				TotalNs: s.TotalLatency.Nanoseconds(),
+				MaxNs:   s.MaxLatency.Nanoseconds(),
+				WaitNs:  s.WaitTime.Nanoseconds(),
+			}
+		}
+		return out
+	}))
+	http.HandleFunc("/debug/cycles", func(w http.ResponseWriter, r *http.Request) {
+		cycles := make([]projectsync.Cycle, len(pairs))
+		for i, p := range pairs {
+			cycles[i] = p.syncer.LastCycle()
+		}
+		w.Header().Set("Content-Type", "application/json")
+		enc := json.NewEncoder(w)
+		enc.SetIndent("", "  ")
+		if err := enc.Encode(cycles); err != nil {
+			http.Error(w, err.Error(), http.StatusInternalServerError)
+		}
+	})
+	go func() {
+		if err := http.ListenAndServe(address, nil); err != nil {
+			log.Printf("Metrics listener on '%v' failed: %v\n", address, err)
+		}
+	}()
+}
+
+// printCallStats writes a table of the hansoft SDK call statistics to w, with
+// the functions that took the most time first
+func printCallStats(w io.Writer, stats []hansoft.CallStats) {
+	sort.Slice(stats, func(i, j int) bool { return stats[i].TotalLatency > stats[j].TotalLatency })
+	tw := tabwriter.NewWriter(w, 0, 8, 2, ' ', tabwriter.AlignRight)
+	fmt.Fprintln(tw, "function\tcalls\terrors\titems\ttotal\tmean\tp50\tp99\t")
+	for _, s := range stats {
+		fmt.Fprintf(tw, "%v\t%v\t%v\t%v\t%v\t%v\t<%v\t<%v\t\n",
+			s.Function, s.Calls, s.Errors, s.Items, s.TotalLatency, s.MeanLatency(),
+			s.Quantile(0.5), s.Quantile(0.99))
+	}
+	tw.Flush()
+}
+
+// printRPCStats writes a table of the monorail API request statistics to w,
+// with the methods that took the most time first
+func printRPCStats(w io.Writer, stats []monorail.RPCStats) {
+	sort.Slice(stats, func(i, j int) bool { return stats[i].TotalLatency > stats[j].TotalLatency })
+	tw := tabwriter.NewWriter(w, 0, 8, 2, ' ', tabwriter.AlignRight)
+	fmt.Fprintln(tw, "method\tcalls\terrors\tretries\ttotal\tmean\tmax\twait\t")
+	for _, s := range stats {
+		fmt.Fprintf(tw, "%v\t%v\t%v\t%v\t%v\t%v\t%v\t%v\t\n",
+			s.Method, s.Calls, s.Errors, s.Retries, s.TotalLatency, s.MeanLatency(),
+			s.MaxLatency, s.WaitTime)
+	}
+	tw.Flush()
+}
@@ -11,5 +11,6 @@ require (
 	go.chromium.org/luci v0.0.0-20210312052453-d62a397066e3
 	golang.org/x/net v0.0.0-20210226172049-e18ecbb05110 // indirect
 	google.golang.org/api v0.40.0 // indirect
-	google.golang.org/grpc v1.36.0 // indirect
+	google.golang.org/grpc v1.36.0
+	google.golang.org/protobuf v1.25.0
 )
@@ -0,0 +1,309 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package fake provides in-memory implementations of the hansoft and monorail
+// project interfaces, populated with synthetic issues. The fakes simulate the
+// latency of the real backends and count the calls made to them, so that the
+// cost of a synchronization can be measured without a Hansoft server or
+// Monorail credentials.
+package fake
+
+import (
+	"fmt"
+	"math/rand"
+	"mhs/src/hansoft"
+	"mhs/src/monorail"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+// Latency is the simulated cost of the calls made to a fake backend
+type Latency struct {
+	// Call is the latency of every call
+	Call time.Duration
+	// Item is the additional latency for each task or issue read or written by
+	// a call
+	Item time.Duration
+}
+
+// Stats holds the number of calls made to a fake backend
+type Stats struct {
+	Calls int64 // Calls made to the backend
+	Items int64 // Tasks or issues read or written by the calls
+}
+
+// backend holds the latency and statistics shared by every call of a fake
+type backend struct {
+	latency Latency
+	calls   int64
+	items   int64
+}
+
+// call accounts for, and waits the latency of, a call with n items
+func (b *backend) call(n int) {
+	atomic.AddInt64(&b.calls, 1)
+	atomic.AddInt64(&b.items, int64(n))
+	if d := b.latency.Call + time.Duration(n)*b.latency.Item; d > 0 {
+		time.Sleep(d)
+	}
+}
+
+// Stats returns the number of calls made to the backend so far
+func (b *backend) Stats() Stats {
+	return Stats{atomic.LoadInt64(&b.calls), atomic.LoadInt64(&b.items)}
+}
+
+// ResetStats zeroes the call counts
+func (b *backend) ResetStats() {
+	atomic.StoreInt64(&b.calls, 0)
+	atomic.StoreInt64(&b.items, 0)
+}
+
+// Dataset describes the synthetic issues of a fake project pair
+type Dataset struct {
+	// Issues is the number of monorail issues
+	Issues int
+	// Users, Milestones and Sprints are the number of distinct assignees,
+	// milestones and sprints that the issues are spread across. Each issue
+	// has a 1 in 4 chance of having none of each. Zero values default to 50,
+	// 8 and 20.
+	Users, Milestones, Sprints int
+	// Columns are the names of the mapped columns of the monorail project,
+	// which are also custom columns of the hansoft project.
+	Columns []string
+	// Seed seeds the generation of the issues and their churn
+	Seed int64
+	// MonorailLatency and HansoftLatency are the simulated latencies of the
+	// backends
+	MonorailLatency, HansoftLatency Latency
+}
+
+// Pair is a monorail project and an initially empty hansoft project, generated
+// from a Dataset. The hansoft project has the resources, milestones and
+// sprints that the monorail issues refer to, so once synchronized the two
+// projects are in sync.
+type Pair struct {
+	Monorail *MonorailProject
+	Hansoft  *HansoftProject
+	rand     *rand.Rand
+}
+
+var (
+	statuses = []monorail.Status{
+		monorail.StatusNew,
+		monorail.StatusAccepted,
+		monorail.StatusStarted,
+		monorail.StatusFixed,
+		monorail.StatusVerified,
+		monorail.StatusWontFix,
+	}
+	priorities = []monorail.Priority{
+		monorail.PriorityLow,
+		monorail.PriorityMedium,
+		monorail.PriorityHigh,
+		monorail.PriorityCritical,
+	}
+	hansoftStatuses = []hansoft.Status{"New", "Assigned", "Resolved", "Verified", "Closed"}
+)
+
+// New returns a new fake project pair with the given name, populated with the
+// issues described by d.
+func New(name string, d Dataset) *Pair {
+	if d.Users == 0 {
+		d.Users = 50
+	}
+	if d.Milestones == 0 {
+		d.Milestones = 8
+	}
+	if d.Sprints == 0 {
+		d.Sprints = 20
+	}
+	p := &Pair{
+		Monorail: newMonorailProject(name, d.Columns, d.MonorailLatency),
+		Hansoft:  newHansoftProject(name, d.HansoftLatency),
+		rand:     rand.New(rand.NewSource(d.Seed)),
+	}
+	h := p.Hansoft
+	for i := 0; i < d.Users; i++ {
+		h.resources = append(h.resources, resource{fmt.Sprintf("User %d", i), userEmail(i)})
+	}
+	for i := 0; i < d.Milestones; i++ {
+		h.milestones = append(h.milestones, &named{milestoneName(i)})
+	}
+	for i := 0; i < d.Sprints; i++ {
+		h.sprints = append(h.sprints, &named{sprintName(i)})
+	}
+	for _, c := range d.Columns {
+		h.columns = append(h.columns, hansoft.CustomColumn{Name: c})
+	}
+
+	m := p.Monorail
+	m.issues = make([]*issue, d.Issues)
+	for i := range m.issues {
+		m.issues[i] = p.randomIssue(i+1, d)
+	}
+	return p
+}
+
+func userEmail(i int) string     { return fmt.Sprintf("user%d@chromium.org", i) }
+func milestoneName(i int) string { return fmt.Sprintf("M%d", 90+i) }
+func sprintName(i int) string    { return fmt.Sprintf("Sprint%d", i) }
+
+// pick returns a random index in [0, n), or -1 with a probability of 1 in 4
+func (p *Pair) pick(n int) int {
+	if p.rand.Intn(4) == 0 {
+		return -1
+	}
+	return p.rand.Intn(n)
+}
+
+func (p *Pair) randomIssue(id int, d Dataset) *issue {
+	i := &issue{
+		id:                id,
+		summary:           fmt.Sprintf("Issue %d: %x", id, p.rand.Int63()),
+		status:            statuses[p.rand.Intn(len(statuses))],
+		estimatedDuration: time.Duration(p.rand.Intn(40)) * time.Hour,
+		priority:          priorities[p.rand.Intn(len(priorities))],
+		modified:          time.Now(),
+	}
+	if u := p.pick(d.Users); u >= 0 {
+		i.assignee = userEmail(u)
+	}
+	if m := p.pick(d.Milestones); m >= 0 {
+		i.milestone = milestoneName(m)
+	}
+	if s := p.pick(d.Sprints); s >= 0 {
+		i.sprint = sprintName(s)
+	}
+	if len(d.Columns) > 0 {
+		i.columns = make([]string, len(d.Columns))
+		for c := range i.columns {
+			i.columns[c] = fmt.Sprintf("value%d", p.rand.Intn(10))
+		}
+	}
+	return i
+}
+
+// Churn simulates the changes made to the projects between synchronizations.
+// Each monorail issue has its summary, status or priority changed with a
+// probability of monorailFraction, and each hansoft task has its description
+// changed with a probability of hansoftFraction. Changes made to the hansoft
+// tasks are reported by HansoftProject.Changes().
+func (p *Pair) Churn(monorailFraction, hansoftFraction float64) {
+	m := p.Monorail
+	m.mutex.Lock()
+	now := time.Now()
+	for _, i := range m.issues {
+		if p.rand.Float64() >= monorailFraction {
+			continue
+		}
+		c := *i
+		switch p.rand.Intn(3) {
+		case 0:
+			c.summary = fmt.Sprintf("Issue %d: %x", c.id, p.rand.Int63())
+		case 1:
+			c.status = statuses[p.rand.Intn(len(statuses))]
+		case 2:
+			c.priority = priorities[p.rand.Intn(len(priorities))]
+		}
+		c.modified = now
+		*i = c
+	}
+	m.mutex.Unlock()
+
+	h := p.Hansoft
+	h.mutex.Lock()
+	now = time.Now()
+	for _, t := range h.tasks {
+		if p.rand.Float64() < hansoftFraction {
+			t.description = fmt.Sprintf("Changed in hansoft: %x", p.rand.Int63())
+			h.changes.Modified = append(h.changes.Modified, t)
+			if h.changes.FieldTimes == nil {
+				h.changes.FieldTimes = map[hansoft.Task]hansoft.FieldTimes{}
+			}
+			h.changes.FieldTimes[t] = hansoft.FieldTimes{hansoft.FieldDescription: now}
+		}
+	}
+	h.mutex.Unlock()
+	h.signal()
+}
+
+// EditMonorailSummary sets the summary of the monorail issue with the bug ID,
+// as if edited in monorail at time t
+func (p *Pair) EditMonorailSummary(id int, summary string, t time.Time) {
+	p.editMonorail(id, t, func(i *issue) { i.summary = summary })
+}
+
+// TouchMonorail sets the modification time of the monorail issue with the bug
+// ID to t, without changing its fields, as adding a comment does
+func (p *Pair) TouchMonorail(id int, t time.Time) {
+	p.editMonorail(id, t, func(*issue) {})
+}
+
+func (p *Pair) editMonorail(id int, t time.Time, f func(*issue)) {
+	m := p.Monorail
+	m.mutex.Lock()
+	defer m.mutex.Unlock()
+	for _, i := range m.issues {
+		if i.id == id {
+			c := *i
+			f(&c)
+			c.modified = t
+			*i = c
+		}
+	}
+}
+
+// EditHansoftDescription sets the description of the hansoft task linked to
+// the monorail issue with the bug ID, as if edited in hansoft at time t. The
+// change is reported by HansoftProject.Changes().
+func (p *Pair) EditHansoftDescription(id int, description string, t time.Time) {
+	h := p.Hansoft
+	h.mutex.Lock()
+	suffix := "/" + strconv.Itoa(id)
+	for _, task := range h.tasks {
+		if strings.HasSuffix(task.hyperlink, suffix) {
+			task.description = description
+			h.changes.Modified = append(h.changes.Modified, task)
+			if h.changes.FieldTimes == nil {
+				h.changes.FieldTimes = map[hansoft.Task]hansoft.FieldTimes{}
+			}
+			h.changes.FieldTimes[task] = hansoft.FieldTimes{hansoft.FieldDescription: t}
+		}
+	}
+	h.mutex.Unlock()
+	h.signal()
+}
+
+// ReloadHansoft makes the next HansoftProject.Changes() report Reloaded, as
+// if the hansoft project's metadata had changed
+func (p *Pair) ReloadHansoft() {
+	h := p.Hansoft
+	h.mutex.Lock()
+	h.changes.Reloaded = true
+	h.mutex.Unlock()
+	h.signal()
+}
+
+// DropHansoftChanges discards the hansoft changes waiting to be reported by
+// HansoftProject.Changes(), as a process that connects after the changes were
+// made never sees them
+func (p *Pair) DropHansoftChanges() {
+	h := p.Hansoft
+	h.mutex.Lock()
+	h.changes = hansoft.Changes{}
+	h.mutex.Unlock()
+}
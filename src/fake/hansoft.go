@@ -0,0 +1,383 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fake
+
+import (
+	"fmt"
+	"mhs/src/hansoft"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+)
+
+// HansoftProject is an in-memory hansoft.Project. Batched calls, such as
+// Backlog.Snapshot(), count as a single call.
+type HansoftProject struct {
+	backend
+	name       string
+	mutex      sync.Mutex
+	tasks      []*task
+	resources  []hansoft.Resource
+	milestones []hansoft.Milestone
+	sprints    []hansoft.Sprint
+	columns    []hansoft.CustomColumn
+	changes    hansoft.Changes // Changes since the last call to Changes()
+	loaded     bool            // True once Changes() has been called
+	changed    chan struct{}
+}
+
+var (
+	_ hansoft.Project = (*HansoftProject)(nil)
+	_ hansoft.Backlog = (*HansoftProject)(nil)
+	_ hansoft.Task    = (*task)(nil)
+)
+
+func newHansoftProject(name string, latency Latency) *HansoftProject {
+	return &HansoftProject{
+		backend: backend{latency: latency},
+		name:    name,
+		changed: make(chan struct{}, 1),
+	}
+}
+
+func (p *HansoftProject) signal() {
+	select {
+	case p.changed <- struct{}{}:
+	default:
+	}
+}
+
+type resource struct {
+	name  string
+	email string
+}
+
+func (r resource) Name() string  { return r.name }
+func (r resource) Email() string { return r.email }
+
+// named is a milestone or sprint
+type named struct{ name string }
+
+func (n *named) Name() (string, error) { return n.name, nil }
+
+func (p *HansoftProject) Name() string { return p.name }
+
+// Backlog returns the project, which also implements hansoft.Backlog
+func (p *HansoftProject) Backlog() hansoft.Backlog { return p }
+
+func (p *HansoftProject) Statuses() ([]hansoft.Status, error) {
+	p.call(0)
+	return hansoftStatuses, nil
+}
+
+func (p *HansoftProject) Resources() ([]hansoft.Resource, error) {
+	p.call(len(p.resources))
+	return p.resources, nil
+}
+
+func (p *HansoftProject) Milestones() ([]hansoft.Milestone, error) {
+	p.call(len(p.milestones))
+	return p.milestones, nil
+}
+
+func (p *HansoftProject) Sprints() ([]hansoft.Sprint, error) {
+	p.call(len(p.sprints))
+	return p.sprints, nil
+}
+
+func (p *HansoftProject) CustomColumns() ([]hansoft.CustomColumn, error) {
+	p.call(len(p.columns))
+	return p.columns, nil
+}
+
+func (p *HansoftProject) SetSprints(sprints map[hansoft.Task]hansoft.Sprint) error {
+	p.call(len(sprints))
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	for t, s := range sprints {
+		if s != nil {
+			t.(*task).sprint = s
+		}
+	}
+	return nil
+}
+
+// Changes returns the changes made by Pair.Churn() since the last call. The
+// first call reports Reloaded.
+func (p *HansoftProject) Changes() (hansoft.Changes, error) {
+	p.call(0)
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := p.changes
+	out.Reloaded = out.Reloaded || !p.loaded
+	p.loaded = true
+	p.changes = hansoft.Changes{}
+	return out, nil
+}
+
+func (p *HansoftProject) Changed() <-chan struct{} { return p.changed }
+
+// Flush is a no-op, as the fake's writes are applied immediately
+func (p *HansoftProject) Flush() error { return nil }
+
+func (p *HansoftProject) LoadMetadata(path string, maxAge time.Duration) (bool, error) {
+	return false, nil
+}
+
+func (p *HansoftProject) SaveMetadata(path string) error { return nil }
+
+func (p *HansoftProject) Tasks() ([]hansoft.Task, error) {
+	p.call(len(p.tasks))
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := make([]hansoft.Task, len(p.tasks))
+	for i, t := range p.tasks {
+		out[i] = t
+	}
+	return out, nil
+}
+
+func (p *HansoftProject) LinkedTasks(prefix string) ([]hansoft.LinkedTask, hansoft.LinkedCounts, error) {
+	p.call(len(p.tasks))
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := []hansoft.LinkedTask{}
+	counts := hansoft.LinkedCounts{}
+	for _, t := range p.tasks {
+		if !strings.HasPrefix(t.hyperlink, prefix) {
+			continue
+		}
+		id, ok := hansoft.ParseBugID(t.hyperlink[len(prefix):])
+		if !ok {
+			counts.Malformed++
+			continue
+		}
+		out = append(out, hansoft.LinkedTask{ID: id, Task: t})
+	}
+	sort.Slice(out, func(i, j int) bool { return out[i].ID < out[j].ID })
+	return out, counts, nil
+}
+
+// LoadIndex is a no-op, as the fake's LinkedTasks() has no hyperlinks to read
+func (p *HansoftProject) LoadIndex(path, prefix string, maxAge time.Duration) error { return nil }
+
+func (p *HansoftProject) RebuildIndex() {}
+
+func (p *HansoftProject) SaveIndex(path string) error { return nil }
+
+func (p *HansoftProject) NewTask() (hansoft.Task, error) {
+	tasks, err := p.NewTasks(1)
+	if err != nil {
+		return nil, err
+	}
+	return tasks[0], nil
+}
+
+func (p *HansoftProject) NewTasks(n int) ([]hansoft.Task, error) {
+	p.call(n)
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := make([]hansoft.Task, n)
+	for i := range out {
+		t := &task{project: p, status: "New", priority: hansoft.PriorityMedium}
+		p.tasks = append(p.tasks, t)
+		out[i] = t
+	}
+	return out, nil
+}
+
+func (p *HansoftProject) Snapshot(tasks []hansoft.Task, columns ...hansoft.CustomColumn) ([]hansoft.TaskSnapshot, error) {
+	p.call(len(tasks))
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := make([]hansoft.TaskSnapshot, len(tasks))
+	for i, t := range tasks {
+		t := t.(*task)
+		out[i] = hansoft.TaskSnapshot{
+			Task:              t,
+			Hyperlink:         t.hyperlink,
+			Description:       t.description,
+			Assignee:          t.assignee,
+			Status:            t.status,
+			EstimatedDuration: t.duration,
+			Priority:          t.priority,
+			Milestone:         t.milestone,
+			Sprint:            t.sprint,
+		}
+		if len(columns) > 0 {
+			out[i].Columns = make([]string, len(columns))
+			for c, column := range columns {
+				out[i].Columns[c] = t.columns[column.Name]
+			}
+		}
+	}
+	return out, nil
+}
+
+func (p *HansoftProject) Compare(expected []hansoft.TaskExpected) ([]hansoft.FieldMask, error) {
+	p.call(len(expected))
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	out := make([]hansoft.FieldMask, len(expected))
+	for i, e := range expected {
+		t := e.Task.(*task)
+		mask := hansoft.FieldMask(0)
+		if t.hyperlink != e.Hyperlink {
+			mask |= hansoft.FieldHyperlink
+		}
+		if t.description != e.Description {
+			mask |= hansoft.FieldDescription
+		}
+		if t.assignee != e.Assignee {
+			mask |= hansoft.FieldAssignee
+		}
+		if t.status != e.Status {
+			mask |= hansoft.FieldStatus
+		}
+		if t.duration/time.Minute != e.EstimatedDuration/time.Minute {
+			mask |= hansoft.FieldEstimatedDuration
+		}
+		if t.priority != e.Priority {
+			mask |= hansoft.FieldPriority
+		}
+		if t.milestone != e.Milestone {
+			mask |= hansoft.FieldMilestone
+		}
+		if t.sprint != e.Sprint {
+			mask |= hansoft.FieldSprint
+		}
+		out[i] = mask &^ e.Ignore
+	}
+	return out, nil
+}
+
+type task struct {
+	project     *HansoftProject
+	hyperlink   string
+	description string
+	assignee    hansoft.Resource
+	status      hansoft.Status
+	duration    time.Duration
+	priority    hansoft.Priority
+	milestone   hansoft.Milestone
+	sprint      hansoft.Sprint
+	columns     map[string]string
+}
+
+// get calls f to read the task's fields, accounting for a single call
+func (t *task) get(f func()) {
+	t.project.call(1)
+	t.project.mutex.Lock()
+	defer t.project.mutex.Unlock()
+	f()
+}
+
+// set calls f to write the task's fields, accounting for a single call
+func (t *task) set(f func()) error {
+	t.get(f)
+	return nil
+}
+
+func (t *task) Assignee() (r hansoft.Resource, err error) {
+	t.get(func() { r = t.assignee })
+	return r, nil
+}
+
+func (t *task) Description() (d string, err error) {
+	t.get(func() { d = t.description })
+	return d, nil
+}
+
+func (t *task) EstimatedDuration() (d time.Duration, err error) {
+	t.get(func() { d = t.duration })
+	return d, nil
+}
+
+func (t *task) Hyperlink() (h string, err error) {
+	t.get(func() { h = t.hyperlink })
+	return h, nil
+}
+
+func (t *task) Milestone() (m hansoft.Milestone, err error) {
+	t.get(func() { m = t.milestone })
+	return m, nil
+}
+
+func (t *task) Priority() (p hansoft.Priority, err error) {
+	t.get(func() { p = t.priority })
+	return p, nil
+}
+
+func (t *task) Sprint() (s hansoft.Sprint, err error) {
+	t.get(func() { s = t.sprint })
+	return s, nil
+}
+
+func (t *task) Status() (s hansoft.Status, err error) {
+	t.get(func() { s = t.status })
+	return s, nil
+}
+
+func (t *task) CustomColumn(c hansoft.CustomColumn) (v string, err error) {
+	t.get(func() { v = t.columns[c.Name] })
+	return v, nil
+}
+
+func (t *task) SetAssignee(r hansoft.Resource) error {
+	return t.set(func() { t.assignee = r })
+}
+
+func (t *task) SetCustomColumn(c hansoft.CustomColumn, value string) error {
+	return t.set(func() {
+		if t.columns == nil {
+			t.columns = map[string]string{}
+		}
+		t.columns[c.Name] = value
+	})
+}
+
+func (t *task) SetDescription(d string) error {
+	return t.set(func() { t.description = d })
+}
+
+func (t *task) SetEstimatedDuration(d time.Duration) error {
+	return t.set(func() { t.duration = d })
+}
+
+func (t *task) SetHyperlink(h string) error {
+	return t.set(func() { t.hyperlink = h })
+}
+
+func (t *task) SetMilestone(m hansoft.Milestone) error {
+	return t.set(func() { t.milestone = m })
+}
+
+func (t *task) SetPriority(p hansoft.Priority) error {
+	return t.set(func() { t.priority = p })
+}
+
+func (t *task) SetSprint(s hansoft.Sprint) error {
+	return t.set(func() { t.sprint = s })
+}
+
+func (t *task) SetStatus(s hansoft.Status) error {
+	for _, status := range hansoftStatuses {
+		if s == status {
+			return t.set(func() { t.status = s })
+		}
+	}
+	return fmt.Errorf("Unknown status '%v'", s)
+}
@@ -0,0 +1,201 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package fake
+
+import (
+	"mhs/src/monorail"
+	"sync"
+	"time"
+)
+
+const (
+	// The number of issues sent by each simulated IssuesStream() request
+	monorailPageSize = 100
+	// The number of issues modified by each simulated ModifyIssues() request
+	monorailModifySize = 50
+)
+
+// MonorailProject is an in-memory monorail.Project
+type MonorailProject struct {
+	backend
+	name    string
+	columns []string
+	mutex   sync.Mutex
+	issues  []*issue
+	stats   monorail.StreamStats // Statistics of the last search
+
+	// ReadOnly holds the fields that are not returned by WritableFields()
+	ReadOnly monorail.IssueFields
+}
+
+var _ monorail.Project = (*MonorailProject)(nil)
+
+func newMonorailProject(name string, columns []string, latency Latency) *MonorailProject {
+	return &MonorailProject{backend: backend{latency: latency}, name: name, columns: columns}
+}
+
+type issue struct {
+	id                int
+	summary           string
+	assignee          string
+	status            monorail.Status
+	estimatedDuration time.Duration
+	priority          monorail.Priority
+	milestone         string
+	sprint            string
+	columns           []string
+	modified          time.Time
+}
+
+func (i issue) ID() int                          { return i.id }
+func (i issue) Summary() string                  { return i.summary }
+func (i issue) Assignee() string                 { return i.assignee }
+func (i issue) Status() monorail.Status          { return i.status }
+func (i issue) EstimatedDuration() time.Duration { return i.estimatedDuration }
+func (i issue) Priority() monorail.Priority      { return i.priority }
+func (i issue) Milestone() string                { return i.milestone }
+func (i issue) Sprint() string                   { return i.sprint }
+func (i issue) Columns() []string                { return i.columns }
+func (i issue) ModifyTime() time.Time            { return i.modified }
+
+func (p *MonorailProject) Name() string      { return p.name }
+func (p *MonorailProject) Columns() []string { return p.columns }
+
+// snapshot returns a copy of the issues, accounting for a request for each
+// page of issues
+func (p *MonorailProject) snapshot(filter func(*issue) bool) []monorail.Issue {
+	p.mutex.Lock()
+	out := make([]monorail.Issue, 0, len(p.issues))
+	for _, i := range p.issues {
+		if filter == nil || filter(i) {
+			out = append(out, *i)
+		}
+	}
+	p.mutex.Unlock()
+	stats := monorail.StreamStats{}
+	for n := 0; n < len(out); n += monorailPageSize {
+		if len(out)-n < monorailPageSize {
+			p.page(&stats, len(out)-n)
+		} else {
+			p.page(&stats, monorailPageSize)
+		}
+	}
+	p.setStats(stats)
+	return out
+}
+
+// page accounts for a request for a page of n issues
+func (p *MonorailProject) page(stats *monorail.StreamStats, n int) {
+	start := time.Now()
+	p.call(n)
+	stats.Pages++
+	stats.Issues += n
+	stats.SearchTime += time.Since(start)
+}
+
+func (p *MonorailProject) setStats(stats monorail.StreamStats) {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	p.stats = stats
+}
+
+func (p *MonorailProject) StreamStats() monorail.StreamStats {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	return p.stats
+}
+
+func (p *MonorailProject) Issues() ([]monorail.Issue, error) {
+	return p.snapshot(nil), nil
+}
+
+func (p *MonorailProject) IssuesStream(out chan<- monorail.Issue) error {
+	defer close(out)
+	p.mutex.Lock()
+	issues := make([]issue, len(p.issues))
+	for i, issue := range p.issues {
+		issues[i] = *issue
+	}
+	p.mutex.Unlock()
+	stats := monorail.StreamStats{}
+	for len(issues) > 0 {
+		n := len(issues)
+		if n > monorailPageSize {
+			n = monorailPageSize
+		}
+		p.page(&stats, n)
+		for _, i := range issues[:n] {
+			out <- i
+		}
+		issues = issues[n:]
+	}
+	p.setStats(stats)
+	return nil
+}
+
+func (p *MonorailProject) IssuesModifiedSince(t time.Time) ([]monorail.Issue, error) {
+	return p.snapshot(func(i *issue) bool { return !i.modified.Before(t) }), nil
+}
+
+// WritableFields returns all the fields but ReadOnly, as the fake issues all
+// have an estimated duration
+func (p *MonorailProject) WritableFields() monorail.IssueFields {
+	all := monorail.FieldSummary | monorail.FieldStatus | monorail.FieldPriority | monorail.FieldEstimatedDuration | monorail.FieldMilestone
+	return all &^ p.ReadOnly
+}
+
+// UpdateIssues applies the updates, accounting for a request for each chunk of
+// monorailModifySize updates
+func (p *MonorailProject) UpdateIssues(updates []monorail.IssueUpdate) ([]monorail.IssueUpdate, error) {
+	for n := 0; n < len(updates); n += monorailModifySize {
+		if len(updates)-n < monorailModifySize {
+			p.call(len(updates) - n)
+		} else {
+			p.call(monorailModifySize)
+		}
+	}
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	byID := make(map[int]*issue, len(p.issues))
+	for _, i := range p.issues {
+		byID[i.id] = i
+	}
+	now := time.Now()
+	for _, u := range updates {
+		i, ok := byID[u.ID]
+		if !ok {
+			continue
+		}
+		c := *i
+		if u.Fields&monorail.FieldSummary != 0 {
+			c.summary = u.New.Summary
+		}
+		if u.Fields&monorail.FieldStatus != 0 {
+			c.status = u.New.Status
+		}
+		if u.Fields&monorail.FieldPriority != 0 {
+			c.priority = u.New.Priority
+		}
+		if u.Fields&monorail.FieldEstimatedDuration != 0 {
+			c.estimatedDuration = u.New.EstimatedDuration
+		}
+		if u.Fields&monorail.FieldMilestone != 0 {
+			c.milestone = u.New.Milestone
+		}
+		c.modified = now
+		*i = c
+	}
+	return nil, nil
+}
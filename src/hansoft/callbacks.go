@@ -17,31 +17,59 @@ package hansoft
 import "C"
 
 import (
+	"sync"
 	"unsafe"
 )
 
-type processCallbackHandle = uintptr
+// callbackHandle is the context pointer passed to the SDK callbacks. Handles
+// start at 1 and are never reused, so a late callback for an unregistered
+// handler is dropped rather than delivered to a different handler.
+type callbackHandle = uintptr
 
-var (
-	processCallbackHandlers = map[processCallbackHandle]processCallbackHandler{}
-	processCallbackHandles  = map[processCallbackHandler]processCallbackHandle{}
-)
+var callbacks = struct {
+	mutex    sync.RWMutex
+	last     callbackHandle
+	handlers map[callbackHandle]callbackHandler
+	handles  map[callbackHandler]callbackHandle
+}{
+	handlers: map[callbackHandle]callbackHandler{},
+	handles:  map[callbackHandler]callbackHandle{},
+}
 
-func registerProcessCallbackHandler(handler processCallbackHandler) processCallbackHandle {
-	handle := processCallbackHandle(len(processCallbackHandlers))
-	processCallbackHandlers[handle] = handler
-	processCallbackHandles[handler] = handle
+func registerCallbackHandler(handler callbackHandler) callbackHandle {
+	callbacks.mutex.Lock()
+	defer callbacks.mutex.Unlock()
+	callbacks.last++
+	handle := callbacks.last
+	callbacks.handlers[handle] = handler
+	callbacks.handles[handler] = handle
 	return handle
 }
 
-func unregisterProcessCallbackHandler(handler processCallbackHandler) {
-	handle := processCallbackHandles[handler]
-	delete(processCallbackHandlers, handle)
-	delete(processCallbackHandles, handler)
+func unregisterCallbackHandler(handler callbackHandler) {
+	callbacks.mutex.Lock()
+	defer callbacks.mutex.Unlock()
+	handle := callbacks.handles[handler]
+	delete(callbacks.handlers, handle)
+	delete(callbacks.handles, handler)
+}
+
+func lookupCallbackHandler(handle unsafe.Pointer) callbackHandler {
+	callbacks.mutex.RLock()
+	defer callbacks.mutex.RUnlock()
+	return callbacks.handlers[uintptr(handle)]
 }
 
 //export onProcessCallback
 func onProcessCallback(handle unsafe.Pointer) {
-	handler := processCallbackHandlers[uintptr(handle)]
-	handler.onProcessCallback()
+	if handler := lookupCallbackHandler(handle); handler != nil {
+		handler.onProcessCallback()
+	}
+}
+
+//export onChangeCallback
+func onChangeCallback(handle unsafe.Pointer, kind, container, id, field int32) {
+	if handler := lookupCallbackHandler(handle); handler != nil {
+		handler.onChangeCallback(change{changeKind(kind), uniqueID(container), id, int(field), false})
+	}
 }
@@ -0,0 +1,219 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"sync"
+	"time"
+)
+
+// Changes describes the modifications made to a project, as returned by
+// Project.Changes()
+type Changes struct {
+	// Backlog tasks that have been created or modified
+	Modified []Task
+	// Backlog tasks that have been deleted
+	Deleted []Task
+	// FieldTimes holds, for the Modified tasks that had fields changed by
+	// another client, the time each of those fields was last changed. Writes
+	// made through a non-blocking session, and sprint changes, are not
+	// included. The writes of a blocking session are not tracked, so are
+	// reported like those of another client.
+	FieldTimes map[Task]FieldTimes
+	// Reloaded is true if the project's statuses, resources, milestones,
+	// sprints or custom columns changed, and so will be reloaded on next use.
+	// If Reloaded is true, then all the previously returned Resources,
+	// Milestones, Sprints and CustomColumns are stale, and all the tasks
+	// should be re-read.
+	Reloaded bool
+}
+
+// FieldTimes holds the time of the last change of each of a task's fields.
+// Each key is a single field.
+type FieldTimes map[FieldMask]time.Time
+
+// changeFieldMasks maps the changeFields to their FieldMask
+var changeFieldMasks = map[changeField]FieldMask{
+	changeFieldDescription:    FieldDescription,
+	changeFieldHyperlink:      FieldHyperlink,
+	changeFieldWorkflowStatus: FieldStatus,
+	changeFieldIdealDays:      FieldEstimatedDuration,
+	changeFieldResource:       FieldAssignee,
+	changeFieldMilestone:      FieldMilestone,
+	changeFieldPriority:       FieldPriority,
+}
+
+// changeTracker accumulates the change callbacks for a single project.
+// changeTracker is written to by the SessionProcess() goroutine, and read by
+// Project.Changes().
+type changeTracker struct {
+	mutex    sync.Mutex
+	modified map[uniqueID]struct{}   // Task IDs
+	created  map[taskRef]uniqueID    // Task ref to container ID
+	deleted  map[uniqueID]struct{}   // Task IDs
+	times    map[uniqueID]FieldTimes // Task ID to times of external changes
+	reload   bool
+	signal   chan struct{} // Signalled when a change is added
+}
+
+func (t *changeTracker) reset() {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	t.modified = map[uniqueID]struct{}{}
+	t.created = map[taskRef]uniqueID{}
+	t.deleted = map[uniqueID]struct{}{}
+	t.times = map[uniqueID]FieldTimes{}
+	t.reload = false
+	if t.signal == nil {
+		t.signal = make(chan struct{}, 1)
+	}
+}
+
+func (t *changeTracker) add(c change) {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	switch c.kind {
+	case changeTaskField:
+		id := uniqueID(c.id)
+		t.modified[id] = struct{}{}
+		if f, ok := changeFieldMasks[changeField(c.field)]; ok && !c.echo {
+			times, ok := t.times[id]
+			if !ok {
+				times = FieldTimes{}
+				t.times[id] = times
+			}
+			times[f] = time.Now()
+		}
+	case changeTaskColumn:
+		t.modified[uniqueID(c.id)] = struct{}{}
+	case changeTaskCreate:
+		t.created[taskRef(c.id)] = c.container
+	case changeTaskDelete:
+		t.deleted[uniqueID(c.id)] = struct{}{}
+	case changeResource, changeWorkflow, changeColumns:
+		t.reload = true
+	}
+	select {
+	case t.signal <- struct{}{}:
+	default: // Already signalled
+	}
+}
+
+// take returns the accumulated changes, and resets the tracker
+func (t *changeTracker) take() (modified map[uniqueID]struct{}, created map[taskRef]uniqueID, deleted map[uniqueID]struct{}, times map[uniqueID]FieldTimes, reload bool) {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	modified, created, deleted, times, reload = t.modified, t.created, t.deleted, t.times, t.reload
+	t.modified = map[uniqueID]struct{}{}
+	t.created = map[taskRef]uniqueID{}
+	t.deleted = map[uniqueID]struct{}{}
+	t.times = map[uniqueID]FieldTimes{}
+	t.reload = false
+	return
+}
+
+func (p *project) Changed() <-chan struct{} {
+	return p.changes.signal
+}
+
+func (p *project) Changes() (Changes, error) {
+	s := p.session
+	modified, created, deleted, times, reload := p.changes.take()
+
+	// Only the loaded milestones and sprints can become stale
+	p.metadataMutex.Lock()
+	milestones, sprints := p.milestones, p.sprints
+	p.metadataMutex.Unlock()
+	isMetadata := func(id uniqueID) bool {
+		_, isMilestone := milestones[id]
+		_, isSprint := sprints[id]
+		return isMilestone || isSprint
+	}
+
+	// Task IDs to main references
+	refs := map[uniqueID]taskRef{}
+
+	for ref, container := range created {
+		id, err := s.sdk.TaskRefGetTask(s.handle, ref)
+		if err != nil {
+			continue // Task has since been deleted
+		}
+		if container == p.backlog.id {
+			refs[id] = ref
+			continue
+		}
+		mainRef, err := s.sdk.TaskGetMainReference(s.handle, id)
+		if err != nil {
+			continue
+		}
+		if mainRef == ref {
+			reload = true // New milestone or sprint
+		} else {
+			modified[id] = struct{}{} // Sprint proxy for a backlog task
+		}
+	}
+
+	for id := range modified {
+		if isMetadata(id) {
+			reload = true
+			continue
+		}
+		if _, ok := refs[id]; ok {
+			continue
+		}
+		ref, err := s.sdk.TaskGetMainReference(s.handle, id)
+		if err != nil {
+			continue
+		}
+		container, err := s.sdk.TaskRefGetContainer(s.handle, ref)
+		if err != nil || container != p.backlog.id {
+			continue
+		}
+		refs[id] = ref
+	}
+
+	out := Changes{}
+	for id := range deleted {
+		if isMetadata(id) {
+			reload = true
+		}
+		delete(refs, id)
+		p.tasksMutex.Lock()
+		t, ok := p.tasks[id]
+		delete(p.tasks, id)
+		p.tasksMutex.Unlock()
+		if ok {
+			out.Deleted = append(out.Deleted, t)
+		}
+	}
+
+	for id, ref := range refs {
+		t := p.task(id, ref)
+		out.Modified = append(out.Modified, t)
+		if ft, ok := times[id]; ok {
+			if out.FieldTimes == nil {
+				out.FieldTimes = map[Task]FieldTimes{}
+			}
+			out.FieldTimes[t] = ft
+		}
+	}
+
+	if reload {
+		p.invalidateMetadata()
+		out.Reloaded = true
+	}
+
+	return out, nil
+}
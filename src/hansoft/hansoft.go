@@ -17,6 +17,8 @@ package hansoft
 import (
 	"fmt"
 	"sort"
+	"strings"
+	"sync"
 	"time"
 	"unsafe"
 )
@@ -24,6 +26,19 @@ import (
 // Hansoft is the interface to the Hansoft SDK
 type Hansoft interface {
 	Connect(address string, port int, database, user, password string) (Session, error)
+	// ConnectNonBlocking is like Connect, but task field writes return
+	// without waiting for the server. Use Session.Flush() to wait for the
+	// writes to complete.
+	ConnectNonBlocking(address string, port int, database, user, password string) (Session, error)
+	// ConnectPool is like Connect, or ConnectNonBlocking if blocking is
+	// false, but opens n connections to the database. Writes and change
+	// callbacks use the first connection, and batched reads (such as
+	// Backlog.LinkedTasks(), Backlog.Snapshot() and metadata loads) are
+	// spread across all n connections.
+	ConnectPool(address string, port int, database, user, password string, n int, blocking bool) (Session, error)
+	// CallStats returns the statistics of each SDK function called so far,
+	// across all sessions.
+	CallStats() []CallStats
 	Destroy() error
 }
 
@@ -31,22 +46,186 @@ type Hansoft interface {
 type Session interface {
 	Destroy() error
 	Projects() ([]Project, error)
+	// Flush waits until the server has confirmed all the task field writes
+	// made with a non-blocking session. Flush returns immediately for a
+	// blocking session.
+	Flush() error
+	// ProcessStats returns the statistics of the session's callback
+	// processing.
+	ProcessStats() ProcessStats
 }
 
 // Project is the interface to a Hansoft project
 type Project interface {
 	Name() string
 	Backlog() Backlog
-	Statuses() []Status
-	Resources() []Resource
-	Milestones() []Milestone
-	Sprints() []Sprint
+	// Statuses, Resources, Milestones and Sprints are loaded on first use, and
+	// reloaded on the next use after Changes() reports Reloaded.
+	Statuses() ([]Status, error)
+	Resources() ([]Resource, error)
+	Milestones() ([]Milestone, error)
+	Sprints() ([]Sprint, error)
+	// CustomColumns returns the project's custom columns, both hidden and
+	// showing. Loaded on first use, like Resources().
+	CustomColumns() ([]CustomColumn, error)
+	// SetSprints links each of the tasks to the given sprint. Tasks that are
+	// already in the sprint are left untouched, tasks in a different sprint
+	// have their old sprint proxy removed, and the proxies for each sprint are
+	// created with a single SDK call. A nil sprint leaves the task untouched.
+	SetSprints(map[Task]Sprint) error
+	// Changes returns the changes made to the project since the last call to
+	// Changes(), or since the project was loaded.
+	Changes() (Changes, error)
+	// Changed returns a channel that is signalled when a change is made to
+	// the project. Multiple changes may be coalesced into a single signal.
+	Changed() <-chan struct{}
+	// LoadMetadata loads the project's metadata from a snapshot file written
+	// by SaveMetadata(), if the snapshot is younger than maxAge and no
+	// metadata has since been added or removed. Renames are not detected.
+	// LoadMetadata returns false if the snapshot was not used.
+	LoadMetadata(path string, maxAge time.Duration) (bool, error)
+	// SaveMetadata writes the project's metadata to a snapshot file.
+	SaveMetadata(path string) error
+	// Flush waits until the server has confirmed the writes made to the
+	// project's task fields with a non-blocking session, like
+	// Session.Flush(), but leaving the writes to the other projects pending.
+	Flush() error
 }
 
 // Backlog is the interface to a Hansoft project backlog
 type Backlog interface {
 	Tasks() ([]Task, error)
+	// LinkedTasks returns the tasks that have a hyperlink of the form
+	// <prefix><ID>, along with the counts of the tasks that could not be
+	// linked.
+	LinkedTasks(prefix string) ([]LinkedTask, LinkedCounts, error)
+	// LoadIndex loads the index of the tasks linked with prefix from the file
+	// at path, written by SaveIndex(), and makes LinkedTasks(prefix) use the
+	// index. The hyperlinks of the indexed tasks are checked on load, and the
+	// index is validated against the backlog's task references, so
+	// LinkedTasks() only reads the hyperlinks of the tasks created, or with a
+	// changed hyperlink, since the index was written. The counts returned by
+	// LinkedTasks() then only cover the tasks read. As the hyperlinks given to
+	// unlinked tasks while the index was not loaded are not seen, the first
+	// LinkedTasks() after the index is older than maxAge reads all the
+	// hyperlinks, and rebuilds the index. A maxAge of 0 never rebuilds it.
+	// A missing file is not an error.
+	LoadIndex(path, prefix string, maxAge time.Duration) error
+	// RebuildIndex makes the next LinkedTasks() read all the hyperlinks, and
+	// rebuild the index loaded by LoadIndex().
+	RebuildIndex()
+	// SaveIndex writes the index loaded by LoadIndex() to the file at path.
+	SaveIndex(path string) error
 	NewTask() (Task, error)
+	// NewTasks creates n new tasks, using as few SDK calls as possible.
+	// If an error is returned, the tasks that were created are also returned.
+	NewTasks(n int) ([]Task, error)
+	// Snapshot reads the fields of all the given tasks in a single batch,
+	// along with the values of the given custom columns.
+	// Snapshot is considerably cheaper than calling the individual Task getters.
+	Snapshot(tasks []Task, columns ...CustomColumn) ([]TaskSnapshot, error)
+	// Compare compares the fields of each of the tasks against the expected
+	// values, returning the set of fields that differ for each. Fields that
+	// could not be read are reported as differing, so that the caller can
+	// Snapshot() the task for the error. Custom columns are not compared.
+	// Compare is considerably cheaper than Snapshot() for tasks that are
+	// expected to be unchanged, as no field values are copied out of the SDK.
+	Compare(expected []TaskExpected) ([]FieldMask, error)
+}
+
+// LinkedTask is a task returned by Backlog.LinkedTasks()
+type LinkedTask struct {
+	// The ID parsed from the task's hyperlink
+	ID   int
+	Task Task
+}
+
+// LinkedCounts holds the numbers of tasks that Backlog.LinkedTasks() could not
+// link
+type LinkedCounts struct {
+	Malformed  int // Tasks with the prefix, but whose ID could not be parsed
+	Unreadable int // Tasks whose hyperlink could not be read
+}
+
+// ParseBugID parses the part of a hyperlink that follows the prefix passed to
+// Backlog.LinkedTasks(), with the same rules: digits must be a positive
+// decimal number that fits in 32 bits, without a sign, whitespace or any
+// other characters. Returns false if digits is not a bug ID.
+func ParseBugID(digits string) (int, bool) {
+	if strings.IndexByte(digits, 0) >= 0 {
+		return 0, false
+	}
+	id := parseBugID(digits)
+	return id, id != 0
+}
+
+// TaskSnapshot holds the field values of a single task, as returned by
+// Backlog.Snapshot()
+type TaskSnapshot struct {
+	Task              Task
+	Hyperlink         string
+	Description       string
+	Assignee          Resource
+	Status            Status
+	EstimatedDuration time.Duration
+	Priority          Priority
+	Milestone         Milestone
+	Sprint            Sprint
+	// Columns holds the values of the custom columns passed to Snapshot(), in
+	// the same order.
+	Columns []string
+	// Err is the error for the first field that could not be read, if any.
+	// Fields are checked in the order of the struct, so if the hyperlink could
+	// not be read then Err describes the hyperlink error.
+	Err error
+}
+
+// TaskExpected holds the expected field values of a task, as passed to
+// Backlog.Compare()
+type TaskExpected struct {
+	Task              Task
+	Hyperlink         string
+	Description       string
+	Assignee          Resource // nil for unassigned
+	Status            Status
+	EstimatedDuration time.Duration // Compared in whole minutes
+	Priority          Priority
+	Milestone         Milestone // nil for none
+	Sprint            Sprint    // nil for none
+	// Ignore is the set of fields that are not compared
+	Ignore FieldMask
+}
+
+// FieldMask is a set of task fields
+type FieldMask uint32
+
+// The task fields of a FieldMask
+const (
+	FieldHyperlink         = FieldMask(1 << taskFieldHyperlink)
+	FieldDescription       = FieldMask(1 << taskFieldDescription)
+	FieldAssignee          = FieldMask(1 << taskFieldResource)
+	FieldStatus            = FieldMask(1 << taskFieldWorkflowStatus)
+	FieldEstimatedDuration = FieldMask(1 << taskFieldIdealDays)
+	FieldPriority          = FieldMask(1 << taskFieldPriority)
+	FieldMilestone         = FieldMask(1 << taskFieldMilestone)
+	FieldSprint            = FieldMask(1 << taskFieldSprint)
+)
+
+func (m FieldMask) String() string {
+	fields := []string{}
+	for f := taskField(0); f < taskFieldCount; f++ {
+		if m&(1<<f) != 0 {
+			fields = append(fields, f.String())
+		}
+	}
+	return "[" + strings.Join(fields, ", ") + "]"
+}
+
+// CustomColumn is a custom column of a Hansoft project, as returned by
+// Project.CustomColumns()
+type CustomColumn struct {
+	Name string
+	hash uint32
 }
 
 // Milestone is the interface to a Hansoft project milestone
@@ -67,7 +246,11 @@ type Task interface {
 	Hyperlink() (string, error)
 	Milestone() (Milestone, error)
 	Priority() (Priority, error)
+	// CustomColumn returns the value of the task's custom column
+	CustomColumn(CustomColumn) (string, error)
 	SetAssignee(Resource) error
+	// SetCustomColumn sets the value of the task's custom column
+	SetCustomColumn(CustomColumn, string) error
 	SetDescription(string) error
 	SetEstimatedDuration(time.Duration) error
 	SetHyperlink(string) error
@@ -106,23 +289,36 @@ type hansoft struct {
 }
 
 func (h *hansoft) Connect(address string, port int, database, user, password string) (Session, error) {
-	s := &session{sdk: h.sdk}
-	s.sessionProcess.events = make(chan struct{}, 256)
-	s.sessionProcess.done = make(chan struct{})
-	handle, err := h.sdk.SessionOpen(address, port, database, user, password, s)
+	return h.ConnectPool(address, port, database, user, password, 1, true)
+}
+
+func (h *hansoft) ConnectNonBlocking(address string, port int, database, user, password string) (Session, error) {
+	return h.ConnectPool(address, port, database, user, password, 1, false)
+}
+
+func (h *hansoft) ConnectPool(address string, port int, database, user, password string, n int, blocking bool) (Session, error) {
+	s := &session{
+		sdk:          h.sdk,
+		blocking:     blocking,
+		scratch:      newArena(),
+		translations: newTranslationCache(),
+		processor:    newSessionProcessor(),
+	}
+	handle, err := h.sdk.SessionOpen(address, port, database, user, password, blocking, true, s)
 	if err != nil {
+		s.scratch.free()
 		return nil, err
 	}
 	s.handle = handle
+	s.readers = []*reader{{handle: handle, scratch: s.scratch}}
+	if err := s.openReaders(address, port, database, user, password, n-1); err != nil {
+		s.closeReaders()
+		s.sdk.SessionClose(s.handle, s)
+		s.scratch.free()
+		return nil, err
+	}
 
-	go func() {
-		defer close(s.sessionProcess.done)
-		for range s.sessionProcess.events {
-			if err := s.sdk.SessionProcess(s.handle); err != nil {
-				fmt.Println("SessionProcess() returned", err)
-			}
-		}
-	}()
+	go s.processor.run(s.processAll)
 
 	noMilestoneID, err := s.sdk.UtilGetNoMilestoneID(s.handle)
 	if err != nil {
@@ -134,28 +330,41 @@ func (h *hansoft) Connect(address string, port int, database, user, password str
 	return s, nil
 }
 
+func (h *hansoft) CallStats() []CallStats {
+	return h.sdk.metrics.stats()
+}
+
 func (h *hansoft) Destroy() error {
 	h.sdk.Destroy()
 	return nil
 }
 
 type session struct {
-	sdk            *sdk
-	handle         unsafe.Pointer
-	noMilestoneID  taskRef
-	sessionProcess struct {
-		events chan struct{}
-		done   chan struct{}
-	}
+	sdk           *sdk
+	handle        unsafe.Pointer
+	blocking      bool   // If false, writes are tracked by each project's pending
+	scratch       *arena // Used to marshal the arguments of SDK calls
+	translations  *translationCache
+	noMilestoneID taskRef
+	projectsMutex sync.RWMutex
+	projects      map[uniqueID]*project // Projects that receive change callbacks
+	processor     *sessionProcessor
+	readers       []*reader // Connections used for batched reads
 }
 
 func (s *session) Destroy() error {
-	close(s.sessionProcess.events)
-	<-s.sessionProcess.done
+	s.processor.shutdown()
+	s.closeReaders()
 	if err := s.sdk.SessionStop(s.handle); err != nil {
 		return err
 	}
-	return s.sdk.SessionClose(s.handle, s)
+	err := s.sdk.SessionClose(s.handle, s)
+	s.scratch.free()
+	return err
+}
+
+func (s *session) ProcessStats() ProcessStats {
+	return s.processor.processStats()
 }
 
 func (s *session) Projects() ([]Project, error) {
@@ -164,6 +373,7 @@ func (s *session) Projects() ([]Project, error) {
 		return nil, err
 	}
 	out := make([]Project, len(ids))
+	projects := make(map[uniqueID]*project, len(ids))
 	for i, id := range ids {
 		backlogID, err := s.sdk.ProjectUtilGetBacklog(s.handle, id)
 		if err != nil {
@@ -173,78 +383,416 @@ func (s *session) Projects() ([]Project, error) {
 		if err != nil {
 			return nil, err
 		}
-		workflowIDs, err := s.sdk.ProjectWorkflowEnum(s.handle, id)
-		if err != nil {
-			return nil, err
+		project := &project{session: s, id: id, properties: props, tasks: map[uniqueID]*task{}}
+		project.backlog = &backlog{project: project, id: backlogID, index: &taskIndex{}}
+		project.changes.reset()
+		projects[id] = project
+		out[i] = project
+	}
+
+	s.projectsMutex.Lock()
+	s.projects = projects
+	s.projectsMutex.Unlock()
+
+	return out, nil
+}
+
+func (s *session) onProcessCallback() {
+	s.processor.wake()
+}
+
+func (s *session) onChangeCallback(c change) {
+	s.projectsMutex.RLock()
+	defer s.projectsMutex.RUnlock()
+	// Only the writes of a non-blocking session are tracked
+	if !s.blocking && (c.kind == changeTaskField || c.kind == changeTaskColumn) {
+		w := pendingWrite{uniqueID(c.id), changeField(c.field), 0}
+		if c.kind == changeTaskColumn {
+			w = pendingWrite{uniqueID(c.id), changeFieldCustomColumn, uint32(c.field)}
 		}
-		statusToIDs := map[Status]int{}
-		idToStatus := map[int]Status{}
-		for workflowID := range workflowIDs {
-			statusByString, err := s.sdk.ProjectWorkflowGetStatuses(s.handle, id, workflowID)
-			if err != nil {
-				return nil, err
+		// The change callback does not identify the project
+		for _, p := range s.projects {
+			if c.echo = p.pending.confirm(w); c.echo {
+				break
 			}
-			for i, s := range statusByString {
-				statusToIDs[Status(s)] = i
-				idToStatus[i] = Status(s)
+		}
+	}
+	switch c.kind {
+	case changeTaskCreate:
+		// Tasks are created in either the project's backlog, or the project
+		// itself (milestones, sprints and sprint proxies)
+		for _, p := range s.projects {
+			if c.container == p.id || c.container == p.backlog.id {
+				p.onChange(c)
 			}
 		}
-		resourceIDs, err := s.sdk.ProjectResourceEnum(s.handle, id)
+	case changeResource, changeWorkflow, changeColumns:
+		if p, ok := s.projects[c.container]; ok {
+			p.onChange(c)
+			return
+		}
+		fallthrough
+	default:
+		// The change callback does not identify the project
+		for _, p := range s.projects {
+			p.onChange(c)
+		}
+	}
+}
+
+type project struct {
+	session    *session
+	id         uniqueID
+	backlog    *backlog
+	properties projectProperties
+	changes    changeTracker
+	pending    pendingWrites // Unconfirmed writes of a non-blocking session
+
+	// Metadata, loaded on first use. nil when not loaded.
+	metadataMutex sync.Mutex
+	resources     map[uniqueID]Resource
+	milestones    map[uniqueID]Milestone
+	sprints       map[uniqueID]Sprint
+	columns       []CustomColumn
+	snapshotTime  time.Time // Time of the loaded snapshot. Zero if not loaded.
+
+	// Workflows, loaded on first use, and invalidated by workflow change
+	// callbacks. nil when not loaded.
+	statusesMutex sync.Mutex
+	workflows     []int                     // Workflow IDs
+	statuses      map[int]*workflowStatuses // Workflow ID to statuses
+	statusesGen   int                       // Incremented on invalidation
+
+	tasksMutex sync.Mutex
+	tasks      map[uniqueID]*task // Interned tasks
+}
+
+// workflowStatuses maps the statuses of a single workflow to and from their IDs
+type workflowStatuses struct {
+	toID   map[Status]int
+	fromID map[int]Status
+}
+
+// onChange is called by the session for each change callback for the project
+func (p *project) onChange(c change) {
+	if c.kind == changeWorkflow {
+		p.invalidateWorkflow(int(c.id))
+	}
+	p.backlog.index.onChange(c)
+	p.changes.add(c)
+}
+
+// invalidateMetadata drops the loaded resources, milestones and sprints, so
+// that they are reloaded on next use. Workflows are invalidated separately by
+// invalidateWorkflow().
+func (p *project) invalidateMetadata() {
+	p.metadataMutex.Lock()
+	defer p.metadataMutex.Unlock()
+	p.resources = nil
+	p.milestones = nil
+	p.sprints = nil
+	p.columns = nil
+	if !p.snapshotTime.IsZero() {
+		// The workflow statuses also came from the snapshot, and may be stale
+		p.snapshotTime = time.Time{}
+		p.statusesMutex.Lock()
+		p.workflows = nil
+		p.statuses = nil
+		p.statusesGen++
+		p.statusesMutex.Unlock()
+	}
+}
+
+// invalidateWorkflow drops the loaded statuses of the given workflow, and the
+// list of workflows.
+func (p *project) invalidateWorkflow(workflow int) {
+	p.statusesMutex.Lock()
+	defer p.statusesMutex.Unlock()
+	delete(p.statuses, workflow)
+	p.workflows = nil
+	p.statusesGen++
+}
+
+// getWorkflows returns the IDs of the project's workflows, loading them if
+// needed
+func (p *project) getWorkflows() ([]int, error) {
+	p.statusesMutex.Lock()
+	workflows, gen := p.workflows, p.statusesGen
+	p.statusesMutex.Unlock()
+	if workflows != nil {
+		return workflows, nil
+	}
+
+	s := p.session
+	workflows, err := s.sdk.ProjectWorkflowEnum(s.handle, p.id)
+	if err != nil {
+		return nil, err
+	}
+
+	p.statusesMutex.Lock()
+	defer p.statusesMutex.Unlock()
+	if p.statusesGen == gen { // Not invalidated while loading
+		p.workflows = workflows
+	}
+	return workflows, nil
+}
+
+// getWorkflowStatuses returns the statuses of the given workflow, loading them
+// if needed
+func (p *project) getWorkflowStatuses(workflow int) (*workflowStatuses, error) {
+	p.statusesMutex.Lock()
+	statuses, gen := p.statuses[workflow], p.statusesGen
+	p.statusesMutex.Unlock()
+	if statuses != nil {
+		return statuses, nil
+	}
+
+	s := p.session
+	statusByID, err := s.sdk.ProjectWorkflowGetStatuses(s.handle, s.translations, p.id, workflow)
+	if err != nil {
+		return nil, fmt.Errorf("Failed to get statuses of workflow %v: %w", workflow, err)
+	}
+	statuses = &workflowStatuses{toID: map[Status]int{}, fromID: map[int]Status{}}
+	for id, name := range statusByID {
+		statuses.toID[Status(name)] = id
+		statuses.fromID[id] = Status(name)
+	}
+
+	p.statusesMutex.Lock()
+	defer p.statusesMutex.Unlock()
+	if p.statusesGen == gen { // Not invalidated while loading
+		if p.statuses == nil {
+			p.statuses = map[int]*workflowStatuses{}
+		}
+		p.statuses[workflow] = statuses
+	}
+	return statuses, nil
+}
+
+// getResources returns the project's resources, loading them if needed
+func (p *project) getResources() (map[uniqueID]Resource, error) {
+	p.metadataMutex.Lock()
+	defer p.metadataMutex.Unlock()
+	if p.resources != nil {
+		return p.resources, nil
+	}
+	s := p.session
+	resourceIDs, err := s.sdk.ProjectResourceEnum(s.handle, p.id)
+	if err != nil {
+		return nil, err
+	}
+	loaded := make([]resource, len(resourceIDs))
+	err = s.parallel(len(resourceIDs), func(r *reader, i int) error {
+		res, err := s.sdk.ResourceGetProperties(r.handle, resourceIDs[i])
+		loaded[i] = res
+		return err
+	})
+	if err != nil {
+		return nil, err
+	}
+	resources := make(map[uniqueID]Resource, len(loaded))
+	for _, r := range loaded {
+		resources[r.id] = r
+	}
+	p.resources = resources
+	return resources, nil
+}
+
+// getMilestones returns the project's milestones, loading them if needed
+func (p *project) getMilestones() (map[uniqueID]Milestone, error) {
+	p.metadataMutex.Lock()
+	defer p.metadataMutex.Unlock()
+	if p.milestones != nil {
+		return p.milestones, nil
+	}
+	s := p.session
+	milestoneRefs, err := s.sdk.ProjectGetMilestones(s.handle, p.id)
+	if err != nil {
+		return nil, err
+	}
+	loaded := make([]*milestone, len(milestoneRefs))
+	err = s.parallel(len(milestoneRefs), func(r *reader, i int) error {
+		ref := milestoneRefs[i]
+		id, err := s.sdk.TaskRefGetTask(r.handle, ref)
 		if err != nil {
-			return nil, err
+			return fmt.Errorf("Failed to get milestone task ID: %w", err)
 		}
-		resources := map[uniqueID]Resource{}
-		for _, id := range resourceIDs {
-			r, err := s.sdk.ResourceGetProperties(s.handle, id)
-			if err != nil {
-				return nil, err
-			}
-			resources[r.id] = r
+		name, err := s.sdk.TaskGetDescription(r.handle, id)
+		if err != nil {
+			return fmt.Errorf("Failed to get milestone name: %w", err)
 		}
-		milestoneRefs, err := s.sdk.ProjectGetMilestones(s.handle, id)
+		loaded[i] = &milestone{p, ref, id, name}
+		return nil
+	})
+	if err != nil {
+		return nil, err
+	}
+	milestones := make(map[uniqueID]Milestone, len(loaded))
+	for _, m := range loaded {
+		milestones[m.id] = m
+	}
+	p.milestones = milestones
+	return milestones, nil
+}
+
+// getSprints returns the project's sprints, loading them if needed
+func (p *project) getSprints() (map[uniqueID]Sprint, error) {
+	p.metadataMutex.Lock()
+	defer p.metadataMutex.Unlock()
+	if p.sprints != nil {
+		return p.sprints, nil
+	}
+	s := p.session
+	sprintIDs, err := s.sdk.ProjectGetSprints(s.handle, p.id)
+	if err != nil {
+		return nil, err
+	}
+	loaded := make([]*sprint, len(sprintIDs))
+	err = s.parallel(len(sprintIDs), func(r *reader, i int) error {
+		id := sprintIDs[i]
+		ref, err := s.sdk.TaskGetMainReference(r.handle, id)
 		if err != nil {
-			return nil, err
+			return fmt.Errorf("Failed to get sprint ref: %w", err)
 		}
-		sprintIDs, err := s.sdk.ProjectGetSprints(s.handle, id)
+		name, err := s.sdk.TaskGetDescription(r.handle, id)
 		if err != nil {
-			return nil, err
+			return fmt.Errorf("Failed to get sprint name: %w", err)
 		}
-		project := &project{s, id, nil, props, statusToIDs, idToStatus, resources, map[uniqueID]Milestone{}, map[uniqueID]Sprint{}}
-		project.backlog = &backlog{project, backlogID}
-		for _, ref := range milestoneRefs {
-			id, err := s.sdk.TaskRefGetTask(s.handle, ref)
-			if err != nil {
-				return nil, fmt.Errorf("Failed to get milestone task ID: %w", err)
-			}
-			project.milestones[id] = &milestone{project, ref, id}
+		loaded[i] = &sprint{p, ref, id, name}
+		return nil
+	})
+	if err != nil {
+		return nil, err
+	}
+	sprints := make(map[uniqueID]Sprint, len(loaded))
+	for _, sp := range loaded {
+		sprints[sp.id] = sp
+	}
+	p.sprints = sprints
+	return sprints, nil
+}
+
+func (p *project) CustomColumns() ([]CustomColumn, error) {
+	p.metadataMutex.Lock()
+	defer p.metadataMutex.Unlock()
+	if p.columns != nil {
+		return p.columns, nil
+	}
+	loaded, err := p.session.sdk.ProjectCustomColumnsGet(p.session.handle, p.id)
+	if err != nil {
+		return nil, err
+	}
+	columns := make([]CustomColumn, len(loaded))
+	for i, c := range loaded {
+		columns[i] = CustomColumn{Name: c.name, hash: c.hash}
+	}
+	p.columns = columns
+	return columns, nil
+}
+
+func (p *project) SetSprints(sprints map[Task]Sprint) error {
+	s := p.session
+	link := map[*sprint][]*task{}   // Sprint to tasks that need adding
+	unlink := map[taskRef][]*task{} // Old sprint ref to tasks that need removing
+	for t, sp := range sprints {
+		if sp == nil {
+			continue
+		}
+		task, target := t.(*task), sp.(*sprint)
+		current, err := s.sdk.TaskGetLinkedToSprint(s.handle, task.id)
+		if err != nil {
+			return fmt.Errorf("TaskGetLinkedToSprint() returned %w", err)
 		}
-		for _, id := range sprintIDs {
-			ref, err := s.sdk.TaskGetMainReference(s.handle, id)
+		if current != -1 {
+			currentID, err := s.sdk.TaskRefGetTask(s.handle, current)
 			if err != nil {
-				return nil, fmt.Errorf("Failed to get sprint ref: %w", err)
+				return fmt.Errorf("Failed to get sprint task ID: %w", err)
+			}
+			if currentID == target.id {
+				continue // Already in the sprint
 			}
-			project.sprints[id] = &sprint{project, ref, id}
+			unlink[current] = append(unlink[current], task)
 		}
-		out[i] = project
+		link[target] = append(link[target], task)
 	}
 
-	return out, nil
+	for sprintRef, tasks := range unlink {
+		if err := p.removeSprintProxies(sprintRef, tasks); err != nil {
+			return err
+		}
+	}
+	for target, tasks := range link {
+		refs := make([]taskRef, len(tasks))
+		for i, t := range tasks {
+			refs[i] = t.ref
+		}
+		if err := s.sdk.TaskSetLinkedToSprint(s.handle, s.scratch, p.id, refs, target.ref); err != nil {
+			return err
+		}
+		if p.backlog.index.enabled() {
+			// Record the proxies, so they can be removed directly
+			for _, t := range tasks {
+				if proxy, err := s.sdk.TaskGetProxy(s.handle, t.id); err == nil {
+					p.backlog.index.setProxy(t.ref, proxy)
+				}
+			}
+		}
+	}
+	return nil
 }
 
-func (s *session) onProcessCallback() {
-	s.sessionProcess.events <- struct{}{}
+// removeSprintProxies deletes the proxies of the given tasks from the sprint
+func (p *project) removeSprintProxies(sprintRef taskRef, tasks []*task) error {
+	s := p.session
+	children, err := s.sdk.TaskRefUtilEnumChildren(s.handle, sprintRef)
+	if err != nil {
+		return fmt.Errorf("TaskRefUtilEnumChildren() returned %w", err)
+	}
+	inSprint := make(map[taskRef]bool, len(children))
+	for _, child := range children {
+		inSprint[child] = true
+	}
+	remove := make(map[uniqueID]bool, len(tasks))
+	for _, t := range tasks {
+		// Proxies recorded by the task index are removed without reading the
+		// task of each of the sprint's children, if they are still in the
+		// sprint and still belong to the task
+		if proxy := p.backlog.index.proxy(t.ref); proxy != -1 && inSprint[proxy] {
+			if id, err := s.sdk.TaskRefGetTask(s.handle, proxy); err == nil && id == t.id {
+				if err := s.sdk.TaskRefDelete(s.handle, proxy); err != nil {
+					return fmt.Errorf("Failed to remove sprint proxy: %w", err)
+				}
+				p.backlog.index.setProxy(t.ref, -1)
+				continue
+			}
+		}
+		remove[t.id] = true
+	}
+	if len(remove) == 0 {
+		return nil
+	}
+	for _, child := range children {
+		id, err := s.sdk.TaskRefGetTask(s.handle, child)
+		if err != nil || !remove[id] {
+			continue
+		}
+		if err := s.sdk.TaskRefDelete(s.handle, child); err != nil {
+			return fmt.Errorf("Failed to remove sprint proxy: %w", err)
+		}
+	}
+	return nil
 }
 
-type project struct {
-	session     *session
-	id          uniqueID
-	backlog     *backlog
-	properties  projectProperties
-	statusToIDs map[Status]int
-	idToStatus  map[int]Status
-	resources   map[uniqueID]Resource
-	milestones  map[uniqueID]Milestone
-	sprints     map[uniqueID]Sprint
+// task returns the interned task with the given ID and ref
+func (p *project) task(id uniqueID, ref taskRef) *task {
+	p.tasksMutex.Lock()
+	defer p.tasksMutex.Unlock()
+	if t, ok := p.tasks[id]; ok {
+		return t
+	}
+	t := &task{p, id, ref}
+	p.tasks[id] = t
+	return t
 }
 
 func (p *project) Name() string {
@@ -255,73 +803,94 @@ func (p *project) Backlog() Backlog {
 	return p.backlog
 }
 
-func (p *project) Statuses() []Status {
-	out := make([]Status, 0, len(p.statusToIDs))
-	for s := range p.statusToIDs {
+func (p *project) Statuses() ([]Status, error) {
+	workflows, err := p.getWorkflows()
+	if err != nil {
+		return nil, err
+	}
+	set := map[Status]struct{}{}
+	for _, workflow := range workflows {
+		statuses, err := p.getWorkflowStatuses(workflow)
+		if err != nil {
+			return nil, err
+		}
+		for s := range statuses.toID {
+			set[s] = struct{}{}
+		}
+	}
+	out := make([]Status, 0, len(set))
+	for s := range set {
 		out = append(out, s)
 	}
 	sort.Strings([]string(out))
-	return out
+	return out, nil
 }
 
-func (p *project) Resources() []Resource {
-	out := make([]Resource, 0, len(p.resources))
-	for _, r := range p.resources {
+func (p *project) Resources() ([]Resource, error) {
+	resources, err := p.getResources()
+	if err != nil {
+		return nil, err
+	}
+	out := make([]Resource, 0, len(resources))
+	for _, r := range resources {
 		out = append(out, r)
 	}
 	sort.Slice(out, func(a, b int) bool { return out[a].Name() < out[b].Name() })
-	return out
+	return out, nil
 }
 
-func (p *project) Milestones() []Milestone {
-	out := make([]Milestone, 0, len(p.milestones))
-	for _, r := range p.milestones {
+func (p *project) Milestones() ([]Milestone, error) {
+	milestones, err := p.getMilestones()
+	if err != nil {
+		return nil, err
+	}
+	out := make([]Milestone, 0, len(milestones))
+	for _, r := range milestones {
 		out = append(out, r)
 	}
 	sort.Slice(out, func(a, b int) bool { return out[a].(*milestone).id < out[b].(*milestone).id })
-	return out
+	return out, nil
 }
 
-func (p *project) Sprints() []Sprint {
-	out := make([]Sprint, 0, len(p.sprints))
-	for _, r := range p.sprints {
+func (p *project) Sprints() ([]Sprint, error) {
+	sprints, err := p.getSprints()
+	if err != nil {
+		return nil, err
+	}
+	out := make([]Sprint, 0, len(sprints))
+	for _, r := range sprints {
 		out = append(out, r)
 	}
 	sort.Slice(out, func(a, b int) bool { return out[a].(*sprint).ref < out[b].(*sprint).ref })
-	return out
+	return out, nil
 }
 
 type milestone struct {
 	project *project
 	ref     taskRef
 	id      uniqueID
+	name    string // Loaded with the project metadata
 }
 
 func (m *milestone) Name() (string, error) {
-	description, err := m.project.session.sdk.TaskGetDescription(m.project.session.handle, m.id)
-	if err != nil {
-		return "", fmt.Errorf("Failed to get milestone name: %w", err)
-	}
-	return description, nil
+	return m.name, nil
 }
 
 type sprint struct {
 	project *project
 	ref     taskRef
 	id      uniqueID
+	name    string // Loaded with the project metadata
 }
 
 func (m *sprint) Name() (string, error) {
-	description, err := m.project.session.sdk.TaskGetDescription(m.project.session.handle, m.id)
-	if err != nil {
-		return "", fmt.Errorf("Failed to get sprint name: %w", err)
-	}
-	return description, nil
+	return m.name, nil
 }
 
 type backlog struct {
 	project *project
 	id      uniqueID
+	index   *taskIndex
 }
 
 func (b *backlog) Tasks() ([]Task, error) {
@@ -335,13 +904,46 @@ func (b *backlog) Tasks() ([]Task, error) {
 		if err != nil {
 			return nil, fmt.Errorf("Failed to get task ID: %w", err)
 		}
-		out[i] = &task{b.project, id, ref}
+		out[i] = b.project.task(id, ref)
 	}
 	return out, nil
 }
 
+// readChunkSize is the number of tasks read by each worker of a batched read
+// that is spread across a session's connections
+const readChunkSize = 256
+
+func (b *backlog) LinkedTasks(prefix string) ([]LinkedTask, LinkedCounts, error) {
+	if b.index.isLoaded(prefix) {
+		return b.linkedTasksIndexed()
+	}
+	s := b.project.session
+	var linked []linkedTask
+	var counts LinkedCounts
+	if len(s.readers) == 1 {
+		l, c, err := s.sdk.TaskRefEnumLinked(s.handle, s.scratch, b.id, prefix)
+		if err != nil {
+			return nil, LinkedCounts{}, err
+		}
+		linked, counts = l, c
+	} else {
+		refs, err := s.sdk.TaskRefEnum(s.handle, b.id)
+		if err != nil {
+			return nil, LinkedCounts{}, err
+		}
+		if linked, counts, err = b.filterLinked(refs, prefix); err != nil {
+			return nil, LinkedCounts{}, err
+		}
+	}
+	out := make([]LinkedTask, len(linked))
+	for i, l := range linked {
+		out[i] = LinkedTask{l.bug, b.project.task(l.id, l.ref)}
+	}
+	return out, counts, nil
+}
+
 func (b *backlog) NewTask() (Task, error) {
-	ref, err := b.project.session.sdk.TaskCreateUnified(b.project.session.handle, b.id, unifiedTaskPlanned)
+	ref, err := b.project.session.sdk.TaskCreateUnified(b.project.session.handle, b.project.session.scratch, b.id, unifiedTaskPlanned)
 	if err != nil {
 		return nil, err
 	}
@@ -349,7 +951,206 @@ func (b *backlog) NewTask() (Task, error) {
 	if err != nil {
 		return nil, fmt.Errorf("Failed to get task ID: %w", err)
 	}
-	return &task{b.project, id, ref}, nil
+	return b.project.task(id, ref), nil
+}
+
+func (b *backlog) Snapshot(tasks []Task, columns ...CustomColumn) ([]TaskSnapshot, error) {
+	ids := make([]uniqueID, len(tasks))
+	for i, t := range tasks {
+		ids[i] = t.(*task).id
+	}
+	p := b.project
+	resources, err := p.getResources()
+	if err != nil {
+		return nil, err
+	}
+	milestones, err := p.getMilestones()
+	if err != nil {
+		return nil, err
+	}
+	sprints, err := p.getSprints()
+	if err != nil {
+		return nil, err
+	}
+	s := p.session
+	snapshots := make([]taskSnapshot, len(ids))
+	var hashes []uint32
+	var columnValues [][]string
+	var columnErrs []error
+	if len(columns) > 0 {
+		hashes = make([]uint32, len(columns))
+		for i, c := range columns {
+			hashes[i] = c.hash
+		}
+		columnValues = make([][]string, len(ids))
+		columnErrs = make([]error, len(ids))
+	}
+	chunks := (len(ids) + readChunkSize - 1) / readChunkSize
+	err = s.parallel(chunks, func(r *reader, i int) error {
+		start, end := i*readChunkSize, (i+1)*readChunkSize
+		if end > len(ids) {
+			end = len(ids)
+		}
+		copy(snapshots[start:end], s.sdk.TaskSnapshot(r.handle, r.scratch, ids[start:end], s.noMilestoneID))
+		if len(hashes) > 0 {
+			values, errs := s.sdk.TaskCustomColumns(r.handle, r.scratch, ids[start:end], hashes)
+			copy(columnValues[start:end], values)
+			copy(columnErrs[start:end], errs)
+		}
+		return nil
+	})
+	if err != nil {
+		return nil, fmt.Errorf("Failed to snapshot hansoft tasks: %w", err)
+	}
+	statuses := map[int]*workflowStatuses{}
+	out := make([]TaskSnapshot, len(snapshots))
+	for i, snap := range snapshots {
+		o := TaskSnapshot{
+			Task:              tasks[i],
+			Hyperlink:         snap.hyperlink,
+			Description:       snap.description,
+			EstimatedDuration: idealDaysToDuration(snap.idealDays),
+			Priority:          snap.priority,
+		}
+		if snap.errors[taskFieldWorkflowStatus] == nil {
+			if o.Status, err = p.statusName(snap.workflow, snap.workflowStatus, statuses); err != nil {
+				return nil, err
+			}
+		}
+		if snap.resource != -1 {
+			o.Assignee = resources[snap.resource]
+		}
+		if snap.milestone != -1 {
+			o.Milestone = milestones[snap.milestone]
+		}
+		if snap.sprint != -1 {
+			o.Sprint = sprints[snap.sprint]
+		}
+		for f, err := range snap.errors {
+			// Errors reading the workflow status are ignored, matching task.Status()
+			if err != nil && taskField(f) != taskFieldWorkflowStatus {
+				o.Err = fmt.Errorf("Failed to get hansoft task %v: %w", taskField(f), err)
+				break
+			}
+		}
+		if columnValues != nil {
+			o.Columns = columnValues[i]
+			if err := columnErrs[i]; err != nil && o.Err == nil {
+				o.Err = fmt.Errorf("Failed to get hansoft task custom columns: %w", err)
+			}
+		}
+		out[i] = o
+	}
+	return out, nil
+}
+
+func (b *backlog) Compare(expected []TaskExpected) ([]FieldMask, error) {
+	p := b.project
+	s := p.session
+	in := make([]taskExpected, len(expected))
+	for i, e := range expected {
+		in[i] = taskExpected{
+			task:        e.Task.(*task).id,
+			hyperlink:   e.Hyperlink,
+			description: e.Description,
+			resource:    -1,
+			minutes:     int64(e.EstimatedDuration / time.Minute),
+			priority:    e.Priority,
+			milestone:   -1,
+			sprint:      -1,
+			ignore:      taskFieldMask(e.Ignore),
+		}
+		if e.Assignee != nil {
+			in[i].resource = e.Assignee.(resource).id
+		}
+		if e.Milestone != nil {
+			in[i].milestone = e.Milestone.(*milestone).id
+		}
+		if e.Sprint != nil {
+			in[i].sprint = e.Sprint.(*sprint).id
+		}
+	}
+	compared := make([]taskCompared, len(in))
+	chunks := (len(in) + readChunkSize - 1) / readChunkSize
+	err := s.parallel(chunks, func(r *reader, i int) error {
+		start, end := i*readChunkSize, (i+1)*readChunkSize
+		if end > len(in) {
+			end = len(in)
+		}
+		copy(compared[start:end], s.sdk.TaskCompare(r.handle, r.scratch, in[start:end], s.noMilestoneID))
+		return nil
+	})
+	if err != nil {
+		return nil, fmt.Errorf("Failed to compare hansoft tasks: %w", err)
+	}
+	statuses := map[int]*workflowStatuses{}
+	out := make([]FieldMask, len(compared))
+	for i, c := range compared {
+		out[i] = FieldMask(c.mismatch)
+		if expected[i].Ignore&FieldStatus != 0 {
+			continue
+		}
+		status, err := p.statusName(c.workflow, c.workflowStatus, statuses)
+		if err != nil {
+			return nil, err
+		}
+		if status != expected[i].Status {
+			out[i] |= FieldStatus
+		}
+	}
+	return out, nil
+}
+
+// filterLinked returns the tasks of refs that have a hyperlink of the form
+// <prefix><ID>, along with the counts of the tasks that could not be linked.
+// The refs are spread across the session's readers.
+func (b *backlog) filterLinked(refs []taskRef, prefix string) ([]linkedTask, LinkedCounts, error) {
+	s := b.project.session
+	chunks := (len(refs) + readChunkSize - 1) / readChunkSize
+	linkedChunks := make([][]linkedTask, chunks)
+	countChunks := make([]LinkedCounts, chunks)
+	err := s.parallel(chunks, func(r *reader, i int) error {
+		end := (i + 1) * readChunkSize
+		if end > len(refs) {
+			end = len(refs)
+		}
+		l, c, err := s.sdk.TaskRefFilterLinked(r.handle, r.scratch, refs[i*readChunkSize:end], prefix)
+		linkedChunks[i], countChunks[i] = l, c
+		return err
+	})
+	if err != nil {
+		return nil, LinkedCounts{}, err
+	}
+	var linked []linkedTask
+	var counts LinkedCounts
+	for i := range linkedChunks {
+		linked = append(linked, linkedChunks[i]...)
+		counts.Malformed += countChunks[i].Malformed
+		counts.Unreadable += countChunks[i].Unreadable
+	}
+	return linked, counts, nil
+}
+
+// maxTaskCreateBatch is the maximum number of tasks created by a single
+// TaskCreateUnified() call
+const maxTaskCreateBatch = 256
+
+func (b *backlog) NewTasks(n int) ([]Task, error) {
+	out := make([]Task, 0, n)
+	for len(out) < n {
+		count := n - len(out)
+		if count > maxTaskCreateBatch {
+			count = maxTaskCreateBatch
+		}
+		refs, ids, err := b.project.session.sdk.TaskCreatePlannedBatch(b.project.session.handle, b.project.session.scratch, b.id, count)
+		for i := range refs {
+			out = append(out, b.project.task(ids[i], refs[i]))
+		}
+		if err != nil {
+			return out, err
+		}
+	}
+	return out, nil
 }
 
 type task struct {
@@ -367,22 +1168,111 @@ func (t *task) Description() (string, error) {
 }
 
 func (t *task) SetDescription(description string) error {
-	return t.project.session.sdk.TaskSetDescription(t.project.session.handle, t.id, description)
+	applied := func() bool {
+		current, err := t.Description()
+		return err == nil && current == description
+	}
+	return t.write(changeFieldDescription, applied, func() error {
+		return t.project.session.sdk.TaskSetDescription(t.project.session.handle, t.project.session.scratch, t.id, description)
+	})
 }
 
 func (t *task) Status() (Status, error) {
+	workflow, err := t.project.session.sdk.TaskGetWorkflow(t.project.session.handle, t.id)
+	if err != nil {
+		return "", nil
+	}
 	s, err := t.project.session.sdk.TaskGetWorkflowStatus(t.project.session.handle, t.id)
 	if err != nil {
 		return "", nil
 	}
-	return t.project.idToStatus[s], nil
+	return t.project.statusName(workflow, s, nil)
 }
 
 func (t *task) SetStatus(status Status) error {
-	if id, ok := t.project.statusToIDs[status]; ok {
+	workflow, err := t.project.session.sdk.TaskGetWorkflow(t.project.session.handle, t.id)
+	if err != nil {
+		return fmt.Errorf("TaskGetWorkflow() returned %w", err)
+	}
+	var id int
+	var ok bool
+	if workflow == noWorkflow {
+		id, ok, err = t.project.anyWorkflowStatusID(status)
+	} else {
+		var statuses *workflowStatuses
+		if statuses, err = t.project.getWorkflowStatuses(workflow); err == nil {
+			id, ok = statuses.toID[status]
+		}
+	}
+	if err != nil {
+		return err
+	}
+	if !ok {
+		return fmt.Errorf("Unrecognized status '%v'", status)
+	}
+	applied := func() bool {
+		current, err := t.project.session.sdk.TaskGetWorkflowStatus(t.project.session.handle, t.id)
+		return err == nil && current == id
+	}
+	return t.write(changeFieldWorkflowStatus, applied, func() error {
 		return t.project.session.sdk.TaskSetWorkflowStatus(t.project.session.handle, t.id, id)
+	})
+}
+
+// statusName returns the name of the status with the ID, in the given
+// workflow. The status of a task without a workflow is looked up in each of
+// the project's workflows, as in anyWorkflowStatusID(). cache, if not nil,
+// holds the workflows already loaded by the caller.
+func (p *project) statusName(workflow, id int, cache map[int]*workflowStatuses) (Status, error) {
+	lookup := func(workflow int) (Status, bool, error) {
+		statuses, ok := cache[workflow]
+		if !ok {
+			var err error
+			if statuses, err = p.getWorkflowStatuses(workflow); err != nil {
+				return "", false, err
+			}
+			if cache != nil {
+				cache[workflow] = statuses
+			}
+		}
+		status, ok := statuses.fromID[id]
+		return status, ok, nil
 	}
-	return fmt.Errorf("Unrecognized status '%v'", status)
+	if workflow != noWorkflow {
+		status, _, err := lookup(workflow)
+		return status, err
+	}
+	workflows, err := p.getWorkflows()
+	if err != nil {
+		return "", err
+	}
+	for _, workflow := range workflows {
+		if status, ok, err := lookup(workflow); err != nil || ok {
+			return status, err
+		}
+	}
+	return "", nil
+}
+
+// anyWorkflowStatusID returns the ID of the status in the first of the
+// project's workflows that has it. Used for tasks without a workflow, which
+// take the status ID of any workflow, as all statuses did before they were
+// resolved per workflow.
+func (p *project) anyWorkflowStatusID(status Status) (int, bool, error) {
+	workflows, err := p.getWorkflows()
+	if err != nil {
+		return 0, false, err
+	}
+	for _, workflow := range workflows {
+		statuses, err := p.getWorkflowStatuses(workflow)
+		if err != nil {
+			return 0, false, err
+		}
+		if id, ok := statuses.toID[status]; ok {
+			return id, true, nil
+		}
+	}
+	return 0, false, nil
 }
 
 func (t *task) Milestone() (Milestone, error) {
@@ -399,7 +1289,11 @@ func (t *task) Milestone() (Milestone, error) {
 		if err != nil {
 			return nil, fmt.Errorf("Failed to get milestone task ID: %w", err)
 		}
-		return t.project.milestones[id], nil
+		milestones, err := t.project.getMilestones()
+		if err != nil {
+			return nil, err
+		}
+		return milestones[id], nil
 	}
 	return nil, nil
 }
@@ -411,7 +1305,19 @@ func (t *task) SetMilestone(m Milestone) error {
 	} else {
 		ids = []taskRef{t.project.session.noMilestoneID}
 	}
-	return t.project.session.sdk.TaskSetLinkedToMilestones(t.project.session.handle, t.id, ids)
+	applied := func() bool {
+		current, err := t.project.session.sdk.TaskGetLinkedToMilestones(t.project.session.handle, t.id)
+		if err != nil || len(current) > 1 {
+			return false
+		}
+		if len(current) == 0 {
+			return m == nil
+		}
+		return current[0] == ids[0]
+	}
+	return t.write(changeFieldMilestone, applied, func() error {
+		return t.project.session.sdk.TaskSetLinkedToMilestones(t.project.session.handle, t.project.session.scratch, t.id, ids)
+	})
 }
 
 func (t *task) Sprint() (Sprint, error) {
@@ -426,15 +1332,15 @@ func (t *task) Sprint() (Sprint, error) {
 	if err != nil {
 		return nil, fmt.Errorf("TaskGetMainReference() returned %w", err)
 	}
-	return t.project.sprints[id], nil
+	sprints, err := t.project.getSprints()
+	if err != nil {
+		return nil, err
+	}
+	return sprints[id], nil
 }
 
 func (t *task) SetSprint(s Sprint) error {
-	if s != nil {
-		ref := s.(*sprint).ref
-		return t.project.session.sdk.TaskSetLinkedToSprint(t.project.session.handle, t.project.id, t.ref, ref)
-	}
-	return nil
+	return t.project.SetSprints(map[Task]Sprint{t: s})
 }
 
 func (t *task) Priority() (Priority, error) {
@@ -442,7 +1348,13 @@ func (t *task) Priority() (Priority, error) {
 }
 
 func (t *task) SetPriority(p Priority) error {
-	return t.project.session.sdk.TaskSetBacklogPriority(t.project.session.handle, t.id, p)
+	applied := func() bool {
+		current, err := t.Priority()
+		return err == nil && current == p
+	}
+	return t.write(changeFieldPriority, applied, func() error {
+		return t.project.session.sdk.TaskSetBacklogPriority(t.project.session.handle, t.id, p)
+	})
 }
 
 const hoursInWorkingDay = 8
@@ -452,7 +1364,11 @@ func (t *task) EstimatedDuration() (time.Duration, error) {
 	if err != nil {
 		return 0, err
 	}
-	return time.Duration(days * hoursInWorkingDay * float64(time.Hour)), nil
+	return idealDaysToDuration(days), nil
+}
+
+func idealDaysToDuration(days float64) time.Duration {
+	return time.Duration(days * hoursInWorkingDay * float64(time.Hour))
 }
 
 func (t *task) SetEstimatedDuration(duration time.Duration) error {
@@ -460,7 +1376,13 @@ func (t *task) SetEstimatedDuration(duration time.Duration) error {
 	if duration != 0 {
 		days = float64(duration) / float64(time.Hour*hoursInWorkingDay)
 	}
-	return t.project.session.sdk.TaskSetEstimatedIdealDays(t.project.session.handle, t.id, days)
+	applied := func() bool {
+		current, err := t.project.session.sdk.TaskGetEstimatedIdealDays(t.project.session.handle, t.id)
+		return err == nil && current == days
+	}
+	return t.write(changeFieldIdealDays, applied, func() error {
+		return t.project.session.sdk.TaskSetEstimatedIdealDays(t.project.session.handle, t.id, days)
+	})
 }
 
 func (t *task) Assignee() (Resource, error) {
@@ -472,7 +1394,11 @@ func (t *task) Assignee() (Resource, error) {
 		return nil, nil
 	}
 	sort.Slice(allocations, func(a, b int) bool { return allocations[a].percent > allocations[b].percent })
-	return t.project.resources[allocations[0].resource], nil
+	resources, err := t.project.getResources()
+	if err != nil {
+		return nil, err
+	}
+	return resources[allocations[0].resource], nil
 }
 
 func (t *task) SetAssignee(r Resource) error {
@@ -485,7 +1411,16 @@ func (t *task) SetAssignee(r Resource) error {
 			},
 		}
 	}
-	return t.project.session.sdk.TaskSetResourceAllocation(t.project.session.handle, t.id, allocations)
+	applied := func() bool {
+		current, err := t.project.session.sdk.TaskGetResourceAllocation(t.project.session.handle, t.id)
+		if err != nil || len(current) != len(allocations) {
+			return false
+		}
+		return len(current) == 0 || current[0] == allocations[0]
+	}
+	return t.write(changeFieldResource, applied, func() error {
+		return t.project.session.sdk.TaskSetResourceAllocation(t.project.session.handle, t.project.session.scratch, t.id, allocations)
+	})
 }
 
 func (t *task) Hyperlink() (string, error) {
@@ -493,7 +1428,27 @@ func (t *task) Hyperlink() (string, error) {
 }
 
 func (t *task) SetHyperlink(link string) error {
-	return t.project.session.sdk.TaskSetHyperlink(t.project.session.handle, t.id, link)
+	applied := func() bool {
+		current, err := t.Hyperlink()
+		return err == nil && current == link
+	}
+	return t.write(changeFieldHyperlink, applied, func() error {
+		return t.project.session.sdk.TaskSetHyperlink(t.project.session.handle, t.project.session.scratch, t.id, link)
+	})
+}
+
+func (t *task) CustomColumn(c CustomColumn) (string, error) {
+	return t.project.session.sdk.TaskGetCustomColumnData(t.project.session.handle, t.id, c.hash)
+}
+
+func (t *task) SetCustomColumn(c CustomColumn, value string) error {
+	applied := func() bool {
+		current, err := t.CustomColumn(c)
+		return err == nil && current == value
+	}
+	return t.writeColumn(c.hash, applied, func() error {
+		return t.project.session.sdk.TaskSetCustomColumnData(t.project.session.handle, t.project.session.scratch, t.id, c.hash, value)
+	})
 }
 
 type resource struct {
@@ -0,0 +1,43 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import "testing"
+
+func TestParseBugID(t *testing.T) {
+	for _, test := range []struct {
+		digits string
+		id     int
+		ok     bool
+	}{
+		{"5", 5, true},
+		{"0123", 123, true},
+		{"2147483647", 2147483647, true},
+		{"", 0, false},
+		{"0", 0, false},
+		{"+5", 0, false},
+		{"-5", 0, false},
+		{" 5", 0, false},
+		{"5 ", 0, false},
+		{"5x", 0, false},
+		{"5\x00", 0, false},
+		{"2147483648", 0, false},
+	} {
+		id, ok := ParseBugID(test.digits)
+		if id != test.id || ok != test.ok {
+			t.Errorf("ParseBugID(%q) returned (%v, %v), want (%v, %v)", test.digits, id, ok, test.id, test.ok)
+		}
+	}
+}
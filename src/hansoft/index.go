@@ -0,0 +1,361 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"bytes"
+	"encoding/gob"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"sort"
+	"sync"
+	"time"
+)
+
+// The version of the task index file format.
+// Bump this whenever the format changes, to invalidate old indices.
+const taskIndexVersion = 2
+
+// taskIndex is an index of the backlog tasks that have a hyperlink with a
+// given prefix. The index holds the references of all the backlog tasks, so
+// that LinkedTasks() only needs to read the hyperlinks of the tasks that have
+// been created since the index was last updated, and of the tasks that had
+// their hyperlink changed. Hyperlinks changed while the index was not loaded
+// are only found for the linked tasks, which are checked by LoadIndex(), so
+// the index is rebuilt from all the hyperlinks once it is older than maxAge.
+type taskIndex struct {
+	mutex   sync.Mutex
+	loaded  bool                   // True once LoadIndex() has been called
+	prefix  string                 // Hyperlink prefix
+	entries map[taskRef]indexEntry // Linked tasks, keyed by main reference
+	refs    map[taskRef]struct{}   // References of all the backlog tasks
+	stale   map[uniqueID]struct{}  // Tasks whose hyperlink has changed
+	built   time.Time              // Time all the hyperlinks were last read
+	maxAge  time.Duration          // Maximum age of built. 0 means no limit.
+}
+
+// indexEntry is a single linked task held by a taskIndex
+type indexEntry struct {
+	Bug   int
+	Task  uniqueID
+	Proxy taskRef // Sprint proxy reference, or -1 if not known
+}
+
+// taskIndexFile is the gob encoded content of a task index file
+type taskIndexFile struct {
+	Version int
+	Project uniqueID
+	Prefix  string
+	Built   time.Time
+	Refs    []taskRef
+	Entries map[taskRef]indexEntry
+}
+
+func (b *backlog) LoadIndex(path, prefix string, maxAge time.Duration) error {
+	idx := b.index
+	idx.mutex.Lock()
+	idx.loaded = true
+	idx.prefix = prefix
+	idx.entries = map[taskRef]indexEntry{}
+	idx.refs = map[taskRef]struct{}{}
+	idx.stale = map[uniqueID]struct{}{}
+	idx.built = time.Time{}
+	idx.maxAge = maxAge
+	idx.mutex.Unlock()
+
+	file, err := readIndexFile(path)
+	if err != nil || file == nil {
+		return err
+	}
+	if file.Version != taskIndexVersion || file.Project != b.project.id || file.Prefix != prefix {
+		return nil
+	}
+
+	// The hyperlinks of the linked tasks may have changed since the index
+	// was written, so are all read again. The tasks that are no longer
+	// linked, or that could not be read, are re-read by LinkedTasks().
+	refs := make(map[taskRef]struct{}, len(file.Refs))
+	for _, ref := range file.Refs {
+		refs[ref] = struct{}{}
+	}
+	check := make([]taskRef, 0, len(file.Entries))
+	for ref := range file.Entries {
+		if _, ok := refs[ref]; ok {
+			check = append(check, ref)
+		}
+	}
+	linked, _, err := b.filterLinked(check, prefix)
+	if err != nil {
+		return fmt.Errorf("Failed to check the task index: %w", err)
+	}
+	entries := make(map[taskRef]indexEntry, len(linked))
+	for _, l := range linked {
+		e := file.Entries[l.ref]
+		entries[l.ref] = indexEntry{Bug: l.bug, Task: l.id, Proxy: e.Proxy}
+	}
+	for _, ref := range check {
+		if _, ok := entries[ref]; !ok {
+			delete(refs, ref)
+		}
+	}
+
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	idx.entries = entries
+	idx.refs = refs
+	idx.built = file.Built
+	return nil
+}
+
+// RebuildIndex makes the next LinkedTasks() call read all the hyperlinks, and
+// rebuild the index loaded by LoadIndex()
+func (b *backlog) RebuildIndex() {
+	idx := b.index
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	idx.built = time.Time{}
+}
+
+// readIndexFile reads the task index file at path. A missing file returns
+// nil, and no error.
+func readIndexFile(path string) (*taskIndexFile, error) {
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return nil, nil
+		}
+		return nil, fmt.Errorf("Failed to load '%v': %w", path, err)
+	}
+	file := &taskIndexFile{}
+	if err := gob.NewDecoder(bytes.NewReader(body)).Decode(file); err != nil {
+		return nil, fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	return file, nil
+}
+
+func (b *backlog) SaveIndex(path string) error {
+	s := b.project.session
+	idx := b.index
+	idx.mutex.Lock()
+	if !idx.loaded {
+		idx.mutex.Unlock()
+		return nil
+	}
+	file := taskIndexFile{
+		Version: taskIndexVersion,
+		Project: b.project.id,
+		Prefix:  idx.prefix,
+		Built:   idx.built,
+		Entries: make(map[taskRef]indexEntry, len(idx.entries)),
+	}
+	// Tasks with a stale hyperlink are left out, so they are read on the next
+	// load
+	refs := make(map[taskRef]struct{}, len(idx.refs))
+	for ref := range idx.refs {
+		refs[ref] = struct{}{}
+	}
+	unresolved := []uniqueID{}
+	for ref, e := range idx.entries {
+		if _, stale := idx.stale[e.Task]; stale {
+			delete(refs, ref)
+		} else {
+			file.Entries[ref] = e
+		}
+	}
+	for id := range idx.stale {
+		unresolved = append(unresolved, id)
+	}
+	idx.mutex.Unlock()
+
+	for _, id := range unresolved {
+		if ref, err := s.sdk.TaskGetMainReference(s.handle, id); err == nil {
+			delete(refs, ref)
+		}
+	}
+	file.Refs = make([]taskRef, 0, len(refs))
+	for ref := range refs {
+		file.Refs = append(file.Refs, ref)
+	}
+	sort.Slice(file.Refs, func(a, b int) bool { return file.Refs[a] < file.Refs[b] })
+
+	buf := bytes.Buffer{}
+	if err := gob.NewEncoder(&buf).Encode(&file); err != nil {
+		return fmt.Errorf("Failed to encode task index: %w", err)
+	}
+	tmp := path + ".tmp"
+	if err := ioutil.WriteFile(tmp, buf.Bytes(), 0666); err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", tmp, err)
+	}
+	if err := os.Rename(tmp, path); err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", path, err)
+	}
+	return nil
+}
+
+// onChange keeps the index up to date with the change. Called by the
+// SessionProcess() goroutine. Tasks created since the last LinkedTasks() are
+// found by LinkedTasks() comparing the backlog's references with the index.
+func (idx *taskIndex) onChange(c change) {
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	if !idx.loaded {
+		return
+	}
+	switch c.kind {
+	case changeTaskField:
+		if changeField(c.field) == changeFieldHyperlink {
+			idx.stale[uniqueID(c.id)] = struct{}{}
+		}
+	case changeTaskDelete:
+		for ref, e := range idx.entries {
+			if e.Task == uniqueID(c.id) {
+				delete(idx.entries, ref)
+				delete(idx.refs, ref)
+			}
+		}
+		delete(idx.stale, uniqueID(c.id))
+	}
+}
+
+// proxy returns the sprint proxy reference of the linked task, or -1 if not
+// known
+func (idx *taskIndex) proxy(ref taskRef) taskRef {
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	if e, ok := idx.entries[ref]; ok {
+		return e.Proxy
+	}
+	return -1
+}
+
+// setProxy records the sprint proxy reference of the linked task
+func (idx *taskIndex) setProxy(ref, proxy taskRef) {
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	if e, ok := idx.entries[ref]; ok {
+		e.Proxy = proxy
+		idx.entries[ref] = e
+	}
+}
+
+// isLoaded returns true if LoadIndex() has been called for the prefix
+func (idx *taskIndex) isLoaded(prefix string) bool {
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	return idx.loaded && idx.prefix == prefix
+}
+
+// enabled returns true if LoadIndex() has been called
+func (idx *taskIndex) enabled() bool {
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	return idx.loaded
+}
+
+// linkedTasksIndexed implements LinkedTasks() using the index. Only the
+// hyperlinks of tasks that are new to the index, or have a stale hyperlink,
+// are read.
+func (b *backlog) linkedTasksIndexed() ([]LinkedTask, LinkedCounts, error) {
+	s := b.project.session
+	idx := b.index
+	refs, err := s.sdk.TaskRefEnum(s.handle, b.id)
+	if err != nil {
+		return nil, LinkedCounts{}, err
+	}
+
+	// Gather the references to read without holding the lock over SDK calls
+	idx.mutex.Lock()
+	prefix := idx.prefix
+	rebuild := idx.built.IsZero() || (idx.maxAge > 0 && time.Since(idx.built) > idx.maxAge)
+	started := time.Now()
+	current := make(map[taskRef]struct{}, len(refs))
+	read := []taskRef{}
+	reading := map[taskRef]struct{}{}
+	for _, ref := range refs {
+		current[ref] = struct{}{}
+		if _, known := idx.refs[ref]; !known || rebuild {
+			read = append(read, ref)
+			reading[ref] = struct{}{}
+		}
+	}
+	stale := make([]uniqueID, 0, len(idx.stale))
+	for id := range idx.stale {
+		stale = append(stale, id)
+	}
+	idx.stale = map[uniqueID]struct{}{}
+	entryRefs := make(map[uniqueID]taskRef, len(idx.entries))
+	for ref, e := range idx.entries {
+		entryRefs[e.Task] = ref
+	}
+	idx.mutex.Unlock()
+
+	for _, id := range stale {
+		ref, ok := entryRefs[id]
+		if !ok {
+			if ref, err = s.sdk.TaskGetMainReference(s.handle, id); err != nil {
+				continue // Deleted
+			}
+		}
+		_, inBacklog := current[ref]
+		if _, ok := reading[ref]; inBacklog && !ok {
+			read = append(read, ref)
+			reading[ref] = struct{}{}
+		}
+	}
+
+	linked, counts, err := b.filterLinked(read, prefix)
+	if err != nil {
+		idx.mutex.Lock()
+		for _, id := range stale {
+			idx.stale[id] = struct{}{}
+		}
+		idx.mutex.Unlock()
+		return nil, LinkedCounts{}, err
+	}
+
+	idx.mutex.Lock()
+	defer idx.mutex.Unlock()
+	for ref := range idx.entries {
+		if _, ok := current[ref]; !ok {
+			delete(idx.entries, ref) // Deleted
+		}
+	}
+	proxies := map[taskRef]taskRef{}
+	for _, ref := range read {
+		if e, ok := idx.entries[ref]; ok {
+			proxies[ref] = e.Proxy
+			delete(idx.entries, ref) // Re-read
+		}
+	}
+	for _, l := range linked {
+		proxy, ok := proxies[l.ref]
+		if !ok {
+			proxy = -1
+		}
+		idx.entries[l.ref] = indexEntry{Bug: l.bug, Task: l.id, Proxy: proxy}
+	}
+	idx.refs = current
+	if rebuild {
+		idx.built = started
+	}
+
+	out := make([]LinkedTask, 0, len(idx.entries))
+	for ref, e := range idx.entries {
+		out = append(out, LinkedTask{e.Bug, b.project.task(e.Task, ref)})
+	}
+	sort.Slice(out, func(i, j int) bool { return out[i].ID < out[j].ID })
+	return out, counts, nil
+}
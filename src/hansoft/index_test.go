@@ -0,0 +1,143 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"bytes"
+	"encoding/gob"
+	"io/ioutil"
+	"path/filepath"
+	"reflect"
+	"testing"
+	"time"
+)
+
+// newTestIndex returns a loaded taskIndex holding the linked tasks of bugs 1
+// and 2, with references 10 and 20, and the unlinked task with reference 30
+func newTestIndex() *taskIndex {
+	return &taskIndex{
+		loaded: true,
+		prefix: "crbug.com/test/",
+		entries: map[taskRef]indexEntry{
+			10: {Bug: 1, Task: 100, Proxy: -1},
+			20: {Bug: 2, Task: 200, Proxy: 21},
+		},
+		refs:  map[taskRef]struct{}{10: {}, 20: {}, 30: {}},
+		stale: map[uniqueID]struct{}{},
+	}
+}
+
+func TestTaskIndexHyperlinkChange(t *testing.T) {
+	idx := newTestIndex()
+	idx.onChange(change{kind: changeTaskField, id: 100, field: int(changeFieldDescription)})
+	if len(idx.stale) != 0 {
+		t.Errorf("Description change marked %v stale", idx.stale)
+	}
+	idx.onChange(change{kind: changeTaskField, id: 100, field: int(changeFieldHyperlink)})
+	if _, ok := idx.stale[100]; !ok || len(idx.stale) != 1 {
+		t.Errorf("Hyperlink change marked %v stale, want task 100", idx.stale)
+	}
+}
+
+func TestTaskIndexDelete(t *testing.T) {
+	idx := newTestIndex()
+	idx.stale[200] = struct{}{}
+	idx.onChange(change{kind: changeTaskDelete, id: 200})
+	if _, ok := idx.entries[20]; ok {
+		t.Errorf("Deleted task is still an entry")
+	}
+	if _, ok := idx.refs[20]; ok {
+		t.Errorf("Deleted task is still a reference")
+	}
+	if _, ok := idx.stale[200]; ok {
+		t.Errorf("Deleted task is still stale")
+	}
+	if _, ok := idx.entries[10]; !ok {
+		t.Errorf("Deleting task 200 removed task 100")
+	}
+}
+
+func TestTaskIndexIgnoresChangesUntilLoaded(t *testing.T) {
+	idx := newTestIndex()
+	idx.loaded = false
+	idx.onChange(change{kind: changeTaskField, id: 100, field: int(changeFieldHyperlink)})
+	idx.onChange(change{kind: changeTaskDelete, id: 200})
+	if len(idx.stale) != 0 || len(idx.entries) != 2 {
+		t.Errorf("Unloaded index was changed: stale %v, entries %v", idx.stale, idx.entries)
+	}
+	if idx.enabled() || idx.isLoaded("crbug.com/test/") {
+		t.Errorf("Unloaded index is enabled")
+	}
+}
+
+func TestTaskIndexProxy(t *testing.T) {
+	idx := newTestIndex()
+	if got := idx.proxy(20); got != 21 {
+		t.Errorf("proxy(20) returned %v, want 21", got)
+	}
+	if got := idx.proxy(30); got != -1 {
+		t.Errorf("proxy() of an unlinked task returned %v, want -1", got)
+	}
+	idx.setProxy(10, 11)
+	idx.setProxy(30, 31)
+	if got := idx.proxy(10); got != 11 {
+		t.Errorf("proxy(10) returned %v after setProxy(10, 11)", got)
+	}
+	if _, ok := idx.entries[30]; ok {
+		t.Errorf("setProxy() of an unlinked task added an entry")
+	}
+	if !idx.isLoaded("crbug.com/test/") || idx.isLoaded("crbug.com/other/") {
+		t.Errorf("isLoaded() does not match the index prefix")
+	}
+}
+
+func TestReadIndexFile(t *testing.T) {
+	dir := t.TempDir()
+	if file, err := readIndexFile(filepath.Join(dir, "missing")); file != nil || err != nil {
+		t.Errorf("readIndexFile() of a missing file returned %v, %v", file, err)
+	}
+
+	garbage := filepath.Join(dir, "garbage")
+	if err := ioutil.WriteFile(garbage, []byte("not an index"), 0666); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := readIndexFile(garbage); err == nil {
+		t.Errorf("readIndexFile() of a corrupt file returned no error")
+	}
+
+	want := &taskIndexFile{
+		Version: taskIndexVersion,
+		Project: 7,
+		Prefix:  "crbug.com/test/",
+		Built:   time.Unix(1600000000, 0).UTC(),
+		Refs:    []taskRef{10, 20, 30},
+		Entries: newTestIndex().entries,
+	}
+	buf := bytes.Buffer{}
+	if err := gob.NewEncoder(&buf).Encode(want); err != nil {
+		t.Fatal(err)
+	}
+	path := filepath.Join(dir, "index")
+	if err := ioutil.WriteFile(path, buf.Bytes(), 0666); err != nil {
+		t.Fatal(err)
+	}
+	got, err := readIndexFile(path)
+	if err != nil {
+		t.Fatalf("readIndexFile() returned %v", err)
+	}
+	if !reflect.DeepEqual(got, want) {
+		t.Errorf("readIndexFile() returned %+v, want %+v", got, want)
+	}
+}
@@ -0,0 +1,274 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"bytes"
+	"encoding/gob"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"sort"
+	"time"
+)
+
+// The version of the metadata snapshot file format.
+// Bump this whenever the format changes, to invalidate old snapshots.
+const metadataSnapshotVersion = 1
+
+// metadataSnapshot is the gob encoded content of a metadata snapshot file.
+type metadataSnapshot struct {
+	Version    int
+	Project    uniqueID
+	Time       time.Time // Time the metadata was read from the server
+	Stamp      metadataStamp
+	Resources  []snapshotResource
+	Milestones []snapshotTask
+	Sprints    []snapshotTask
+	Workflows  []snapshotWorkflow
+}
+
+// metadataStamp holds the sorted IDs returned by the SDK enumeration calls.
+// A snapshot is only used if its stamp matches the server's. The stamp does
+// not cover names, see LoadMetadata(). The enumerations
+// are a handful of SDK calls, where reading the metadata takes a few calls
+// per resource, milestone, sprint and workflow status.
+type metadataStamp struct {
+	Resources  []uniqueID
+	Milestones []taskRef
+	Sprints    []uniqueID
+	Workflows  []int
+}
+
+type snapshotResource struct {
+	ID    uniqueID
+	Name  string
+	Email string
+}
+
+type snapshotTask struct {
+	ID   uniqueID
+	Ref  taskRef
+	Name string
+}
+
+type snapshotWorkflow struct {
+	ID       int
+	Statuses map[int]string
+}
+
+// LoadMetadata loads the project's resources, milestones, sprints and workflow
+// statuses from the snapshot file at path, written by SaveMetadata().
+// The snapshot is only used if it was taken less than maxAge ago, and no
+// resources, milestones, sprints or workflows have since been added or
+// removed. Renamed sprints, milestones and workflow statuses, and changed
+// resource names and emails, are not detected, as reading them costs as much
+// as loading the metadata, so the snapshot is stale until it reaches maxAge.
+// LoadMetadata returns false if the snapshot was not used.
+func (p *project) LoadMetadata(path string, maxAge time.Duration) (bool, error) {
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return false, nil
+		}
+		return false, err
+	}
+	snapshot := metadataSnapshot{}
+	if err := gob.NewDecoder(bytes.NewReader(body)).Decode(&snapshot); err != nil {
+		return false, fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	if snapshot.Version != metadataSnapshotVersion ||
+		snapshot.Project != p.id ||
+		time.Since(snapshot.Time) > maxAge {
+		return false, nil
+	}
+	stamp, err := p.metadataStamp()
+	if err != nil {
+		return false, err
+	}
+	if !stamp.equal(snapshot.Stamp) {
+		return false, nil
+	}
+
+	resources := make(map[uniqueID]Resource, len(snapshot.Resources))
+	for _, r := range snapshot.Resources {
+		resources[r.ID] = resource{r.ID, r.Name, r.Email}
+	}
+	milestones := make(map[uniqueID]Milestone, len(snapshot.Milestones))
+	for _, m := range snapshot.Milestones {
+		milestones[m.ID] = &milestone{p, m.Ref, m.ID, m.Name}
+	}
+	sprints := make(map[uniqueID]Sprint, len(snapshot.Sprints))
+	for _, s := range snapshot.Sprints {
+		sprints[s.ID] = &sprint{p, s.Ref, s.ID, s.Name}
+	}
+	statuses := make(map[int]*workflowStatuses, len(snapshot.Workflows))
+	for _, w := range snapshot.Workflows {
+		ws := &workflowStatuses{toID: map[Status]int{}, fromID: map[int]Status{}}
+		for id, name := range w.Statuses {
+			ws.toID[Status(name)] = id
+			ws.fromID[id] = Status(name)
+		}
+		statuses[w.ID] = ws
+	}
+
+	p.metadataMutex.Lock()
+	p.resources = resources
+	p.milestones = milestones
+	p.sprints = sprints
+	p.snapshotTime = snapshot.Time
+	p.metadataMutex.Unlock()
+
+	p.statusesMutex.Lock()
+	p.workflows = stamp.Workflows
+	p.statuses = statuses
+	p.statusesGen++
+	p.statusesMutex.Unlock()
+
+	return true, nil
+}
+
+// SaveMetadata writes the project's resources, milestones, sprints and
+// workflow statuses to a snapshot file at path, loading them first if needed.
+func (p *project) SaveMetadata(path string) error {
+	resources, err := p.getResources()
+	if err != nil {
+		return err
+	}
+	milestones, err := p.getMilestones()
+	if err != nil {
+		return err
+	}
+	sprints, err := p.getSprints()
+	if err != nil {
+		return err
+	}
+	workflows, err := p.getWorkflows()
+	if err != nil {
+		return err
+	}
+
+	p.metadataMutex.Lock()
+	taken := p.snapshotTime
+	p.metadataMutex.Unlock()
+	if taken.IsZero() {
+		taken = time.Now()
+	}
+
+	snapshot := metadataSnapshot{
+		Version: metadataSnapshotVersion,
+		Project: p.id,
+		Time:    taken,
+	}
+	for id, r := range resources {
+		r := r.(resource)
+		snapshot.Resources = append(snapshot.Resources, snapshotResource{id, r.name, r.email})
+		snapshot.Stamp.Resources = append(snapshot.Stamp.Resources, id)
+	}
+	for id, m := range milestones {
+		m := m.(*milestone)
+		snapshot.Milestones = append(snapshot.Milestones, snapshotTask{id, m.ref, m.name})
+		snapshot.Stamp.Milestones = append(snapshot.Stamp.Milestones, m.ref)
+	}
+	for id, s := range sprints {
+		s := s.(*sprint)
+		snapshot.Sprints = append(snapshot.Sprints, snapshotTask{id, s.ref, s.name})
+		snapshot.Stamp.Sprints = append(snapshot.Stamp.Sprints, id)
+	}
+	for _, id := range workflows {
+		statuses, err := p.getWorkflowStatuses(id)
+		if err != nil {
+			return err
+		}
+		w := snapshotWorkflow{ID: id, Statuses: make(map[int]string, len(statuses.fromID))}
+		for status, name := range statuses.fromID {
+			w.Statuses[status] = string(name)
+		}
+		snapshot.Workflows = append(snapshot.Workflows, w)
+		snapshot.Stamp.Workflows = append(snapshot.Stamp.Workflows, id)
+	}
+	snapshot.Stamp.sort()
+
+	buf := bytes.Buffer{}
+	if err := gob.NewEncoder(&buf).Encode(&snapshot); err != nil {
+		return err
+	}
+	tmp := path + ".tmp"
+	if err := ioutil.WriteFile(tmp, buf.Bytes(), 0666); err != nil {
+		return err
+	}
+	return os.Rename(tmp, path)
+}
+
+// metadataStamp returns the stamp of the metadata currently on the server
+func (p *project) metadataStamp() (metadataStamp, error) {
+	s := p.session
+	resources, err := s.sdk.ProjectResourceEnum(s.handle, p.id)
+	if err != nil {
+		return metadataStamp{}, err
+	}
+	milestones, err := s.sdk.ProjectGetMilestones(s.handle, p.id)
+	if err != nil {
+		return metadataStamp{}, err
+	}
+	sprints, err := s.sdk.ProjectGetSprints(s.handle, p.id)
+	if err != nil {
+		return metadataStamp{}, err
+	}
+	workflows, err := s.sdk.ProjectWorkflowEnum(s.handle, p.id)
+	if err != nil {
+		return metadataStamp{}, err
+	}
+	stamp := metadataStamp{resources, milestones, sprints, workflows}
+	stamp.sort()
+	return stamp, nil
+}
+
+func (s metadataStamp) equal(o metadataStamp) bool {
+	if len(s.Resources) != len(o.Resources) ||
+		len(s.Milestones) != len(o.Milestones) ||
+		len(s.Sprints) != len(o.Sprints) ||
+		len(s.Workflows) != len(o.Workflows) {
+		return false
+	}
+	for i := range s.Resources {
+		if s.Resources[i] != o.Resources[i] {
+			return false
+		}
+	}
+	for i := range s.Milestones {
+		if s.Milestones[i] != o.Milestones[i] {
+			return false
+		}
+	}
+	for i := range s.Sprints {
+		if s.Sprints[i] != o.Sprints[i] {
+			return false
+		}
+	}
+	for i := range s.Workflows {
+		if s.Workflows[i] != o.Workflows[i] {
+			return false
+		}
+	}
+	return true
+}
+
+func (s *metadataStamp) sort() {
+	sort.Slice(s.Resources, func(a, b int) bool { return s.Resources[a] < s.Resources[b] })
+	sort.Slice(s.Milestones, func(a, b int) bool { return s.Milestones[a] < s.Milestones[b] })
+	sort.Slice(s.Sprints, func(a, b int) bool { return s.Sprints[a] < s.Sprints[b] })
+	sort.Ints(s.Workflows)
+}
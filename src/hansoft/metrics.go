@@ -0,0 +1,251 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"math/bits"
+	"sync/atomic"
+	"time"
+)
+
+// sdkCall identifies an instrumented SDK function
+type sdkCall int
+
+const (
+	callInit sdkCall = iota
+	callSessionOpen
+	callSessionRegisterChangeCallbacks
+	callSessionStop
+	callSessionClose
+	callSessionProcess
+	callProjectEnum
+	callProjectUtilGetBacklog
+	callProjectGetProperties
+	callProjectGetMilestones
+	callProjectGetSprints
+	callProjectCustomColumnsGet
+	callProjectWorkflowEnum
+	callProjectWorkflowGetSettings
+	callProjectResourceEnum
+	callTaskEnum
+	callTaskRefEnum
+	callTaskRefEnumLinked
+	callTaskRefFilterLinked
+	callTaskGetDescription
+	callTaskSetDescription
+	callTaskGetWorkflow
+	callTaskGetWorkflowStatus
+	callTaskSetWorkflowStatus
+	callTaskSetEstimatedIdealDays
+	callTaskGetEstimatedIdealDays
+	callTaskGetResourceAllocation
+	callTaskSetResourceAllocation
+	callTaskGetHyperlink
+	callTaskSetHyperlink
+	callTaskGetCustomColumnData
+	callTaskSetCustomColumnData
+	callTaskCustomColumns
+	callTaskCustomColumnsFree
+	callUtilGetNoMilestoneID
+	callTaskGetLinkedToMilestones
+	callTaskSetLinkedToMilestones
+	callTaskGetLinkedToSprint
+	callTaskSetLinkedToSprint
+	callTaskRefUtilEnumChildren
+	callTaskRefDelete
+	callTaskGetBacklogPriority
+	callTaskSetBacklogPriority
+	callTaskGetMainReference
+	callTaskGetProxy
+	callTaskCreateUnified
+	callTaskCreatePlannedBatch
+	callTaskRefGetTask
+	callTaskRefGetContainer
+	callTaskSnapshot
+	callTaskSnapshotFree
+	callTaskCompare
+	callResourceGetProperties
+	callLocalizationTranslateString
+	callObjectFree
+	sdkCallCount
+)
+
+var sdkCallNames = [sdkCallCount]string{
+	callInit:                           "Init",
+	callSessionOpen:                    "SessionOpen",
+	callSessionRegisterChangeCallbacks: "SessionRegisterChangeCallbacks",
+	callSessionStop:                    "SessionStop",
+	callSessionClose:                   "SessionClose",
+	callSessionProcess:                 "SessionProcess",
+	callProjectEnum:                    "ProjectEnum",
+	callProjectUtilGetBacklog:          "ProjectUtilGetBacklog",
+	callProjectGetProperties:           "ProjectGetProperties",
+	callProjectGetMilestones:           "ProjectGetMilestones",
+	callProjectGetSprints:              "ProjectGetSprints",
+	callProjectCustomColumnsGet:        "ProjectCustomColumnsGet",
+	callProjectWorkflowEnum:            "ProjectWorkflowEnum",
+	callProjectWorkflowGetSettings:     "ProjectWorkflowGetSettings",
+	callProjectResourceEnum:            "ProjectResourceEnum",
+	callTaskEnum:                       "TaskEnum",
+	callTaskRefEnum:                    "TaskRefEnum",
+	callTaskRefEnumLinked:              "TaskRefEnumLinked",
+	callTaskRefFilterLinked:            "TaskRefFilterLinked",
+	callTaskGetDescription:             "TaskGetDescription",
+	callTaskSetDescription:             "TaskSetDescription",
+	callTaskGetWorkflow:                "TaskGetWorkflow",
+	callTaskGetWorkflowStatus:          "TaskGetWorkflowStatus",
+	callTaskSetWorkflowStatus:          "TaskSetWorkflowStatus",
+	callTaskSetEstimatedIdealDays:      "TaskSetEstimatedIdealDays",
+	callTaskGetEstimatedIdealDays:      "TaskGetEstimatedIdealDays",
+	callTaskGetResourceAllocation:      "TaskGetResourceAllocation",
+	callTaskSetResourceAllocation:      "TaskSetResourceAllocation",
+	callTaskGetHyperlink:               "TaskGetHyperlink",
+	callTaskSetHyperlink:               "TaskSetHyperlink",
+	callTaskGetCustomColumnData:        "TaskGetCustomColumnData",
+	callTaskSetCustomColumnData:        "TaskSetCustomColumnData",
+	callTaskCustomColumns:              "TaskCustomColumns",
+	callTaskCustomColumnsFree:          "TaskCustomColumnsFree",
+	callUtilGetNoMilestoneID:           "UtilGetNoMilestoneID",
+	callTaskGetLinkedToMilestones:      "TaskGetLinkedToMilestones",
+	callTaskSetLinkedToMilestones:      "TaskSetLinkedToMilestones",
+	callTaskGetLinkedToSprint:          "TaskGetLinkedToSprint",
+	callTaskSetLinkedToSprint:          "TaskSetLinkedToSprint",
+	callTaskRefUtilEnumChildren:        "TaskRefUtilEnumChildren",
+	callTaskRefDelete:                  "TaskRefDelete",
+	callTaskGetBacklogPriority:         "TaskGetBacklogPriority",
+	callTaskSetBacklogPriority:         "TaskSetBacklogPriority",
+	callTaskGetMainReference:           "TaskGetMainReference",
+	callTaskGetProxy:                   "TaskGetProxy",
+	callTaskCreateUnified:              "TaskCreateUnified",
+	callTaskCreatePlannedBatch:         "TaskCreatePlannedBatch",
+	callTaskRefGetTask:                 "TaskRefGetTask",
+	callTaskRefGetContainer:            "TaskRefGetContainer",
+	callTaskSnapshot:                   "TaskSnapshot",
+	callTaskSnapshotFree:               "TaskSnapshotFree",
+	callTaskCompare:                    "TaskCompare",
+	callResourceGetProperties:          "ResourceGetProperties",
+	callLocalizationTranslateString:    "LocalizationTranslateString",
+	callObjectFree:                     "ObjectFree",
+}
+
+// LatencyBuckets is the number of buckets of CallStats.Histogram
+const LatencyBuckets = 24
+
+// LatencyBound returns the exclusive upper bound of the latencies counted by
+// CallStats.Histogram[bucket]. Bucket 0 counts calls that took less than a
+// microsecond, and each following bucket doubles the bound. The last bucket
+// also counts all the calls slower than its bound.
+func LatencyBound(bucket int) time.Duration {
+	return time.Microsecond << uint(bucket)
+}
+
+// CallStats holds the statistics of the calls made to a single SDK function,
+// as returned by Hansoft.CallStats()
+type CallStats struct {
+	Function string
+	// Number of calls made, and the number that failed. A batched call fails
+	// once for each task that could not be read.
+	Calls, Errors int64
+	// Number of tasks or objects handled by the calls. Equal to Calls for the
+	// functions that handle a single task or object.
+	Items int64
+	// Total time spent in the calls
+	TotalLatency time.Duration
+	// Histogram[i] is the number of calls that took less than
+	// LatencyBound(i), and at least LatencyBound(i-1)
+	Histogram [LatencyBuckets]int64
+}
+
+// MeanLatency returns the average latency of the calls
+func (s CallStats) MeanLatency() time.Duration {
+	if s.Calls == 0 {
+		return 0
+	}
+	return s.TotalLatency / time.Duration(s.Calls)
+}
+
+// Quantile returns the upper bound of the histogram bucket holding the q'th
+// quantile of the call latencies, where q is between 0 and 1.
+func (s CallStats) Quantile(q float64) time.Duration {
+	total := int64(0)
+	for _, n := range s.Histogram {
+		total += n
+	}
+	if total == 0 {
+		return 0
+	}
+	rank, seen := int64(q*float64(total)), int64(0)
+	for i, n := range s.Histogram {
+		seen += n
+		if seen > rank {
+			return LatencyBound(i)
+		}
+	}
+	return LatencyBound(LatencyBuckets - 1)
+}
+
+// callCounters are the atomic counters of a single SDK function
+type callCounters struct {
+	calls     int64
+	errors    int64
+	items     int64
+	nanos     int64
+	histogram [LatencyBuckets]int64
+}
+
+// callMetrics counts the calls made to each SDK function. Recording a call
+// costs two clock reads and a handful of atomic adds, which is small
+// next to the cost of a cgo call.
+type callMetrics struct {
+	counters [sdkCallCount]callCounters
+}
+
+// record accounts for a call to c that started at start, handled items tasks
+// or objects, and had failures errors
+func (m *callMetrics) record(c sdkCall, start time.Time, items, failures int) {
+	d := time.Since(start)
+	counters := &m.counters[c]
+	atomic.AddInt64(&counters.calls, 1)
+	atomic.AddInt64(&counters.items, int64(items))
+	atomic.AddInt64(&counters.nanos, int64(d))
+	if failures > 0 {
+		atomic.AddInt64(&counters.errors, int64(failures))
+	}
+	bucket := bits.Len64(uint64(d / time.Microsecond))
+	if bucket >= LatencyBuckets {
+		bucket = LatencyBuckets - 1
+	}
+	atomic.AddInt64(&counters.histogram[bucket], 1)
+}
+
+// stats returns the statistics of each function called at least once
+func (m *callMetrics) stats() []CallStats {
+	out := []CallStats{}
+	for c := range m.counters {
+		counters := &m.counters[c]
+		s := CallStats{Function: sdkCallNames[c], Calls: atomic.LoadInt64(&counters.calls)}
+		if s.Calls == 0 {
+			continue
+		}
+		s.Errors = atomic.LoadInt64(&counters.errors)
+		s.Items = atomic.LoadInt64(&counters.items)
+		s.TotalLatency = time.Duration(atomic.LoadInt64(&counters.nanos))
+		for i := range s.Histogram {
+			s.Histogram[i] = atomic.LoadInt64(&counters.histogram[i])
+		}
+		out = append(out, s)
+	}
+	return out
+}
@@ -0,0 +1,120 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"fmt"
+	"sync"
+	"unsafe"
+)
+
+// reader is a connection used for batched reads. The session's own
+// connection is always the first reader, followed by any additional
+// connections opened by Hansoft.ConnectPool().
+type reader struct {
+	handle    unsafe.Pointer
+	scratch   *arena
+	callbacks *readerCallbacks // nil for the session's own connection
+}
+
+// readerCallbacks is the callback handler of an additional connection. These
+// connections do not register change callbacks, as the session's own
+// connection already reports every change.
+type readerCallbacks struct{ processor *sessionProcessor }
+
+func (c *readerCallbacks) onProcessCallback()      { c.processor.wake() }
+func (c *readerCallbacks) onChangeCallback(change) {}
+
+// openReaders opens n additional connections to the database
+func (s *session) openReaders(address string, port int, database, user, password string, n int) error {
+	for i := 0; i < n; i++ {
+		callbacks := &readerCallbacks{s.processor}
+		handle, err := s.sdk.SessionOpen(address, port, database, user, password, true, false, callbacks)
+		if err != nil {
+			return fmt.Errorf("Failed to open hansoft session %v of pool: %w", i+2, err)
+		}
+		s.readers = append(s.readers, &reader{handle, newArena(), callbacks})
+	}
+	return nil
+}
+
+// closeReaders closes the connections opened by openReaders()
+func (s *session) closeReaders() {
+	for _, r := range s.readers {
+		if r.callbacks == nil {
+			continue
+		}
+		s.sdk.SessionStop(r.handle)
+		s.sdk.SessionClose(r.handle, r.callbacks)
+		r.scratch.free()
+	}
+	s.readers = s.readers[:1]
+}
+
+// processAll calls SessionProcess() for each of the session's connections.
+// Used by the session's processor, which is shared by all the connections.
+func (s *session) processAll() error {
+	var firstErr error
+	for _, r := range s.readers {
+		if err := s.sdk.SessionProcess(r.handle); err != nil && firstErr == nil {
+			firstErr = err
+		}
+	}
+	return firstErr
+}
+
+// parallel calls f for each of the n items of work, spreading the calls
+// across the session's connections, using one worker per connection. The
+// first error returned by f is returned.
+func (s *session) parallel(n int, f func(r *reader, i int) error) error {
+	workers := len(s.readers)
+	if workers > n {
+		workers = n
+	}
+	if workers <= 1 {
+		for i := 0; i < n; i++ {
+			if err := f(s.readers[0], i); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
+
+	work := make(chan int, n)
+	for i := 0; i < n; i++ {
+		work <- i
+	}
+	close(work)
+
+	errs := make([]error, n)
+	wg := sync.WaitGroup{}
+	wg.Add(workers)
+	for w := 0; w < workers; w++ {
+		go func(r *reader) {
+			defer wg.Done()
+			for i := range work {
+				errs[i] = f(r, i)
+			}
+		}(s.readers[w])
+	}
+	wg.Wait()
+
+	for _, err := range errs {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -0,0 +1,130 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// ProcessStats holds the statistics of a session's SessionProcess() loop, as
+// returned by Session.ProcessStats()
+type ProcessStats struct {
+	// Number of times the loop was woken by the SDK
+	Wakeups int64
+	// Number of calls made to SessionProcess()
+	Calls int64
+	// Total and maximum time between the SDK requesting a SessionProcess()
+	// call and the loop making it
+	TotalLatency time.Duration
+	MaxLatency   time.Duration
+}
+
+// MeanLatency returns the average wake-up to SessionProcess() latency
+func (s ProcessStats) MeanLatency() time.Duration {
+	if s.Wakeups == 0 {
+		return 0
+	}
+	return s.TotalLatency / time.Duration(s.Wakeups)
+}
+
+// sessionProcessor calls SessionProcess() for a session whenever the SDK asks
+// for it. The SDK makes the request from its own thread, so wake() must never
+// block: requests are coalesced into a single pending flag, and the loop
+// drains all the queued work each time it wakes.
+type sessionProcessor struct {
+	pending int32         // 1 if a wake-up has not been consumed. Atomic.
+	wokenAt int64         // UnixNano of the unconsumed wake-up. Atomic.
+	signal  chan struct{} // Signalled when pending is set
+	stop    chan struct{}
+	done    chan struct{}
+
+	statsMutex sync.Mutex
+	stats      ProcessStats
+}
+
+func newSessionProcessor() *sessionProcessor {
+	return &sessionProcessor{
+		signal: make(chan struct{}, 1),
+		stop:   make(chan struct{}),
+		done:   make(chan struct{}),
+	}
+}
+
+// wake requests a call to process. Safe to call from any thread.
+func (p *sessionProcessor) wake() {
+	if atomic.CompareAndSwapInt32(&p.pending, 0, 1) {
+		atomic.StoreInt64(&p.wokenAt, time.Now().UnixNano())
+		select {
+		case p.signal <- struct{}{}:
+		default: // Already signalled
+		}
+	}
+}
+
+// run calls process for each wake-up until shutdown() is called
+func (p *sessionProcessor) run(process func() error) {
+	defer close(p.done)
+	for {
+		select {
+		case <-p.stop:
+			return
+		case <-p.signal:
+		}
+
+		wokenAt := atomic.LoadInt64(&p.wokenAt)
+		latency := time.Duration(time.Now().UnixNano() - wokenAt)
+		calls := int64(0)
+		for {
+			// Clear the flag before processing, so that requests made while
+			// processing are not lost
+			atomic.StoreInt32(&p.pending, 0)
+			if err := process(); err != nil {
+				fmt.Println("SessionProcess() returned", err)
+			}
+			calls++
+			if atomic.LoadInt32(&p.pending) == 0 {
+				break
+			}
+			select {
+			case <-p.signal: // Consumed by this drain
+			default:
+			}
+		}
+
+		p.statsMutex.Lock()
+		p.stats.Wakeups++
+		p.stats.Calls += calls
+		p.stats.TotalLatency += latency
+		if latency > p.stats.MaxLatency {
+			p.stats.MaxLatency = latency
+		}
+		p.statsMutex.Unlock()
+	}
+}
+
+// shutdown stops the loop, and waits for it to finish
+func (p *sessionProcessor) shutdown() {
+	close(p.stop)
+	<-p.done
+}
+
+func (p *sessionProcessor) processStats() ProcessStats {
+	p.statsMutex.Lock()
+	defer p.statsMutex.Unlock()
+	return p.stats
+}
@@ -20,18 +20,94 @@ import "C"
 
 import (
 	"fmt"
+	"sync"
+	"time"
 	"unsafe"
 )
 
 type uniqueID int32
 type taskRef int32
 
-type sdk struct{ funcs C.HPMSdkFunctions }
+type sdk struct {
+	funcs   C.HPMSdkFunctions
+	metrics callMetrics
+}
+
+// call records a call to c that started at start and returned e, and returns
+// e as an error. Function calls are evaluated left to right, so
+// s.call(c, time.Now(), C.fn(...)) times the call to C.fn.
+func (s *sdk) call(c sdkCall, start time.Time, e C.HPMError) error {
+	return s.callBatch(c, 1, start, e)
+}
+
+// callBatch is like call, for a call that handles items tasks or objects
+func (s *sdk) callBatch(c sdkCall, items int, start time.Time, e C.HPMError) error {
+	err := toError(e)
+	failures := 0
+	if err != nil {
+		failures = 1
+	}
+	s.metrics.record(c, start, items, failures)
+	return err
+}
+
+// objectFree releases an object returned by the SDK
+func (s *sdk) objectFree(session unsafe.Pointer, object unsafe.Pointer) {
+	s.call(callObjectFree, time.Now(), C.object_free(&s.funcs, session, object, nil))
+}
+
+// arenaInitialSize is the initial size in bytes of a session's arena
+const arenaInitialSize = 64 << 10
+
+// arena is a per-session scratch allocator used to build the C structures and
+// strings passed to the SDK. See arena in sdk.h.
+// Each SDK call that uses the arena wraps the marshalling and the call with
+// begin() and end(), which resets the arena.
+type arena struct {
+	mutex sync.Mutex
+	a     *C.arena
+}
+
+func newArena() *arena {
+	return &arena{a: C.arena_new(arenaInitialSize)}
+}
+
+func (a *arena) free() {
+	C.arena_free(a.a)
+	a.a = nil
+}
+
+// begin locks the arena for building the arguments of a single SDK call
+func (a *arena) begin() { a.mutex.Lock() }
+
+// end releases everything allocated since begin() and unlocks the arena
+func (a *arena) end() {
+	C.arena_reset(a.a)
+	a.mutex.Unlock()
+}
+
+// alloc returns size bytes of zeroed memory that is valid until end()
+func (a *arena) alloc(size uintptr) unsafe.Pointer {
+	p := C.arena_alloc(a.a, C.size_t(size))
+	if p == nil {
+		panic("hansoft: out of memory")
+	}
+	return p
+}
+
+// str returns a NUL-terminated copy of str that is valid until end()
+func (a *arena) str(str string) *C.char {
+	p := C.arena_string(a.a, str)
+	if p == nil {
+		panic("hansoft: out of memory")
+	}
+	return p
+}
 
 func (s *sdk) Init(libraryDirectory string) error {
 	libDir := C.CString(libraryDirectory)
 	defer C.free(unsafe.Pointer(libDir))
-	if err := toError(C.HPMInit(&s.funcs, nil, libDir)); err != nil {
+	if err := s.call(callInit, time.Now(), C.HPMInit(&s.funcs, nil, libDir)); err != nil {
 		return err
 	}
 	return nil
@@ -41,8 +117,59 @@ func (s *sdk) Destroy() {
 	C.HPMDestroy(&s.funcs)
 }
 
-type processCallbackHandler interface {
+// parseBugID parses digits with parse_bug_id(), as find_linked_tasks() does.
+// Returns 0 if digits is not a bug ID.
+func parseBugID(digits string) int {
+	str := C.CString(digits)
+	defer C.free(unsafe.Pointer(str))
+	return int(C.parse_bug_id(str))
+}
+
+type callbackHandler interface {
+	// onProcessCallback is called when SessionProcess() needs to be called.
+	// It is called on the SDK's own thread, and must not block.
 	onProcessCallback()
+	// onChangeCallback is called by SessionProcess() for each change made to
+	// the database.
+	onChangeCallback(change)
+}
+
+type changeKind int
+
+const (
+	changeTaskField  changeKind = C.CHANGE_TASK_FIELD
+	changeTaskCreate changeKind = C.CHANGE_TASK_CREATE
+	changeTaskDelete changeKind = C.CHANGE_TASK_DELETE
+	changeResource   changeKind = C.CHANGE_RESOURCE
+	changeWorkflow   changeKind = C.CHANGE_WORKFLOW
+	changeTaskColumn changeKind = C.CHANGE_TASK_COLUMN
+	changeColumns    changeKind = C.CHANGE_COLUMNS
+)
+
+// changeField is a task field, as reported by a changeTaskField change
+type changeField int
+
+const (
+	changeFieldDescription    changeField = C.EHPMTaskField_Description
+	changeFieldHyperlink      changeField = C.EHPMTaskField_Hyperlink
+	changeFieldWorkflowStatus changeField = C.EHPMTaskField_WorkflowStatus
+	changeFieldIdealDays      changeField = C.EHPMTaskField_EstimatedIdealDays
+	changeFieldResource       changeField = C.EHPMTaskField_ResourceAllocation
+	changeFieldMilestone      changeField = C.EHPMTaskField_LinkedToMilestone
+	changeFieldPriority       changeField = C.EHPMTaskField_BacklogPriority
+	// Not an EHPMTaskField. Identifies the custom column writes tracked by
+	// pendingWrites, which are reported by changeTaskColumn changes.
+	changeFieldCustomColumn changeField = -1
+)
+
+// change describes a single change callback. See the CHANGE_* enumerators in
+// sdk.h for the meaning of the fields for each kind.
+type change struct {
+	kind      changeKind
+	container uniqueID
+	id        int32
+	field     int
+	echo      bool // True if the change is a write made by this session
 }
 
 func (s *sdk) SessionOpen(
@@ -51,7 +178,9 @@ func (s *sdk) SessionOpen(
 	database,
 	user,
 	password string,
-	onProcessCallback processCallbackHandler) (unsafe.Pointer, error) {
+	blocking bool,
+	changeCallbacks bool,
+	callbacks callbackHandler) (unsafe.Pointer, error) {
 
 	addr := C.CString(address)
 	defer C.free(unsafe.Pointer(addr))
@@ -62,7 +191,7 @@ func (s *sdk) SessionOpen(
 	pw := C.CString(password)
 	defer C.free(unsafe.Pointer(pw))
 	e := C.HPMError(0)
-	callbackHandle := registerProcessCallbackHandler(onProcessCallback)
+	callbackHandle := registerCallbackHandler(callbacks)
 	callbackInfo := C.HPMNeedSessionProcessCallbackInfo{
 		m_pContext:  unsafe.Pointer(callbackHandle),
 		m_pCallback: C.HPMNeedSessionProcessCallback(C.onProcessCallback),
@@ -70,6 +199,7 @@ func (s *sdk) SessionOpen(
 	emptyString := C.CString("")
 	defer C.free(unsafe.Pointer(emptyString))
 
+	start := time.Now()
 	session := C.session_open(&s.funcs,
 		/* pError */ &e,
 		/* pAddress */ addr,
@@ -77,7 +207,7 @@ func (s *sdk) SessionOpen(
 		/* pDatabase */ db,
 		/* pResourceName */ usr,
 		/* pPassword */ pw,
-		/* bBlockOnOperations */ C.int(1),
+		/* bBlockOnOperations */ C.int(boolToInt(blocking)),
 		/* pNeedProcessCallback */ &callbackInfo,
 		/* SDKVersion */ C.EHPMSDK_Version,
 		/* SDKDebug */ C.EHPMSdkDebugMode_Off,
@@ -85,31 +215,40 @@ func (s *sdk) SessionOpen(
 		/* pWorkingDirectory */ emptyString,
 		/* pCertificateSettings */ nil,
 		/* pExtendedErrorMessage */ nil)
-	if err := toError(e); err != nil {
+	if err := s.call(callSessionOpen, start, e); err != nil {
+		unregisterCallbackHandler(callbacks)
 		return nil, err
 	}
+	if !changeCallbacks {
+		return session, nil
+	}
+	if err := s.call(callSessionRegisterChangeCallbacks, time.Now(), C.session_register_change_callbacks(&s.funcs, session, unsafe.Pointer(callbackHandle))); err != nil {
+		unregisterCallbackHandler(callbacks)
+		C.session_close(&s.funcs, session)
+		return nil, fmt.Errorf("Failed to register change callbacks: %w", err)
+	}
 	return session, nil
 }
 
 func (s *sdk) SessionStop(session unsafe.Pointer) error {
-	return toError(C.session_stop(&s.funcs, session))
+	return s.call(callSessionStop, time.Now(), C.session_stop(&s.funcs, session))
 }
 
-func (s *sdk) SessionClose(session unsafe.Pointer, onProcessCallback processCallbackHandler) error {
-	unregisterProcessCallbackHandler(onProcessCallback)
-	return toError(C.session_close(&s.funcs, session))
+func (s *sdk) SessionClose(session unsafe.Pointer, callbacks callbackHandler) error {
+	unregisterCallbackHandler(callbacks)
+	return s.call(callSessionClose, time.Now(), C.session_close(&s.funcs, session))
 }
 
 func (s *sdk) SessionProcess(session unsafe.Pointer) error {
-	return toError(C.session_process(&s.funcs, session))
+	return s.call(callSessionProcess, time.Now(), C.session_process(&s.funcs, session))
 }
 
 func (s *sdk) ProjectEnum(session unsafe.Pointer) ([]uniqueID, error) {
 	var e *C.HPMProjectEnum
-	if err := toError(C.project_enum(&s.funcs, session, &e)); err != nil {
+	if err := s.call(callProjectEnum, time.Now(), C.project_enum(&s.funcs, session, &e)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	out := make([]uniqueID, e.m_nProjects)
 	ptr := uintptr(unsafe.Pointer(e.m_pProjects))
@@ -121,7 +260,7 @@ func (s *sdk) ProjectEnum(session unsafe.Pointer) ([]uniqueID, error) {
 
 func (s *sdk) ProjectUtilGetBacklog(session unsafe.Pointer, project uniqueID) (uniqueID, error) {
 	var backlog C.HPMUniqueID
-	if err := toError(C.project_util_get_backlog(&s.funcs, session, C.HPMUniqueID(project), &backlog)); err != nil {
+	if err := s.call(callProjectUtilGetBacklog, time.Now(), C.project_util_get_backlog(&s.funcs, session, C.HPMUniqueID(project), &backlog)); err != nil {
 		return 0, err
 	}
 	return uniqueID(backlog), nil
@@ -148,10 +287,10 @@ type projectProperties struct {
 
 func (s *sdk) ProjectGetProperties(session unsafe.Pointer, project uniqueID) (projectProperties, error) {
 	var properties *C.HPMProjectProperties
-	if err := toError(C.project_get_properties(&s.funcs, session, C.HPMUniqueID(project), &properties)); err != nil {
+	if err := s.call(callProjectGetProperties, time.Now(), C.project_get_properties(&s.funcs, session, C.HPMUniqueID(project), &properties)); err != nil {
 		return projectProperties{}, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(properties), nil)
+	defer s.objectFree(session, unsafe.Pointer(properties))
 
 	return projectProperties{
 		name:              C.GoString(properties.m_pName),
@@ -167,10 +306,10 @@ func (s *sdk) ProjectGetProperties(session unsafe.Pointer, project uniqueID) (pr
 
 func (s *sdk) ProjectGetMilestones(session unsafe.Pointer, project uniqueID) ([]taskRef, error) {
 	var m *C.HPMProjectMilestones
-	if err := toError(C.project_get_milestones(&s.funcs, session, C.HPMUniqueID(project), &m)); err != nil {
+	if err := s.call(callProjectGetMilestones, time.Now(), C.project_get_milestones(&s.funcs, session, C.HPMUniqueID(project), &m)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(m), nil)
+	defer s.objectFree(session, unsafe.Pointer(m))
 
 	out := make([]taskRef, m.m_nMilestones)
 	ptr := uintptr(unsafe.Pointer(m.m_pMilestones))
@@ -182,10 +321,10 @@ func (s *sdk) ProjectGetMilestones(session unsafe.Pointer, project uniqueID) ([]
 
 func (s *sdk) ProjectGetSprints(session unsafe.Pointer, project uniqueID) ([]uniqueID, error) {
 	var sprints *C.HPMProjectSprints
-	if err := toError(C.project_get_sprints(&s.funcs, session, C.HPMUniqueID(project), &sprints)); err != nil {
+	if err := s.call(callProjectGetSprints, time.Now(), C.project_get_sprints(&s.funcs, session, C.HPMUniqueID(project), &sprints)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(sprints), nil)
+	defer s.objectFree(session, unsafe.Pointer(sprints))
 
 	out := make([]uniqueID, sprints.m_nSprints)
 	ptr := uintptr(unsafe.Pointer(sprints.m_pSprints))
@@ -196,17 +335,16 @@ func (s *sdk) ProjectGetSprints(session unsafe.Pointer, project uniqueID) ([]uni
 }
 
 type projectCustomColumn struct {
-	hash int32
+	hash uint32
 	name string
-	unit string
 }
 
 func (s *sdk) ProjectCustomColumnsGet(session unsafe.Pointer, project uniqueID) ([]projectCustomColumn, error) {
 	var columns *C.HPMProjectCustomColumns
-	if err := toError(C.project_custom_columns_get(&s.funcs, session, C.HPMUniqueID(project), &columns)); err != nil {
+	if err := s.call(callProjectCustomColumnsGet, time.Now(), C.project_custom_columns_get(&s.funcs, session, C.HPMUniqueID(project), &columns)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(columns), nil)
+	defer s.objectFree(session, unsafe.Pointer(columns))
 
 	out := make([]projectCustomColumn, 0, columns.m_nHiddenColumns+columns.m_nShowingColumns)
 	add := func(l *C.HPMProjectCustomColumnsColumn, n C.HPMUInt32) {
@@ -214,22 +352,23 @@ func (s *sdk) ProjectCustomColumnsGet(session unsafe.Pointer, project uniqueID)
 		for i := 0; i < int(n); i++ {
 			column := (*C.HPMProjectCustomColumnsColumn)(unsafe.Pointer(ptr))
 			out = append(out, projectCustomColumn{
-				hash: int32(column.m_Hash),
+				hash: uint32(column.m_Hash),
+				name: C.GoString(column.m_pName),
 			})
 			ptr += unsafe.Sizeof(C.HPMProjectCustomColumnsColumn{})
 		}
 	}
 	add(columns.m_pHiddenColumns, columns.m_nHiddenColumns)
-	add(columns.m_pHiddenColumns, columns.m_nShowingColumns)
+	add(columns.m_pShowingColumns, columns.m_nShowingColumns)
 	return out, nil
 }
 
 func (s *sdk) ProjectWorkflowEnum(session unsafe.Pointer, project uniqueID) ([]int, error) {
 	var e *C.HPMProjectWorkflowEnum
-	if err := toError(C.project_workflow_enum(&s.funcs, session, C.HPMUniqueID(project), C.HPMUInt32(1), &e)); err != nil {
+	if err := s.call(callProjectWorkflowEnum, time.Now(), C.project_workflow_enum(&s.funcs, session, C.HPMUniqueID(project), C.HPMUInt32(1), &e)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	out := make([]int, e.m_nWorkflows)
 	ptr := uintptr(unsafe.Pointer(e.m_pWorkflows))
@@ -239,17 +378,19 @@ func (s *sdk) ProjectWorkflowEnum(session unsafe.Pointer, project uniqueID) ([]i
 	return out, nil
 }
 
-func (s *sdk) ProjectWorkflowGetStatuses(session unsafe.Pointer, project uniqueID, workflow int) (map[int]string, error) {
+func (s *sdk) ProjectWorkflowGetStatuses(session unsafe.Pointer, translations *translationCache, project uniqueID, workflow int) (map[int]string, error) {
 	var settings *C.HPMProjectWorkflowSettings
-	if err := toError(C.project_workflow_get_settings(&s.funcs, session, C.HPMUniqueID(project), C.HPMUInt32(workflow), &settings)); err != nil {
+	if err := s.call(callProjectWorkflowGetSettings, time.Now(), C.project_workflow_get_settings(&s.funcs, session, C.HPMUniqueID(project), C.HPMUInt32(workflow), &settings)); err != nil {
 		return nil, err
 	}
+	defer s.objectFree(session, unsafe.Pointer(settings))
+
 	out := map[int]string{}
 	ptr := uintptr(unsafe.Pointer(settings.m_pWorkflowObjects))
 	for i := 0; i < int(settings.m_nWorkflowObjects); i++ {
 		object := (*C.HPMProjectWorkflowObject)(unsafe.Pointer(ptr))
 		if object.m_ObjectType == C.EHPMProjectWorkflowObjectType_WorkflowStatus {
-			name, err := s.translateString(session, object.m_WorkflowStatus_pName)
+			name, err := s.translateString(session, translations, object.m_WorkflowStatus_pName)
 			if err != nil {
 				return nil, err
 			}
@@ -262,10 +403,10 @@ func (s *sdk) ProjectWorkflowGetStatuses(session unsafe.Pointer, project uniqueI
 
 func (s *sdk) ProjectResourceEnum(session unsafe.Pointer, project uniqueID) ([]uniqueID, error) {
 	var e *C.HPMProjectResourceEnum
-	if err := toError(C.project_resource_enum(&s.funcs, session, C.HPMUniqueID(project), &e)); err != nil {
+	if err := s.call(callProjectResourceEnum, time.Now(), C.project_resource_enum(&s.funcs, session, C.HPMUniqueID(project), &e)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	out := make([]uniqueID, e.m_nResources)
 	ptr := uintptr(unsafe.Pointer(e.m_pResources))
@@ -277,10 +418,10 @@ func (s *sdk) ProjectResourceEnum(session unsafe.Pointer, project uniqueID) ([]u
 
 func (s *sdk) TaskEnum(session unsafe.Pointer, container uniqueID) ([]uniqueID, error) {
 	var e *C.HPMTaskEnum
-	if err := toError(C.task_enum(&s.funcs, session, C.HPMUniqueID(container), &e)); err != nil {
+	if err := s.call(callTaskEnum, time.Now(), C.task_enum(&s.funcs, session, C.HPMUniqueID(container), &e)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	out := make([]uniqueID, e.m_nTasks)
 	ptr := uintptr(unsafe.Pointer(e.m_pTasks))
@@ -292,10 +433,10 @@ func (s *sdk) TaskEnum(session unsafe.Pointer, container uniqueID) ([]uniqueID,
 
 func (s *sdk) TaskRefEnum(session unsafe.Pointer, container uniqueID) ([]taskRef, error) {
 	var e *C.HPMTaskEnum
-	if err := toError(C.task_ref_enum(&s.funcs, session, C.HPMUniqueID(container), &e)); err != nil {
+	if err := s.call(callTaskRefEnum, time.Now(), C.task_ref_enum(&s.funcs, session, C.HPMUniqueID(container), &e)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	out := make([]taskRef, e.m_nTasks)
 	ptr := uintptr(unsafe.Pointer(e.m_pTasks))
@@ -305,49 +446,122 @@ func (s *sdk) TaskRefEnum(session unsafe.Pointer, container uniqueID) ([]taskRef
 	return out, nil
 }
 
+type linkedTask struct {
+	bug int
+	id  uniqueID
+	ref taskRef
+}
+
+// TaskRefEnumLinked returns the tasks in the container that have a hyperlink of
+// the form <prefix><number>, along with the counts of the tasks that could not
+// be linked.
+func (s *sdk) TaskRefEnumLinked(session unsafe.Pointer, scratch *arena, container uniqueID, prefix string) ([]linkedTask, LinkedCounts, error) {
+	scratch.begin()
+	defer scratch.end()
+	str := scratch.str(prefix)
+	var l *C.linked_task
+	var n, malformed, unreadable C.HPMUInt32
+	if err := s.call(callTaskRefEnumLinked, time.Now(), C.backlog_find_linked_tasks(&s.funcs, session, scratch.a, C.HPMUniqueID(container), str, &l, &n, &malformed, &unreadable)); err != nil {
+		return nil, LinkedCounts{}, err
+	}
+
+	out := make([]linkedTask, n)
+	ptr := uintptr(unsafe.Pointer(l))
+	for i := range out {
+		t := (*C.linked_task)(unsafe.Pointer(ptr))
+		out[i] = linkedTask{
+			bug: int(t.bug_id),
+			id:  uniqueID(t.task_id),
+			ref: taskRef(t.ref),
+		}
+		ptr += unsafe.Sizeof(C.linked_task{})
+	}
+	return out, LinkedCounts{int(malformed), int(unreadable)}, nil
+}
+
+// TaskRefFilterLinked returns the task refs that have a hyperlink of the form
+// <prefix><number>, along with the counts of the tasks that could not be
+// linked.
+func (s *sdk) TaskRefFilterLinked(session unsafe.Pointer, scratch *arena, refs []taskRef, prefix string) ([]linkedTask, LinkedCounts, error) {
+	n := len(refs)
+	if n == 0 {
+		return nil, LinkedCounts{}, nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
+	str := scratch.str(prefix)
+	in := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * n)))
+	for i, ref := range refs {
+		*(*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(in)) + uintptr(i*4))) = C.HPMUniqueID(ref)
+	}
+	l := (*C.linked_task)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.linked_task{})))
+	var count, malformed, unreadable C.HPMUInt32
+	if err := s.callBatch(callTaskRefFilterLinked, n, time.Now(), C.find_linked_tasks(&s.funcs, session, in, C.HPMUInt32(n), str, l, &count, &malformed, &unreadable)); err != nil {
+		return nil, LinkedCounts{}, err
+	}
+
+	out := make([]linkedTask, count)
+	ptr := uintptr(unsafe.Pointer(l))
+	for i := range out {
+		t := (*C.linked_task)(unsafe.Pointer(ptr))
+		out[i] = linkedTask{
+			bug: int(t.bug_id),
+			id:  uniqueID(t.task_id),
+			ref: taskRef(t.ref),
+		}
+		ptr += unsafe.Sizeof(C.linked_task{})
+	}
+	return out, LinkedCounts{int(malformed), int(unreadable)}, nil
+}
+
 func (s *sdk) TaskGetDescription(session unsafe.Pointer, task uniqueID) (string, error) {
 	var e *C.HPMString
-	if err := toError(C.task_get_description(&s.funcs, session, C.HPMUniqueID(task), &e)); err != nil {
+	if err := s.call(callTaskGetDescription, time.Now(), C.task_get_description(&s.funcs, session, C.HPMUniqueID(task), &e)); err != nil {
 		return "", err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	return C.GoString(e.m_pString), nil
 }
 
-func (s *sdk) TaskSetDescription(session unsafe.Pointer, task uniqueID, description string) error {
-	str := C.CString(description)
-	defer C.free(unsafe.Pointer(str))
-	return toError(C.task_set_description(&s.funcs, session, C.HPMUniqueID(task), str))
+func (s *sdk) TaskSetDescription(session unsafe.Pointer, scratch *arena, task uniqueID, description string) error {
+	scratch.begin()
+	defer scratch.end()
+	str := scratch.str(description)
+	return s.call(callTaskSetDescription, time.Now(), C.task_set_description(&s.funcs, session, C.HPMUniqueID(task), str))
 }
 
+// noWorkflow is the workflow ID of a task that does not use a workflow
+const noWorkflow = -1
+
 func (s *sdk) TaskGetWorkflow(session unsafe.Pointer, task uniqueID) (int, error) {
 	var id C.HPMUInt32
-	if err := toError(C.task_get_workflow(&s.funcs, session, C.HPMUniqueID(task), &id)); err != nil {
+	if err := s.call(callTaskGetWorkflow, time.Now(), C.task_get_workflow(&s.funcs, session, C.HPMUniqueID(task), &id)); err != nil {
 		return 0, err
 	}
-	return int(id), nil
+	return int(int32(id)), nil
 }
 
 func (s *sdk) TaskGetWorkflowStatus(session unsafe.Pointer, task uniqueID) (int, error) {
 	var status C.HPMInt32
-	if err := toError(C.task_get_workflow_status(&s.funcs, session, C.HPMUniqueID(task), &status)); err != nil {
+	if err := s.call(callTaskGetWorkflowStatus, time.Now(), C.task_get_workflow_status(&s.funcs, session, C.HPMUniqueID(task), &status)); err != nil {
 		return 0, err
 	}
 	return int(status), nil
 }
 
 func (s *sdk) TaskSetWorkflowStatus(session unsafe.Pointer, task uniqueID, status int) error {
-	return toError(C.task_set_workflow_status(&s.funcs, session, C.HPMUniqueID(task), C.HPMInt32(status), C.EHPMTaskSetStatusFlag_DoAutoAssignments|C.EHPMTaskSetStatusFlag_DoAutoCompletion))
+	return s.call(callTaskSetWorkflowStatus, time.Now(), C.task_set_workflow_status(&s.funcs, session, C.HPMUniqueID(task), C.HPMInt32(status), C.EHPMTaskSetStatusFlag_DoAutoAssignments|C.EHPMTaskSetStatusFlag_DoAutoCompletion))
 }
 
 func (s *sdk) TaskSetEstimatedIdealDays(session unsafe.Pointer, task uniqueID, days float64) error {
-	return toError(C.task_set_estimated_ideal_days(&s.funcs, session, C.HPMUniqueID(task), C.HPMFP64(days)))
+	return s.call(callTaskSetEstimatedIdealDays, time.Now(), C.task_set_estimated_ideal_days(&s.funcs, session, C.HPMUniqueID(task), C.HPMFP64(days)))
 }
 
 func (s *sdk) TaskGetEstimatedIdealDays(session unsafe.Pointer, task uniqueID) (float64, error) {
 	days := C.HPMFP64(0)
-	if err := toError(C.task_get_estimated_ideal_days(&s.funcs, session, C.HPMUniqueID(task), &days)); err != nil {
+	if err := s.call(callTaskGetEstimatedIdealDays, time.Now(), C.task_get_estimated_ideal_days(&s.funcs, session, C.HPMUniqueID(task), &days)); err != nil {
 		return 0, err
 	}
 	return float64(days), nil
@@ -360,10 +574,10 @@ type allocation struct {
 
 func (s *sdk) TaskGetResourceAllocation(session unsafe.Pointer, task uniqueID) ([]allocation, error) {
 	var a *C.HPMTaskResourceAllocation
-	if err := toError(C.task_get_resource_allocation(&s.funcs, session, C.HPMUniqueID(task), &a)); err != nil {
+	if err := s.call(callTaskGetResourceAllocation, time.Now(), C.task_get_resource_allocation(&s.funcs, session, C.HPMUniqueID(task), &a)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(a), nil)
+	defer s.objectFree(session, unsafe.Pointer(a))
 
 	out := make([]allocation, a.m_nResources)
 	ptr := uintptr(unsafe.Pointer(a.m_pResources))
@@ -378,9 +592,12 @@ func (s *sdk) TaskGetResourceAllocation(session unsafe.Pointer, task uniqueID) (
 	return out, nil
 }
 
-func (s *sdk) TaskSetResourceAllocation(session unsafe.Pointer, task uniqueID, allocations []allocation) error {
+func (s *sdk) TaskSetResourceAllocation(session unsafe.Pointer, scratch *arena, task uniqueID, allocations []allocation) error {
+	scratch.begin()
+	defer scratch.end()
+
 	n := len(allocations)
-	allocs := (*C.HPMTaskResourceAllocationResource)(C.malloc((C.ulong)(n) * (C.ulong)(unsafe.Sizeof(C.HPMTaskResourceAllocationResource{}))))
+	allocs := (*C.HPMTaskResourceAllocationResource)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.HPMTaskResourceAllocationResource{})))
 	ptr := uintptr(unsafe.Pointer(allocs))
 	for i := 0; i < n; i++ {
 		alloc := (*C.HPMTaskResourceAllocationResource)(unsafe.Pointer(ptr))
@@ -388,33 +605,103 @@ func (s *sdk) TaskSetResourceAllocation(session unsafe.Pointer, task uniqueID, a
 		alloc.m_PercentAllocated = C.HPMInt32(allocations[i].percent)
 		ptr += unsafe.Sizeof(C.HPMTaskResourceAllocationResource{})
 	}
-	defer C.free(unsafe.Pointer(allocs))
 
-	a := C.HPMTaskResourceAllocation{
-		m_nResources: C.HPMUInt32(n),
-		m_pResources: allocs,
-	}
-	return toError(C.task_set_resource_allocation(&s.funcs, session, C.HPMUniqueID(task), &a, C.HPMInt32(0), C.HPMInt32(0)))
+	a := (*C.HPMTaskResourceAllocation)(scratch.alloc(unsafe.Sizeof(C.HPMTaskResourceAllocation{})))
+	a.m_nResources = C.HPMUInt32(n)
+	a.m_pResources = allocs
+	return s.call(callTaskSetResourceAllocation, time.Now(), C.task_set_resource_allocation(&s.funcs, session, C.HPMUniqueID(task), a, C.HPMInt32(0), C.HPMInt32(0)))
 }
 
 func (s *sdk) TaskGetHyperlink(session unsafe.Pointer, task uniqueID) (string, error) {
 	var link *C.HPMString
-	if err := toError(C.task_get_hyperlink(&s.funcs, session, C.HPMUniqueID(task), &link)); err != nil {
+	if err := s.call(callTaskGetHyperlink, time.Now(), C.task_get_hyperlink(&s.funcs, session, C.HPMUniqueID(task), &link)); err != nil {
 		return "", err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(link), nil)
+	defer s.objectFree(session, unsafe.Pointer(link))
 	return C.GoString(link.m_pString), nil
 }
 
-func (s *sdk) TaskSetHyperlink(session unsafe.Pointer, task uniqueID, hyperlink string) error {
-	str := C.CString(hyperlink)
-	defer C.free(unsafe.Pointer(str))
-	return toError(C.task_set_hyperlink(&s.funcs, session, C.HPMUniqueID(task), (*C.HPMChar)(str)))
+func (s *sdk) TaskSetHyperlink(session unsafe.Pointer, scratch *arena, task uniqueID, hyperlink string) error {
+	scratch.begin()
+	defer scratch.end()
+	str := scratch.str(hyperlink)
+	return s.call(callTaskSetHyperlink, time.Now(), C.task_set_hyperlink(&s.funcs, session, C.HPMUniqueID(task), (*C.HPMChar)(str)))
+}
+
+func (s *sdk) TaskGetCustomColumnData(session unsafe.Pointer, task uniqueID, hash uint32) (string, error) {
+	var data *C.HPMString
+	if err := s.call(callTaskGetCustomColumnData, time.Now(), C.task_get_custom_column_data(&s.funcs, session, C.HPMUniqueID(task), C.HPMUInt32(hash), &data)); err != nil {
+		return "", err
+	}
+	defer s.objectFree(session, unsafe.Pointer(data))
+	return C.GoString(data.m_pString), nil
+}
+
+func (s *sdk) TaskSetCustomColumnData(session unsafe.Pointer, scratch *arena, task uniqueID, hash uint32, data string) error {
+	scratch.begin()
+	defer scratch.end()
+	str := scratch.str(data)
+	return s.call(callTaskSetCustomColumnData, time.Now(), C.task_set_custom_column_data(&s.funcs, session, C.HPMUniqueID(task), C.HPMUInt32(hash), (*C.HPMChar)(str)))
+}
+
+// TaskCustomColumns reads the custom columns with the given hashes for all
+// the tasks in a single batch. out[t][c] is the value of column hashes[c] of
+// task tasks[t], and errs[t] is the first error reading the task's columns.
+func (s *sdk) TaskCustomColumns(session unsafe.Pointer, scratch *arena, tasks []uniqueID, hashes []uint32) (out [][]string, errs []error) {
+	nTasks, nColumns := len(tasks), len(hashes)
+	if nTasks == 0 || nColumns == 0 {
+		return nil, nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
+	n := nTasks * nColumns
+	ids := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * nTasks)))
+	for i, id := range tasks {
+		*(*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(ids)) + uintptr(i*4))) = C.HPMUniqueID(id)
+	}
+	h := (*C.HPMUInt32)(scratch.alloc(uintptr(4 * nColumns)))
+	for i, hash := range hashes {
+		*(*C.HPMUInt32)(unsafe.Pointer(uintptr(unsafe.Pointer(h)) + uintptr(i*4))) = C.HPMUInt32(hash)
+	}
+	values := (**C.HPMString)(scratch.alloc(uintptr(n) * unsafe.Sizeof(uintptr(0))))
+	codes := (*C.HPMError)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.HPMError(0))))
+
+	start := time.Now()
+	C.task_custom_columns_batch(&s.funcs, session, ids, C.HPMUInt32(nTasks), h, C.HPMUInt32(nColumns), values, codes)
+	defer func() {
+		start := time.Now()
+		C.task_custom_columns_free(&s.funcs, session, values, C.HPMUInt32(n))
+		s.metrics.record(callTaskCustomColumnsFree, start, n, 0)
+	}()
+
+	strs := make([]string, n) // Single allocation shared by all the tasks
+	out = make([][]string, nTasks)
+	errs = make([]error, nTasks)
+	for i := 0; i < n; i++ {
+		value := *(**C.HPMString)(unsafe.Pointer(uintptr(unsafe.Pointer(values)) + uintptr(i)*unsafe.Sizeof(uintptr(0))))
+		code := *(*C.HPMError)(unsafe.Pointer(uintptr(unsafe.Pointer(codes)) + uintptr(i)*unsafe.Sizeof(C.HPMError(0))))
+		if err := toError(code); err != nil && errs[i/nColumns] == nil {
+			errs[i/nColumns] = err
+		}
+		if value != nil {
+			strs[i] = C.GoString(value.m_pString)
+		}
+	}
+	failures := 0
+	for t := range out {
+		out[t] = strs[t*nColumns : (t+1)*nColumns : (t+1)*nColumns]
+		if errs[t] != nil {
+			failures++
+		}
+	}
+	s.metrics.record(callTaskCustomColumns, start, nTasks, failures)
+	return out, errs
 }
 
 func (s *sdk) UtilGetNoMilestoneID(session unsafe.Pointer) (taskRef, error) {
 	var id C.HPMInt32
-	if err := toError(C.util_get_no_milestone_id(&s.funcs, session, &id)); err != nil {
+	if err := s.call(callUtilGetNoMilestoneID, time.Now(), C.util_get_no_milestone_id(&s.funcs, session, &id)); err != nil {
 		return 0, err
 	}
 	return taskRef(id), nil
@@ -422,10 +709,10 @@ func (s *sdk) UtilGetNoMilestoneID(session unsafe.Pointer) (taskRef, error) {
 
 func (s *sdk) TaskGetLinkedToMilestones(session unsafe.Pointer, task uniqueID) ([]taskRef, error) {
 	var l *C.HPMTaskLinkedToMilestones
-	if err := toError(C.task_get_linked_to_milestones(&s.funcs, session, C.HPMUniqueID(task), &l)); err != nil {
+	if err := s.call(callTaskGetLinkedToMilestones, time.Now(), C.task_get_linked_to_milestones(&s.funcs, session, C.HPMUniqueID(task), &l)); err != nil {
 		return nil, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(l), nil)
+	defer s.objectFree(session, unsafe.Pointer(l))
 
 	out := make([]taskRef, l.m_nMilestones)
 	ptr := uintptr(unsafe.Pointer(l.m_pMilestones))
@@ -435,79 +722,119 @@ func (s *sdk) TaskGetLinkedToMilestones(session unsafe.Pointer, task uniqueID) (
 	return out, nil
 }
 
-func (s *sdk) TaskSetLinkedToMilestones(session unsafe.Pointer, task uniqueID, milestones []taskRef) error {
-	m := (*C.HPMUniqueID)(C.malloc(C.ulong(4 * len(milestones))))
-	defer C.free(unsafe.Pointer(m))
+func (s *sdk) TaskSetLinkedToMilestones(session unsafe.Pointer, scratch *arena, task uniqueID, milestones []taskRef) error {
+	scratch.begin()
+	defer scratch.end()
+
+	m := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * len(milestones))))
 	for i, milestone := range milestones {
 		p := (*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(m)) + uintptr(i*4)))
 		*p = C.HPMUniqueID(milestone)
 	}
-	l := C.HPMTaskLinkedToMilestones{
-		m_nMilestones: C.HPMUInt32(len(milestones)),
-		m_pMilestones: m,
-	}
-	return toError(C.task_set_linked_to_milestones(&s.funcs, session, C.HPMUniqueID(task), &l))
+	l := (*C.HPMTaskLinkedToMilestones)(scratch.alloc(unsafe.Sizeof(C.HPMTaskLinkedToMilestones{})))
+	l.m_nMilestones = C.HPMUInt32(len(milestones))
+	l.m_pMilestones = m
+	return s.call(callTaskSetLinkedToMilestones, time.Now(), C.task_set_linked_to_milestones(&s.funcs, session, C.HPMUniqueID(task), l))
 }
 
 func (s *sdk) TaskGetLinkedToSprint(session unsafe.Pointer, task uniqueID) (taskRef, error) {
 	var id C.HPMUniqueID
-	if err := toError(C.task_get_linked_to_sprint(&s.funcs, session, C.HPMUniqueID(task), &id)); err != nil {
+	if err := s.call(callTaskGetLinkedToSprint, time.Now(), C.task_get_linked_to_sprint(&s.funcs, session, C.HPMUniqueID(task), &id)); err != nil {
 		return 0, err
 	}
 	return taskRef(id), nil
 }
 
-func (s *sdk) TaskSetLinkedToSprint(session unsafe.Pointer, project uniqueID, task, sprint taskRef) error {
+// TaskSetLinkedToSprint links all the tasks to the sprint by creating a proxy
+// for each task in the sprint, with a single call to TaskCreateUnified()
+func (s *sdk) TaskSetLinkedToSprint(session unsafe.Pointer, scratch *arena, project uniqueID, tasks []taskRef, sprint taskRef) error {
+	n := len(tasks)
+	if n == 0 {
+		return nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
 	// https://stackoverflow.com/a/33297896
-	parent := (*C.HPMTaskCreateUnifiedReference)(C.malloc(C.ulong(unsafe.Sizeof(C.HPMTaskCreateUnifiedReference{}))))
-	defer C.free(unsafe.Pointer(parent))
-	*parent = C.HPMTaskCreateUnifiedReference{
-		m_RefID: C.HPMUniqueID(sprint),
-	}
-
-	entry := (*C.HPMTaskCreateUnifiedEntry)(C.malloc(C.ulong(unsafe.Sizeof(C.HPMTaskCreateUnifiedEntry{}))))
-	defer C.free(unsafe.Pointer(entry))
-	*entry = C.HPMTaskCreateUnifiedEntry{
-		m_bIsProxy:       1,
-		m_TaskType:       C.EHPMTaskType_Planned,
-		m_TaskLockedType: C.EHPMTaskLockedType_BacklogItem,
-		m_nParentRefIDs:  1,
-		m_pParentRefIDs:  parent,
-		m_PreviousRefID: C.HPMTaskCreateUnifiedReference{
-			m_RefID: C.HPMUniqueID(sprint),
-		},
-		m_Proxy_ReferToRefTaskID: C.HPMUniqueID(task),
-	}
-
-	data := C.HPMTaskCreateUnified{
-		m_nTasks:      1,
-		m_pTasks:      entry,
-		m_OptionFlags: C.EHPMTaskCreateOptionFlag_UpdateCustomDateColumns | C.EHPMTaskCreateOptionFlag_SetDefaultValues,
+	parent := (*C.HPMTaskCreateUnifiedReference)(scratch.alloc(unsafe.Sizeof(C.HPMTaskCreateUnifiedReference{})))
+	parent.m_RefID = C.HPMUniqueID(sprint)
+
+	entries := (*C.HPMTaskCreateUnifiedEntry)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.HPMTaskCreateUnifiedEntry{})))
+	ptr := uintptr(unsafe.Pointer(entries))
+	for i, task := range tasks {
+		entry := (*C.HPMTaskCreateUnifiedEntry)(unsafe.Pointer(ptr))
+		*entry = C.HPMTaskCreateUnifiedEntry{
+			m_bIsProxy:       1,
+			m_LocalID:        C.HPMInt32(i),
+			m_TaskType:       C.EHPMTaskType_Planned,
+			m_TaskLockedType: C.EHPMTaskLockedType_BacklogItem,
+			m_nParentRefIDs:  1,
+			m_pParentRefIDs:  parent,
+			m_PreviousRefID: C.HPMTaskCreateUnifiedReference{
+				m_RefID: C.HPMUniqueID(sprint),
+			},
+			m_Proxy_ReferToRefTaskID: C.HPMUniqueID(task),
+		}
+		ptr += unsafe.Sizeof(C.HPMTaskCreateUnifiedEntry{})
 	}
+
+	data := (*C.HPMTaskCreateUnified)(scratch.alloc(unsafe.Sizeof(C.HPMTaskCreateUnified{})))
+	data.m_nTasks = C.HPMUInt32(n)
+	data.m_pTasks = entries
+	data.m_OptionFlags = C.EHPMTaskCreateOptionFlag_UpdateCustomDateColumns | C.EHPMTaskCreateOptionFlag_SetDefaultValues
 	var result *C.HPMChangeCallbackData_TaskCreateUnified
-	if err := toError(C.task_create_unified(&s.funcs, session, C.HPMUniqueID(project), &data, &result)); err != nil {
+	if err := s.callBatch(callTaskSetLinkedToSprint, n, time.Now(), C.task_create_unified(&s.funcs, session, C.HPMUniqueID(project), data, &result)); err != nil {
 		return err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(result), nil)
+	defer s.objectFree(session, unsafe.Pointer(result))
 
 	return nil
 }
 
+func (s *sdk) TaskRefUtilEnumChildren(session unsafe.Pointer, ref taskRef) ([]taskRef, error) {
+	var e *C.HPMTaskEnum
+	if err := s.call(callTaskRefUtilEnumChildren, time.Now(), C.task_ref_util_enum_children(&s.funcs, session, C.HPMUniqueID(ref), C.HPMInt32(0), &e)); err != nil {
+		return nil, err
+	}
+	defer s.objectFree(session, unsafe.Pointer(e))
+
+	out := make([]taskRef, e.m_nTasks)
+	ptr := uintptr(unsafe.Pointer(e.m_pTasks))
+	for i := range out {
+		out[i] = *(*taskRef)(unsafe.Pointer(ptr + uintptr(i*4)))
+	}
+	return out, nil
+}
+
+func (s *sdk) TaskRefDelete(session unsafe.Pointer, ref taskRef) error {
+	return s.call(callTaskRefDelete, time.Now(), C.task_ref_delete(&s.funcs, session, C.HPMUniqueID(ref)))
+}
+
 func (s *sdk) TaskGetBacklogPriority(session unsafe.Pointer, task uniqueID) (Priority, error) {
 	var priority C.HPMInt32
-	if err := toError(C.task_get_backlog_priority(&s.funcs, session, C.HPMUniqueID(task), &priority)); err != nil {
+	if err := s.call(callTaskGetBacklogPriority, time.Now(), C.task_get_backlog_priority(&s.funcs, session, C.HPMUniqueID(task), &priority)); err != nil {
 		return PriorityMedium, err
 	}
 	return Priority(priority), nil
 }
 
 func (s *sdk) TaskSetBacklogPriority(session unsafe.Pointer, task uniqueID, priority Priority) error {
-	return toError(C.task_set_backlog_priority(&s.funcs, session, C.HPMUniqueID(task), (C.HPMInt32)(priority)))
+	return s.call(callTaskSetBacklogPriority, time.Now(), C.task_set_backlog_priority(&s.funcs, session, C.HPMUniqueID(task), (C.HPMInt32)(priority)))
 }
 
 func (s *sdk) TaskGetMainReference(session unsafe.Pointer, task uniqueID) (taskRef, error) {
 	var ref C.HPMUniqueID
-	if err := toError(C.task_get_main_reference(&s.funcs, session, C.HPMUniqueID(task), &ref)); err != nil {
+	if err := s.call(callTaskGetMainReference, time.Now(), C.task_get_main_reference(&s.funcs, session, C.HPMUniqueID(task), &ref)); err != nil {
+		return 0, err
+	}
+	return taskRef(ref), nil
+}
+
+// TaskGetProxy returns the reference of the task's proxy in the project's
+// schedule, or -1 if it has none
+func (s *sdk) TaskGetProxy(session unsafe.Pointer, task uniqueID) (taskRef, error) {
+	var ref C.HPMUniqueID
+	if err := s.call(callTaskGetProxy, time.Now(), C.task_get_proxy(&s.funcs, session, C.HPMUniqueID(task), &ref)); err != nil {
 		return 0, err
 	}
 	return taskRef(ref), nil
@@ -522,11 +849,11 @@ const (
 	unifiedTaskMilestone
 )
 
-func (s *sdk) TaskCreateUnified(session unsafe.Pointer, container uniqueID, ty unifiedTaskType) (taskRef, error) {
-	task := (*C.HPMTaskCreateUnifiedEntry)(C.malloc(C.ulong(unsafe.Sizeof(C.HPMTaskCreateUnifiedEntry{}))))
-	defer C.free(unsafe.Pointer(task))
+func (s *sdk) TaskCreateUnified(session unsafe.Pointer, scratch *arena, container uniqueID, ty unifiedTaskType) (taskRef, error) {
+	scratch.begin()
+	defer scratch.end()
 
-	*task = C.HPMTaskCreateUnifiedEntry{}
+	task := (*C.HPMTaskCreateUnifiedEntry)(scratch.alloc(unsafe.Sizeof(C.HPMTaskCreateUnifiedEntry{})))
 	switch ty {
 	case unifiedTaskPlanned:
 		task.m_TaskType = C.EHPMTaskType_Planned
@@ -534,23 +861,45 @@ func (s *sdk) TaskCreateUnified(session unsafe.Pointer, container uniqueID, ty u
 		task.m_TaskType = C.EHPMTaskType_Milestone
 	}
 
-	data := C.HPMTaskCreateUnified{
-		m_nTasks:      1,
-		m_pTasks:      task,
-		m_OptionFlags: C.EHPMTaskCreateOptionFlag_UpdateCustomDateColumns | C.EHPMTaskCreateOptionFlag_SetDefaultValues,
-	}
+	data := (*C.HPMTaskCreateUnified)(scratch.alloc(unsafe.Sizeof(C.HPMTaskCreateUnified{})))
+	data.m_nTasks = 1
+	data.m_pTasks = task
+	data.m_OptionFlags = C.EHPMTaskCreateOptionFlag_UpdateCustomDateColumns | C.EHPMTaskCreateOptionFlag_SetDefaultValues
 	var result *C.HPMChangeCallbackData_TaskCreateUnified
-	if err := toError(C.task_create_unified(&s.funcs, session, C.HPMUniqueID(container), &data, &result)); err != nil {
+	if err := s.call(callTaskCreateUnified, time.Now(), C.task_create_unified(&s.funcs, session, C.HPMUniqueID(container), data, &result)); err != nil {
 		return 0, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(result), nil)
+	defer s.objectFree(session, unsafe.Pointer(result))
 
 	return taskRef(result.m_pTasks.m_TaskRefID), nil
 }
 
+// TaskCreatePlannedBatch creates n planned tasks in the container with a single
+// call to TaskCreateUnified(). The tasks that were created are returned even if
+// an error is returned.
+func (s *sdk) TaskCreatePlannedBatch(session unsafe.Pointer, scratch *arena, container uniqueID, n int) ([]taskRef, []uniqueID, error) {
+	if n == 0 {
+		return nil, nil, nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
+	refs := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * n)))
+	ids := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * n)))
+	var created C.HPMUInt32
+	err := s.callBatch(callTaskCreatePlannedBatch, n, time.Now(), C.task_create_planned_batch(&s.funcs, session, scratch.a, C.HPMUniqueID(container), C.HPMUInt32(n), refs, ids, &created))
+	outRefs := make([]taskRef, created)
+	outIDs := make([]uniqueID, created)
+	for i := 0; i < int(created); i++ {
+		outRefs[i] = taskRef(*(*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(refs)) + uintptr(i*4))))
+		outIDs[i] = uniqueID(*(*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(ids)) + uintptr(i*4))))
+	}
+	return outRefs, outIDs, err
+}
+
 func (s *sdk) TaskRefGetTask(session unsafe.Pointer, ref taskRef) (uniqueID, error) {
 	var realID C.HPMUniqueID
-	if err := toError(C.task_ref_get_task(&s.funcs, session, C.HPMUniqueID(ref), &realID)); err != nil {
+	if err := s.call(callTaskRefGetTask, time.Now(), C.task_ref_get_task(&s.funcs, session, C.HPMUniqueID(ref), &realID)); err != nil {
 		return 0, err
 	}
 	return uniqueID(realID), nil
@@ -558,18 +907,197 @@ func (s *sdk) TaskRefGetTask(session unsafe.Pointer, ref taskRef) (uniqueID, err
 
 func (s *sdk) TaskRefGetContainer(session unsafe.Pointer, ref taskRef) (uniqueID, error) {
 	var realID C.HPMUniqueID
-	if err := toError(C.task_ref_get_container(&s.funcs, session, C.HPMUniqueID(ref), &realID)); err != nil {
+	if err := s.call(callTaskRefGetContainer, time.Now(), C.task_ref_get_container(&s.funcs, session, C.HPMUniqueID(ref), &realID)); err != nil {
 		return 0, err
 	}
 	return uniqueID(realID), nil
 }
 
+type taskField int
+
+const (
+	taskFieldHyperlink      taskField = C.TASK_SNAPSHOT_HYPERLINK
+	taskFieldDescription    taskField = C.TASK_SNAPSHOT_DESCRIPTION
+	taskFieldResource       taskField = C.TASK_SNAPSHOT_RESOURCE
+	taskFieldWorkflowStatus taskField = C.TASK_SNAPSHOT_WORKFLOW_STATUS
+	taskFieldIdealDays      taskField = C.TASK_SNAPSHOT_IDEAL_DAYS
+	taskFieldPriority       taskField = C.TASK_SNAPSHOT_PRIORITY
+	taskFieldMilestone      taskField = C.TASK_SNAPSHOT_MILESTONE
+	taskFieldSprint         taskField = C.TASK_SNAPSHOT_SPRINT
+	taskFieldCount                    = C.TASK_SNAPSHOT_FIELD_COUNT
+)
+
+func (f taskField) String() string {
+	switch f {
+	case taskFieldHyperlink:
+		return "hyperlink"
+	case taskFieldDescription:
+		return "description"
+	case taskFieldResource:
+		return "assignee"
+	case taskFieldWorkflowStatus:
+		return "status"
+	case taskFieldIdealDays:
+		return "estimated duration"
+	case taskFieldPriority:
+		return "priority"
+	case taskFieldMilestone:
+		return "milestone"
+	case taskFieldSprint:
+		return "sprint"
+	}
+	return fmt.Sprintf("<field %d>", int(f))
+}
+
+type taskSnapshot struct {
+	hyperlink      string
+	description    string
+	resource       uniqueID // -1 if unassigned
+	workflow       int      // noWorkflow if none
+	workflowStatus int
+	idealDays      float64
+	priority       Priority
+	milestone      uniqueID // -1 if none
+	sprint         uniqueID // -1 if none
+	errors         [taskFieldCount]error
+}
+
+// TaskSnapshot reads the fields of all the given tasks with a single cgo call.
+func (s *sdk) TaskSnapshot(session unsafe.Pointer, scratch *arena, tasks []uniqueID, noMilestoneID taskRef) []taskSnapshot {
+	n := len(tasks)
+	if n == 0 {
+		return nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
+	ids := (*C.HPMUniqueID)(scratch.alloc(uintptr(4 * n)))
+	for i, id := range tasks {
+		p := (*C.HPMUniqueID)(unsafe.Pointer(uintptr(unsafe.Pointer(ids)) + uintptr(i*4)))
+		*p = C.HPMUniqueID(id)
+	}
+	records := (*C.task_snapshot)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.task_snapshot{})))
+
+	start := time.Now()
+	C.task_snapshot_batch(&s.funcs, session, ids, C.HPMUInt32(n), C.HPMUniqueID(noMilestoneID), records)
+	defer func() {
+		start := time.Now()
+		C.task_snapshot_free(&s.funcs, session, records, C.HPMUInt32(n))
+		s.metrics.record(callTaskSnapshotFree, start, n, 0)
+	}()
+
+	out := make([]taskSnapshot, n)
+	failures := 0
+	ptr := uintptr(unsafe.Pointer(records))
+	for i := range out {
+		r := (*C.task_snapshot)(unsafe.Pointer(ptr))
+		o := &out[i]
+		if r.hyperlink != nil {
+			o.hyperlink = C.GoString(r.hyperlink.m_pString)
+		}
+		if r.description != nil {
+			o.description = C.GoString(r.description.m_pString)
+		}
+		o.resource = uniqueID(r.resource)
+		o.workflow = int(int32(r.workflow))
+		o.workflowStatus = int(r.workflow_status)
+		o.idealDays = float64(r.ideal_days)
+		o.priority = Priority(r.priority)
+		o.milestone = uniqueID(r.milestone)
+		o.sprint = uniqueID(r.sprint)
+		failed := false
+		for f := range o.errors {
+			o.errors[f] = toError(r.errors[f])
+			failed = failed || o.errors[f] != nil
+		}
+		if failed {
+			failures++
+		}
+		ptr += unsafe.Sizeof(C.task_snapshot{})
+	}
+	s.metrics.record(callTaskSnapshot, start, n, failures)
+	return out
+}
+
+// taskExpected holds the expected field values of a task, as compared by
+// TaskCompare()
+type taskExpected struct {
+	task        uniqueID
+	hyperlink   string
+	description string
+	resource    uniqueID // -1 if unassigned
+	minutes     int64    // Estimated duration in whole minutes
+	priority    Priority
+	milestone   uniqueID      // -1 if none
+	sprint      uniqueID      // -1 if none
+	ignore      taskFieldMask // Fields that are not compared
+}
+
+// taskFieldMask is a bitmask of (1 << taskField)
+type taskFieldMask uint32
+
+type taskCompared struct {
+	mismatch       taskFieldMask // Fields that differ, or could not be read
+	workflow       int           // noWorkflow if none
+	workflowStatus int
+}
+
+// TaskCompare compares the fields of all the given tasks against their
+// expected values with a single cgo call. Only the mismatch masks and the
+// workflow statuses are copied back.
+func (s *sdk) TaskCompare(session unsafe.Pointer, scratch *arena, expected []taskExpected, noMilestoneID taskRef) []taskCompared {
+	n := len(expected)
+	if n == 0 {
+		return nil
+	}
+	scratch.begin()
+	defer scratch.end()
+
+	records := (*C.task_expected)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.task_expected{})))
+	ptr := uintptr(unsafe.Pointer(records))
+	for _, e := range expected {
+		r := (*C.task_expected)(unsafe.Pointer(ptr))
+		r.task = C.HPMUniqueID(e.task)
+		r.resource = C.HPMUniqueID(e.resource)
+		r.minutes = C.HPMInt64(e.minutes)
+		r.priority = C.HPMInt32(e.priority)
+		r.milestone = C.HPMUniqueID(e.milestone)
+		r.sprint = C.HPMUniqueID(e.sprint)
+		r.ignore = C.HPMUInt32(e.ignore)
+		if e.ignore&(1<<taskFieldHyperlink) == 0 {
+			r.hyperlink = scratch.str(e.hyperlink)
+		}
+		if e.ignore&(1<<taskFieldDescription) == 0 {
+			r.description = scratch.str(e.description)
+		}
+		ptr += unsafe.Sizeof(C.task_expected{})
+	}
+	compared := (*C.task_compared)(scratch.alloc(uintptr(n) * unsafe.Sizeof(C.task_compared{})))
+
+	start := time.Now()
+	C.task_compare_batch(&s.funcs, session, records, C.HPMUInt32(n), C.HPMUniqueID(noMilestoneID), hoursInWorkingDay, compared)
+
+	out := make([]taskCompared, n)
+	ptr = uintptr(unsafe.Pointer(compared))
+	for i := range out {
+		r := (*C.task_compared)(unsafe.Pointer(ptr))
+		out[i] = taskCompared{
+			mismatch:       taskFieldMask(r.mismatch),
+			workflow:       int(int32(r.workflow)),
+			workflowStatus: int(r.workflow_status),
+		}
+		ptr += unsafe.Sizeof(C.task_compared{})
+	}
+	s.metrics.record(callTaskCompare, start, n, 0)
+	return out
+}
+
 func (s *sdk) ResourceGetProperties(session unsafe.Pointer, id uniqueID) (resource, error) {
 	var e *C.HPMResourceProperties
-	if err := toError(C.resource_get_properties(&s.funcs, session, C.HPMUniqueID(id), &e)); err != nil {
+	if err := s.call(callResourceGetProperties, time.Now(), C.resource_get_properties(&s.funcs, session, C.HPMUniqueID(id), &e)); err != nil {
 		return resource{}, err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(e), nil)
+	defer s.objectFree(session, unsafe.Pointer(e))
 
 	return resource{
 		id:    id,
@@ -578,18 +1106,60 @@ func (s *sdk) ResourceGetProperties(session unsafe.Pointer, id uniqueID) (resour
 	}, nil
 }
 
-func (s *sdk) translateString(session unsafe.Pointer, untranslated *C.HPMUntranslatedString) (string, error) {
+// translationLanguage is the language that strings are translated to
+const translationLanguage = 0x0809 // English - United Kingdom
+
+// translationCache holds the strings translated by translateString(), keyed by
+// language and the untranslated string IDs.
+// Each session owns a translationCache.
+type translationCache struct {
+	mutex        sync.Mutex
+	translations map[translationKey]string
+}
+
+type translationKey struct {
+	language int
+	ids      string // The untranslated string IDs, 4 bytes per ID
+}
+
+func newTranslationCache() *translationCache {
+	return &translationCache{translations: map[translationKey]string{}}
+}
+
+func (s *sdk) translateString(session unsafe.Pointer, cache *translationCache, untranslated *C.HPMUntranslatedString) (string, error) {
+	key := translationKey{
+		language: translationLanguage,
+		ids:      C.GoStringN((*C.char)(unsafe.Pointer(untranslated.m_pIDs)), C.int(4*untranslated.m_nIDs)),
+	}
+	cache.mutex.Lock()
+	str, ok := cache.translations[key]
+	cache.mutex.Unlock()
+	if ok {
+		return str, nil
+	}
+
 	language := C.HPMLanguage{
-		m_LanguageID: 0x0809, // English - United Kingdom
+		m_LanguageID: translationLanguage,
 	}
 
 	var translated *C.HPMString
-	if err := toError(C.localization_translate_string(&s.funcs, session, &language, untranslated, &translated)); err != nil {
+	if err := s.call(callLocalizationTranslateString, time.Now(), C.localization_translate_string(&s.funcs, session, &language, untranslated, &translated)); err != nil {
 		return "", err
 	}
-	defer C.object_free(&s.funcs, session, unsafe.Pointer(translated), nil)
+	defer s.objectFree(session, unsafe.Pointer(translated))
 
-	return C.GoString(translated.m_pString), nil
+	str = C.GoString(translated.m_pString)
+	cache.mutex.Lock()
+	cache.translations[key] = str
+	cache.mutex.Unlock()
+	return str, nil
+}
+
+func boolToInt(b bool) int {
+	if b {
+		return 1
+	}
+	return 0
 }
 
 func toError(e C.HPMError) error {
@@ -14,7 +14,228 @@
 
 #include "../../third_party/hansoft_sdk/HPMSdk.c"
 
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 extern void onProcessCallback(void *);
+extern void onChangeCallback(void *, HPMInt32, HPMInt32, HPMInt32, HPMInt32);
+
+// arena is a bump allocator used to build the arguments passed to the SDK,
+// avoiding a malloc() / free() pair for each buffer. Allocations that do not
+// fit in the block are made in individually malloc()'d overflow blocks, which
+// are folded into a single larger block by arena_reset(), so that the arena
+// settles on a size that fits a whole batch.
+typedef struct arena_overflow
+{
+    struct arena_overflow *next;
+    size_t size;
+} arena_overflow;
+
+typedef struct arena
+{
+    char *base;
+    size_t size;
+    size_t used;
+    arena_overflow *overflow;
+    size_t overflowSize;
+} arena;
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+arena *arena_new(size_t _Size)
+{
+    arena *a = (arena *)calloc(1, sizeof(arena));
+    if (a)
+    {
+        a->base = (char *)malloc(_Size);
+        a->size = a->base ? _Size : 0;
+    }
+    return a;
+}
+
+// arena_alloc() returns _Size bytes of zero-initialized memory that remains
+// valid until the next call to arena_reset(), or NULL if out of memory.
+void *arena_alloc(arena *a, size_t _Size)
+{
+    _Size = ARENA_ROUND_UP(_Size ? _Size : 1);
+    void *p;
+    if (a->size - a->used >= _Size)
+    {
+        p = a->base + a->used;
+        a->used += _Size;
+    }
+    else
+    {
+        arena_overflow *o = (arena_overflow *)malloc(ARENA_ROUND_UP(sizeof(arena_overflow)) + _Size);
+        if (!o)
+        {
+            return NULL;
+        }
+        o->next = a->overflow;
+        o->size = _Size;
+        a->overflow = o;
+        a->overflowSize += _Size;
+        p = (char *)o + ARENA_ROUND_UP(sizeof(arena_overflow));
+    }
+    memset(p, 0, _Size);
+    return p;
+}
+
+// arena_string() returns a NUL-terminated copy of the Go string _Str.
+char *arena_string(arena *a, _GoString_ _Str)
+{
+    size_t len = _GoStringLen(_Str);
+    char *p = (char *)arena_alloc(a, len + 1);
+    if (p)
+    {
+        memcpy(p, _GoStringPtr(_Str), len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+// arena_reset() releases all the allocations made since the last reset.
+void arena_reset(arena *a)
+{
+    if (a->overflow)
+    {
+        size_t size = a->size + a->overflowSize;
+        while (a->overflow)
+        {
+            arena_overflow *next = a->overflow->next;
+            free(a->overflow);
+            a->overflow = next;
+        }
+        a->overflowSize = 0;
+        char *base = (char *)malloc(size);
+        if (base)
+        {
+            free(a->base);
+            a->base = base;
+            a->size = size;
+        }
+    }
+    a->used = 0;
+}
+
+void arena_free(arena *a)
+{
+    arena_reset(a);
+    free(a->base);
+    free(a);
+}
+
+// Kinds of change passed to onChangeCallback()
+enum
+{
+    CHANGE_TASK_FIELD,   // (container: -1,      id: task ID,     field: EHPMTaskField)
+    CHANGE_TASK_CREATE,  // (container: parent,  id: task ref,    field: 0)
+    CHANGE_TASK_DELETE,  // (container: -1,      id: task ID,     field: 0)
+    CHANGE_RESOURCE,     // (container: project or -1, id: resource ID, field: 0)
+    CHANGE_WORKFLOW,     // (container: project, id: workflow ID, field: 0)
+    CHANGE_TASK_COLUMN,  // (container: -1,      id: task ID,     field: column hash)
+    CHANGE_COLUMNS,      // (container: project, id: 0,           field: 0)
+};
+
+// change_callback() is the HPMChangeCallback registered by
+// session_register_change_callbacks(). It flattens the SDK's change callback
+// data into calls to onChangeCallback().
+void change_callback(void *_pContext, EHPMChangeCallback _ID, const void *_pData)
+{
+    switch (_ID)
+    {
+    case EHPMChangeCallback_TaskChange:
+    {
+        const HPMChangeCallbackData_TaskChange *data = (const HPMChangeCallbackData_TaskChange *)_pData;
+        onChangeCallback(_pContext, CHANGE_TASK_FIELD, -1, data->m_TaskID, data->m_FieldChanged);
+        break;
+    }
+    case EHPMChangeCallback_TaskCreateUnified:
+    {
+        const HPMChangeCallbackData_TaskCreateUnified *data = (const HPMChangeCallbackData_TaskCreateUnified *)_pData;
+        for (HPMUInt32 i = 0; i < data->m_nTasks; i++)
+        {
+            onChangeCallback(_pContext, CHANGE_TASK_CREATE, data->m_ContainerID, data->m_pTasks[i].m_TaskRefID, 0);
+        }
+        break;
+    }
+    case EHPMChangeCallback_TaskDelete:
+    {
+        const HPMChangeCallbackData_TaskDelete *data = (const HPMChangeCallbackData_TaskDelete *)_pData;
+        onChangeCallback(_pContext, CHANGE_TASK_DELETE, -1, data->m_TaskID, 0);
+        break;
+    }
+    case EHPMChangeCallback_ResourceProperties:
+    {
+        const HPMChangeCallbackData_ResourceProperties *data = (const HPMChangeCallbackData_ResourceProperties *)_pData;
+        onChangeCallback(_pContext, CHANGE_RESOURCE, -1, data->m_ResourceID, 0);
+        break;
+    }
+    case EHPMChangeCallback_ProjectResourceAdd:
+    {
+        const HPMChangeCallbackData_ProjectResourceAdd *data = (const HPMChangeCallbackData_ProjectResourceAdd *)_pData;
+        onChangeCallback(_pContext, CHANGE_RESOURCE, data->m_ProjectID, data->m_ResourceID, 0);
+        break;
+    }
+    case EHPMChangeCallback_ProjectResourceRemove:
+    {
+        const HPMChangeCallbackData_ProjectResourceRemove *data = (const HPMChangeCallbackData_ProjectResourceRemove *)_pData;
+        onChangeCallback(_pContext, CHANGE_RESOURCE, data->m_ProjectID, data->m_ResourceID, 0);
+        break;
+    }
+    case EHPMChangeCallback_ProjectWorkflowSettingsChange:
+    {
+        const HPMChangeCallbackData_ProjectWorkflowSettingsChange *data = (const HPMChangeCallbackData_ProjectWorkflowSettingsChange *)_pData;
+        onChangeCallback(_pContext, CHANGE_WORKFLOW, data->m_ProjectID, data->m_WorkflowID, 0);
+        break;
+    }
+    case EHPMChangeCallback_TaskChangeCustomColumnData:
+    {
+        const HPMChangeCallbackData_TaskChangeCustomColumnData *data = (const HPMChangeCallbackData_TaskChangeCustomColumnData *)_pData;
+        onChangeCallback(_pContext, CHANGE_TASK_COLUMN, -1, data->m_TaskID, (HPMInt32)data->m_ColumnHash);
+        break;
+    }
+    case EHPMChangeCallback_ProjectCustomColumnsChange:
+    {
+        const HPMChangeCallbackData_ProjectCustomColumnsChange *data = (const HPMChangeCallbackData_ProjectCustomColumnsChange *)_pData;
+        onChangeCallback(_pContext, CHANGE_COLUMNS, data->m_ProjectID, 0, 0);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+HPMError session_register_change_callbacks(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    void *_pContext)
+{
+    static const EHPMChangeCallback callbacks[] = {
+        EHPMChangeCallback_TaskChange,
+        EHPMChangeCallback_TaskCreateUnified,
+        EHPMChangeCallback_TaskDelete,
+        EHPMChangeCallback_ResourceProperties,
+        EHPMChangeCallback_ProjectResourceAdd,
+        EHPMChangeCallback_ProjectResourceRemove,
+        EHPMChangeCallback_ProjectWorkflowSettingsChange,
+        EHPMChangeCallback_TaskChangeCustomColumnData,
+        EHPMChangeCallback_ProjectCustomColumnsChange,
+    };
+    HPMChangeCallbackInfo info = {_pContext, change_callback};
+    for (size_t i = 0; i < sizeof(callbacks) / sizeof(callbacks[0]); i++)
+    {
+        HPMError err = funcs->CallbackRegister(_pSession, callbacks[i], &info);
+        if (err != EHPMError_NoError)
+        {
+            return err;
+        }
+    }
+    return EHPMError_NoError;
+}
 
 void *session_open(
     HPMSdkFunctions *funcs,
@@ -332,6 +553,26 @@ HPMError task_set_hyperlink(
     return funcs->TaskSetHyperlink(_pSession, _TaskID, _pData);
 }
 
+HPMError task_get_custom_column_data(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    HPMUniqueID _TaskID,
+    HPMUInt32 _ColumnHash,
+    const HPMString **_pData)
+{
+    return funcs->TaskGetCustomColumnData(_pSession, _TaskID, _ColumnHash, _pData);
+}
+
+HPMError task_set_custom_column_data(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    HPMUniqueID _TaskID,
+    HPMUInt32 _ColumnHash,
+    const HPMChar *_pData)
+{
+    return funcs->TaskSetCustomColumnData(_pSession, _TaskID, _ColumnHash, _pData, 0);
+}
+
 HPMError task_get_backlog_priority(
     HPMSdkFunctions *funcs,
     void *_pSession,
@@ -359,6 +600,15 @@ HPMError task_get_main_reference(
     return funcs->TaskGetMainReference(_pSession, _TaskID, _pMainRefID);
 }
 
+HPMError task_get_proxy(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    HPMUniqueID _TaskID,
+    HPMUniqueID *_pProxyRefID)
+{
+    return funcs->TaskGetProxy(_pSession, _TaskID, _pProxyRefID);
+}
+
 HPMError task_ref_get_task(
     HPMSdkFunctions *funcs,
     void *_pSession,
@@ -412,3 +662,587 @@ HPMError object_free(
 {
     return funcs->ObjectFree(_pSession, _pObject, _pDeleted);
 }
+
+// Indices of the fields held by task_snapshot.
+enum
+{
+    TASK_SNAPSHOT_HYPERLINK,
+    TASK_SNAPSHOT_DESCRIPTION,
+    TASK_SNAPSHOT_RESOURCE,
+    TASK_SNAPSHOT_WORKFLOW_STATUS,
+    TASK_SNAPSHOT_IDEAL_DAYS,
+    TASK_SNAPSHOT_PRIORITY,
+    TASK_SNAPSHOT_MILESTONE,
+    TASK_SNAPSHOT_SPRINT,
+    TASK_SNAPSHOT_FIELD_COUNT,
+};
+
+// task_snapshot holds the field values of a single task, as populated by
+// task_snapshot_batch(). errors[TASK_SNAPSHOT_*] holds the error code for the
+// corresponding field. The strings must be released with task_snapshot_free().
+typedef struct task_snapshot
+{
+    const HPMString *hyperlink;
+    const HPMString *description;
+    HPMUniqueID resource;        // Resource with the largest allocation, or -1
+    HPMUInt32 workflow;          // Workflow ID, or -1 if the task has none
+    HPMInt32 workflow_status;    // Workflow status ID
+    HPMFP64 ideal_days;          // Estimated ideal days
+    HPMInt32 priority;           // Backlog priority
+    HPMUniqueID milestone;       // Task ID of the first milestone, or -1
+    HPMUniqueID sprint;          // Task ID of the linked sprint, or -1
+    HPMError errors[TASK_SNAPSHOT_FIELD_COUNT];
+} task_snapshot;
+
+// task_snapshot_batch() reads the fields of the _nTasks tasks in _pTaskIDs,
+// writing a record for each to _pOut.
+void task_snapshot_batch(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    const HPMUniqueID *_pTaskIDs,
+    HPMUInt32 _nTasks,
+    HPMUniqueID _NoMilestoneID,
+    task_snapshot *_pOut)
+{
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        HPMUniqueID id = _pTaskIDs[i];
+        task_snapshot *out = &_pOut[i];
+        HPMError *errors = out->errors;
+
+        out->hyperlink = NULL;
+        out->description = NULL;
+        out->resource = -1;
+        out->workflow = (HPMUInt32)-1;
+        out->workflow_status = 0;
+        out->ideal_days = 0;
+        out->priority = 0;
+        out->milestone = -1;
+        out->sprint = -1;
+
+        errors[TASK_SNAPSHOT_HYPERLINK] = funcs->TaskGetHyperlink(_pSession, id, &out->hyperlink);
+        errors[TASK_SNAPSHOT_DESCRIPTION] = funcs->TaskGetDescription(_pSession, id, &out->description);
+
+        const HPMTaskResourceAllocation *allocation = NULL;
+        errors[TASK_SNAPSHOT_RESOURCE] = funcs->TaskGetResourceAllocation(_pSession, id, &allocation);
+        if (allocation)
+        {
+            HPMInt32 percent = -1;
+            for (HPMUInt32 j = 0; j < allocation->m_nResources; j++)
+            {
+                if (allocation->m_pResources[j].m_PercentAllocated > percent)
+                {
+                    percent = allocation->m_pResources[j].m_PercentAllocated;
+                    out->resource = allocation->m_pResources[j].m_ResourceID;
+                }
+            }
+            funcs->ObjectFree(_pSession, allocation, NULL);
+        }
+
+        errors[TASK_SNAPSHOT_WORKFLOW_STATUS] = funcs->TaskGetWorkflow(_pSession, id, &out->workflow);
+        if (errors[TASK_SNAPSHOT_WORKFLOW_STATUS] == EHPMError_NoError)
+        {
+            errors[TASK_SNAPSHOT_WORKFLOW_STATUS] = funcs->TaskGetWorkflowStatus(_pSession, id, &out->workflow_status);
+        }
+        errors[TASK_SNAPSHOT_IDEAL_DAYS] = funcs->TaskGetEstimatedIdealDays(_pSession, id, &out->ideal_days);
+        errors[TASK_SNAPSHOT_PRIORITY] = funcs->TaskGetBacklogPriority(_pSession, id, &out->priority);
+
+        const HPMTaskLinkedToMilestones *milestones = NULL;
+        errors[TASK_SNAPSHOT_MILESTONE] = funcs->TaskGetLinkedToMilestones(_pSession, id, &milestones);
+        if (milestones)
+        {
+            if (milestones->m_nMilestones > 0 && milestones->m_pMilestones[0] != _NoMilestoneID)
+            {
+                errors[TASK_SNAPSHOT_MILESTONE] = funcs->TaskRefGetTask(_pSession, milestones->m_pMilestones[0], &out->milestone);
+            }
+            funcs->ObjectFree(_pSession, milestones, NULL);
+        }
+
+        HPMUniqueID sprintRef = -1;
+        errors[TASK_SNAPSHOT_SPRINT] = funcs->TaskGetLinkedToSprint(_pSession, id, &sprintRef);
+        if (errors[TASK_SNAPSHOT_SPRINT] == EHPMError_NoError && sprintRef != -1)
+        {
+            errors[TASK_SNAPSHOT_SPRINT] = funcs->TaskRefGetTask(_pSession, sprintRef, &out->sprint);
+        }
+    }
+}
+
+// task_snapshot_free() releases the SDK objects held by the _nTasks records in
+// _pSnapshots.
+void task_snapshot_free(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    task_snapshot *_pSnapshots,
+    HPMUInt32 _nTasks)
+{
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        if (_pSnapshots[i].hyperlink)
+        {
+            funcs->ObjectFree(_pSession, _pSnapshots[i].hyperlink, NULL);
+        }
+        if (_pSnapshots[i].description)
+        {
+            funcs->ObjectFree(_pSession, _pSnapshots[i].description, NULL);
+        }
+    }
+}
+
+// task_expected holds the expected field values of a single task, as compared
+// by task_compare_batch().
+typedef struct task_expected
+{
+    HPMUniqueID task;
+    const char *hyperlink;
+    const char *description;
+    HPMUniqueID resource;        // Expected resource with the largest allocation, or -1
+    HPMInt64 minutes;            // Expected estimate, in whole minutes
+    HPMInt32 priority;           // Expected backlog priority
+    HPMUniqueID milestone;       // Task ID of the expected first milestone, or -1
+    HPMUniqueID sprint;          // Task ID of the expected linked sprint, or -1
+    HPMUInt32 ignore;            // Mask of (1 << TASK_SNAPSHOT_*) fields not compared
+} task_expected;
+
+// task_compared is the result of comparing a single task by
+// task_compare_batch(). Bit (1 << TASK_SNAPSHOT_*) of mismatch is set for each
+// field that differs from the expected value, or that could not be read. The
+// workflow status is not compared, as the status names are held by Go, so it
+// is returned instead.
+typedef struct task_compared
+{
+    HPMUInt32 mismatch;
+    HPMUInt32 workflow;          // Workflow ID, or -1 if the task has none
+    HPMInt32 workflow_status;    // Workflow status ID
+} task_compared;
+
+// task_compare_batch() compares the fields of the _nTasks tasks in _pExpected
+// against their expected values, writing a record for each to _pOut. Only the
+// mismatch masks cross back into Go, so a batch of tasks that are in sync costs
+// a single cgo call and no string copies. The fields are read as by
+// task_snapshot_batch(), and _HoursInWorkingDay converts ideal days to minutes
+// exactly as the Go code does.
+void task_compare_batch(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    const task_expected *_pExpected,
+    HPMUInt32 _nTasks,
+    HPMUniqueID _NoMilestoneID,
+    HPMFP64 _HoursInWorkingDay,
+    task_compared *_pOut)
+{
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        const task_expected *exp = &_pExpected[i];
+        task_compared *out = &_pOut[i];
+        HPMUniqueID id = exp->task;
+        HPMUInt32 compare = ~exp->ignore;
+        HPMError err;
+
+        out->mismatch = 0;
+        out->workflow = (HPMUInt32)-1;
+        out->workflow_status = 0;
+
+        if (compare & (1u << TASK_SNAPSHOT_HYPERLINK))
+        {
+            const HPMString *hyperlink = NULL;
+            err = funcs->TaskGetHyperlink(_pSession, id, &hyperlink);
+            if (err != EHPMError_NoError || strcmp(hyperlink->m_pString, exp->hyperlink) != 0)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_HYPERLINK;
+            }
+            if (hyperlink)
+            {
+                funcs->ObjectFree(_pSession, hyperlink, NULL);
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_DESCRIPTION))
+        {
+            const HPMString *description = NULL;
+            err = funcs->TaskGetDescription(_pSession, id, &description);
+            if (err != EHPMError_NoError || strcmp(description->m_pString, exp->description) != 0)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_DESCRIPTION;
+            }
+            if (description)
+            {
+                funcs->ObjectFree(_pSession, description, NULL);
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_RESOURCE))
+        {
+            const HPMTaskResourceAllocation *allocation = NULL;
+            HPMUniqueID resource = -1;
+            err = funcs->TaskGetResourceAllocation(_pSession, id, &allocation);
+            if (allocation)
+            {
+                HPMInt32 percent = -1;
+                for (HPMUInt32 j = 0; j < allocation->m_nResources; j++)
+                {
+                    if (allocation->m_pResources[j].m_PercentAllocated > percent)
+                    {
+                        percent = allocation->m_pResources[j].m_PercentAllocated;
+                        resource = allocation->m_pResources[j].m_ResourceID;
+                    }
+                }
+                funcs->ObjectFree(_pSession, allocation, NULL);
+            }
+            if (err != EHPMError_NoError || resource != exp->resource)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_RESOURCE;
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_WORKFLOW_STATUS))
+        {
+            // Errors reading the workflow status are ignored, matching task.Status()
+            err = funcs->TaskGetWorkflow(_pSession, id, &out->workflow);
+            if (err == EHPMError_NoError)
+            {
+                err = funcs->TaskGetWorkflowStatus(_pSession, id, &out->workflow_status);
+            }
+            if (err != EHPMError_NoError)
+            {
+                // Compared as a task without a workflow, and without a
+                // status. Status IDs are never negative.
+                out->workflow = (HPMUInt32)-1;
+                out->workflow_status = -1;
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_IDEAL_DAYS))
+        {
+            HPMFP64 days = 0;
+            err = funcs->TaskGetEstimatedIdealDays(_pSession, id, &days);
+            // Truncated to nanoseconds, then to minutes, as by idealDaysToDuration()
+            HPMInt64 nanoseconds = (HPMInt64)(days * _HoursInWorkingDay * 3600000000000.0);
+            if (err != EHPMError_NoError || nanoseconds / 60000000000LL != exp->minutes)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_IDEAL_DAYS;
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_PRIORITY))
+        {
+            HPMInt32 priority = 0;
+            err = funcs->TaskGetBacklogPriority(_pSession, id, &priority);
+            if (err != EHPMError_NoError || priority != exp->priority)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_PRIORITY;
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_MILESTONE))
+        {
+            const HPMTaskLinkedToMilestones *milestones = NULL;
+            HPMUniqueID milestone = -1;
+            err = funcs->TaskGetLinkedToMilestones(_pSession, id, &milestones);
+            if (milestones)
+            {
+                if (milestones->m_nMilestones > 0 && milestones->m_pMilestones[0] != _NoMilestoneID)
+                {
+                    err = funcs->TaskRefGetTask(_pSession, milestones->m_pMilestones[0], &milestone);
+                }
+                funcs->ObjectFree(_pSession, milestones, NULL);
+            }
+            if (err != EHPMError_NoError || milestone != exp->milestone)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_MILESTONE;
+            }
+        }
+
+        if (compare & (1u << TASK_SNAPSHOT_SPRINT))
+        {
+            HPMUniqueID sprintRef = -1;
+            HPMUniqueID sprint = -1;
+            err = funcs->TaskGetLinkedToSprint(_pSession, id, &sprintRef);
+            if (err == EHPMError_NoError && sprintRef != -1)
+            {
+                err = funcs->TaskRefGetTask(_pSession, sprintRef, &sprint);
+            }
+            if (err != EHPMError_NoError || sprint != exp->sprint)
+            {
+                out->mismatch |= 1u << TASK_SNAPSHOT_SPRINT;
+            }
+        }
+    }
+}
+
+// task_custom_columns_batch() reads the _nColumns custom columns with the
+// hashes in _pHashes for each of the _nTasks tasks in _pTaskIDs. The value of
+// column c of task t is written to _pOut[t * _nColumns + c], and its error
+// code to _pErrors[t * _nColumns + c]. The strings must be released with
+// task_custom_columns_free().
+void task_custom_columns_batch(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    const HPMUniqueID *_pTaskIDs,
+    HPMUInt32 _nTasks,
+    const HPMUInt32 *_pHashes,
+    HPMUInt32 _nColumns,
+    const HPMString **_pOut,
+    HPMError *_pErrors)
+{
+    for (HPMUInt32 t = 0; t < _nTasks; t++)
+    {
+        for (HPMUInt32 c = 0; c < _nColumns; c++)
+        {
+            HPMUInt32 i = t * _nColumns + c;
+            _pOut[i] = NULL;
+            _pErrors[i] = funcs->TaskGetCustomColumnData(_pSession, _pTaskIDs[t], _pHashes[c], &_pOut[i]);
+        }
+    }
+}
+
+// task_custom_columns_free() releases the _n strings in _pValues.
+void task_custom_columns_free(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    const HPMString **_pValues,
+    HPMUInt32 _n)
+{
+    for (HPMUInt32 i = 0; i < _n; i++)
+    {
+        if (_pValues[i])
+        {
+            funcs->ObjectFree(_pSession, _pValues[i], NULL);
+        }
+    }
+}
+
+// linked_task is a single backlog task found by backlog_find_linked_tasks().
+typedef struct linked_task
+{
+    HPMInt32 bug_id;
+    HPMUniqueID task_id;
+    HPMUniqueID ref;
+} linked_task;
+
+// parse_bug_id() parses _pDigits as a positive decimal bug ID that fits in an
+// HPMInt32, with nothing before or after the digits. Returns 0 on failure.
+HPMInt32 parse_bug_id(const HPMChar *_pDigits)
+{
+    if (*_pDigits < '0' || *_pDigits > '9')
+    {
+        return 0; // strtol() would accept leading whitespace and signs
+    }
+    char *end = NULL;
+    errno = 0;
+    long bug = strtol(_pDigits, &end, 10);
+    if (errno != 0 || *end != '\0' || bug <= 0 || bug > INT32_MAX)
+    {
+        return 0;
+    }
+    return (HPMInt32)bug;
+}
+
+// find_linked_tasks() reads the hyperlinks of the _nRefs task refs in _pRefs,
+// writing the tasks with a hyperlink of the form <_pPrefix><number> to _pOut,
+// which must have space for _nRefs records. *_pnOut is set to the number of
+// records written. *_pnMalformed is set to the number of tasks that had the
+// prefix, but no parsable number, and *_pnUnreadable to the number of tasks
+// whose hyperlink could not be read.
+HPMError find_linked_tasks(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    const HPMUniqueID *_pRefs,
+    HPMUInt32 _nRefs,
+    const HPMChar *_pPrefix,
+    linked_task *_pOut,
+    HPMUInt32 *_pnOut,
+    HPMUInt32 *_pnMalformed,
+    HPMUInt32 *_pnUnreadable)
+{
+    *_pnOut = 0;
+    *_pnMalformed = 0;
+    *_pnUnreadable = 0;
+
+    HPMUInt32 n = 0;
+    size_t prefixLen = strlen(_pPrefix);
+
+    for (HPMUInt32 i = 0; i < _nRefs; i++)
+    {
+        HPMUniqueID ref = _pRefs[i];
+        HPMUniqueID id = 0;
+        HPMError err = funcs->TaskRefGetTask(_pSession, ref, &id);
+        if (err != EHPMError_NoError)
+        {
+            return err;
+        }
+
+        const HPMString *link = NULL;
+        if (funcs->TaskGetHyperlink(_pSession, id, &link) != EHPMError_NoError)
+        {
+            (*_pnUnreadable)++;
+            continue;
+        }
+        const HPMChar *str = link->m_pString;
+        if (strncmp(str, _pPrefix, prefixLen) == 0)
+        {
+            HPMInt32 bug = parse_bug_id(str + prefixLen);
+            if (bug != 0)
+            {
+                _pOut[n].bug_id = bug;
+                _pOut[n].task_id = id;
+                _pOut[n].ref = ref;
+                n++;
+            }
+            else
+            {
+                (*_pnMalformed)++;
+            }
+        }
+        funcs->ObjectFree(_pSession, link, NULL);
+    }
+
+    *_pnOut = n;
+    return EHPMError_NoError;
+}
+
+// backlog_find_linked_tasks() enumerates the task refs of _ContainerID,
+// returning only those tasks with a hyperlink of the form <_pPrefix><number>.
+// *_pOut is allocated from _pArena, and is valid until the arena is reset.
+// *_pnMalformed and *_pnUnreadable are set as by find_linked_tasks().
+HPMError backlog_find_linked_tasks(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    arena *_pArena,
+    HPMUniqueID _ContainerID,
+    const HPMChar *_pPrefix,
+    linked_task **_pOut,
+    HPMUInt32 *_pnOut,
+    HPMUInt32 *_pnMalformed,
+    HPMUInt32 *_pnUnreadable)
+{
+    *_pOut = NULL;
+    *_pnOut = 0;
+    *_pnMalformed = 0;
+    *_pnUnreadable = 0;
+
+    const HPMTaskEnum *refs = NULL;
+    HPMError err = funcs->TaskRefEnum(_pSession, _ContainerID, &refs);
+    if (err != EHPMError_NoError)
+    {
+        return err;
+    }
+
+    linked_task *out = (linked_task *)arena_alloc(_pArena, sizeof(linked_task) * (refs->m_nTasks ? refs->m_nTasks : 1));
+    if (!out)
+    {
+        funcs->ObjectFree(_pSession, refs, NULL);
+        return EHPMError_OtherError;
+    }
+    err = find_linked_tasks(funcs, _pSession, refs->m_pTasks, refs->m_nTasks, _pPrefix, out, _pnOut, _pnMalformed, _pnUnreadable);
+    funcs->ObjectFree(_pSession, refs, NULL);
+    if (err != EHPMError_NoError)
+    {
+        *_pnOut = 0;
+        return err;
+    }
+    *_pOut = out;
+    return EHPMError_NoError;
+}
+
+// task_create_planned_batch() creates _nTasks planned tasks in _ContainerID
+// with a single call to TaskCreateUnified(), writing the ref and task ID of
+// each new task to _pRefs and _pIDs. *_pnCreated is set to the number of tasks
+// written, which are always returned, even if an error is returned because
+// some of the tasks could not be created or resolved. The TaskCreateUnified()
+// entries are allocated from _pArena.
+HPMError task_create_planned_batch(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    arena *_pArena,
+    HPMUniqueID _ContainerID,
+    HPMUInt32 _nTasks,
+    HPMUniqueID *_pRefs,
+    HPMUniqueID *_pIDs,
+    HPMUInt32 *_pnCreated)
+{
+    *_pnCreated = 0;
+
+    HPMTaskCreateUnifiedEntry *entries = (HPMTaskCreateUnifiedEntry *)arena_alloc(_pArena, (_nTasks ? _nTasks : 1) * sizeof(HPMTaskCreateUnifiedEntry));
+    if (!entries)
+    {
+        return EHPMError_OtherError;
+    }
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        entries[i].m_LocalID = (HPMInt32)i;
+        entries[i].m_TaskType = EHPMTaskType_Planned;
+    }
+
+    HPMTaskCreateUnified data = {0};
+    data.m_nTasks = _nTasks;
+    data.m_pTasks = entries;
+    data.m_OptionFlags = EHPMTaskCreateOptionFlag_UpdateCustomDateColumns | EHPMTaskCreateOptionFlag_SetDefaultValues;
+
+    const HPMChangeCallbackData_TaskCreateUnified *result = NULL;
+    HPMError err = task_create_unified(funcs, _pSession, _ContainerID, &data, &result);
+    if (err != EHPMError_NoError)
+    {
+        return err;
+    }
+
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        _pRefs[i] = -1;
+    }
+    for (HPMUInt32 i = 0; i < result->m_nTasks; i++)
+    {
+        HPMInt32 local = result->m_pTasks[i].m_LocalID;
+        if (local >= 0 && (HPMUInt32)local < _nTasks)
+        {
+            _pRefs[local] = result->m_pTasks[i].m_TaskRefID;
+        }
+    }
+    funcs->ObjectFree(_pSession, result, NULL);
+
+    // Compact the created tasks to the front, keeping the first error
+    HPMUInt32 n = 0;
+    for (HPMUInt32 i = 0; i < _nTasks; i++)
+    {
+        if (_pRefs[i] == -1)
+        {
+            if (err == EHPMError_NoError)
+            {
+                err = EHPMError_OtherError;
+            }
+            continue;
+        }
+        HPMUniqueID id = -1;
+        HPMError idErr = funcs->TaskRefGetTask(_pSession, _pRefs[i], &id);
+        if (idErr != EHPMError_NoError)
+        {
+            if (err == EHPMError_NoError)
+            {
+                err = idErr;
+            }
+            continue;
+        }
+        _pRefs[n] = _pRefs[i];
+        _pIDs[n] = id;
+        n++;
+    }
+    *_pnCreated = n;
+    return err;
+}
+
+HPMError task_ref_util_enum_children(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    HPMUniqueID _TaskRefID,
+    HPMInt32 _bRecursive,
+    const HPMTaskEnum **_pEnum)
+{
+    return funcs->TaskRefUtilEnumChildren(_pSession, _TaskRefID, _bRecursive, _pEnum);
+}
+
+HPMError task_ref_delete(
+    HPMSdkFunctions *funcs,
+    void *_pSession,
+    HPMUniqueID _TaskRefID)
+{
+    return funcs->TaskRefDelete(_pSession, _TaskRefID);
+}
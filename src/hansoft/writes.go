@@ -0,0 +1,239 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package hansoft
+
+import (
+	"fmt"
+	"sync"
+	"time"
+)
+
+// flushTimeout is the maximum time Flush() waits for the server to confirm the
+// pending writes
+const flushTimeout = time.Minute
+
+// flushGrace is the time Flush() waits for the server to confirm the pending
+// writes before reading the fields of those still unconfirmed. The server does
+// not confirm a write that leaves the field unchanged, and the caller's view of
+// the field may have been stale.
+const flushGrace = 5 * time.Second
+
+// pendingWriteExpiry is the time after which a write that has not been
+// confirmed by a TaskChange callback is no longer tracked, so that a lost
+// callback does not hide a later change made by another client.
+const pendingWriteExpiry = flushTimeout
+
+// pendingWrite identifies a task field write that has been issued to a
+// non-blocking session, but not yet confirmed by a TaskChange callback
+type pendingWrite struct {
+	task   uniqueID
+	field  changeField
+	column uint32 // Hash of the column, if field is changeFieldCustomColumn
+}
+
+// pendingCount is the number of unconfirmed writes to a single field
+type pendingCount struct {
+	n       int
+	issued  time.Time   // Time of the latest write
+	applied func() bool // Returns true if the field holds the latest written value
+}
+
+// pendingWrites tracks the writes issued to a non-blocking session, per project.
+type pendingWrites struct {
+	mutex  sync.Mutex
+	writes map[pendingWrite]pendingCount
+	count  int           // Total number of unconfirmed writes
+	idle   chan struct{} // Closed when count drops to 0
+	swept  time.Time     // Time of the last expire()
+}
+
+func (p *pendingWrites) add(w pendingWrite, applied func() bool) {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	now := time.Now()
+	p.expire(now)
+	if p.writes == nil {
+		p.writes = map[pendingWrite]pendingCount{}
+	}
+	if p.count == 0 {
+		p.idle = make(chan struct{})
+	}
+	c := p.writes[w]
+	p.writes[w] = pendingCount{c.n + 1, now, applied}
+	p.count++
+}
+
+// confirm marks a single write to the task field as complete, if one is
+// pending. Returns true if a write was pending.
+func (p *pendingWrites) confirm(w pendingWrite) bool {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	p.expire(time.Now())
+	c, ok := p.writes[w]
+	if !ok {
+		return false
+	}
+	if c.n == 1 {
+		delete(p.writes, w)
+	} else {
+		p.writes[w] = pendingCount{c.n - 1, c.issued, c.applied}
+	}
+	p.release(1)
+	return true
+}
+
+// expire drops the writes last issued more than pendingWriteExpiry before now.
+// The writes are swept at most once per pendingWriteExpiry.
+// Must be called with the mutex held.
+func (p *pendingWrites) expire(now time.Time) {
+	if p.count == 0 || now.Sub(p.swept) < pendingWriteExpiry {
+		return
+	}
+	p.swept = now
+	for w, c := range p.writes {
+		if now.Sub(c.issued) >= pendingWriteExpiry {
+			delete(p.writes, w)
+			p.release(c.n)
+		}
+	}
+}
+
+// release removes n writes from the count, signalling idle when it drops to 0.
+// Must be called with the mutex held.
+func (p *pendingWrites) release(n int) {
+	p.count -= n
+	if p.count == 0 {
+		close(p.idle)
+	}
+}
+
+// wait blocks until all the pending writes are confirmed, or timeout elapses.
+// Writes still unconfirmed after flushGrace are dropped if their field already
+// holds the written value. On timeout, the unconfirmed writes are dropped and
+// an error is returned.
+func (p *pendingWrites) wait(timeout time.Duration) error {
+	deadline := time.Now().Add(timeout)
+	p.mutex.Lock()
+	if p.count == 0 {
+		p.mutex.Unlock()
+		return nil
+	}
+	idle := p.idle
+	p.mutex.Unlock()
+
+	grace := flushGrace
+	if grace > timeout {
+		grace = timeout
+	}
+	select {
+	case <-idle:
+		return nil
+	case <-time.After(grace):
+	}
+	p.dropApplied()
+	select {
+	case <-idle:
+		return nil
+	case <-time.After(time.Until(deadline)):
+	}
+
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	if p.count == 0 {
+		return nil
+	}
+	count := p.count
+	p.writes = nil
+	p.count = 0
+	close(p.idle)
+	return fmt.Errorf("%v hansoft writes were not confirmed after %v", count, timeout)
+}
+
+// dropApplied reads the fields of the pending writes, and drops the writes
+// whose field holds the written value. The fields are read without the mutex
+// held, so that the change callbacks are not blocked.
+func (p *pendingWrites) dropApplied() {
+	p.mutex.Lock()
+	pending := make(map[pendingWrite]pendingCount, len(p.writes))
+	for w, c := range p.writes {
+		pending[w] = c
+	}
+	p.mutex.Unlock()
+
+	for w, c := range pending {
+		if !c.applied() {
+			delete(pending, w)
+		}
+	}
+
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	for w, c := range pending {
+		// Skip the writes confirmed, or written again, since they were read
+		if current, ok := p.writes[w]; ok && current.issued.Equal(c.issued) {
+			delete(p.writes, w)
+			p.release(current.n)
+		}
+	}
+}
+
+// write performs the write of the task field with f. The writes of a
+// non-blocking session are tracked until the server echoes them back with a
+// TaskChange callback, so that the callback is not reported as a change made
+// by another client, and so that Flush() can wait on them. applied is only
+// called by Flush(), for writes that are slow to be confirmed.
+func (t *task) write(field changeField, applied func() bool, f func() error) error {
+	return t.writeTracked(pendingWrite{t.id, field, 0}, applied, f)
+}
+
+// writeColumn is write() for the custom column with the given hash
+func (t *task) writeColumn(hash uint32, applied func() bool, f func() error) error {
+	return t.writeTracked(pendingWrite{t.id, changeFieldCustomColumn, hash}, applied, f)
+}
+
+func (t *task) writeTracked(w pendingWrite, applied func() bool, f func() error) error {
+	if t.project.session.blocking {
+		return f()
+	}
+	writes := &t.project.pending
+	writes.add(w, applied)
+	if err := f(); err != nil {
+		writes.confirm(w)
+		return err
+	}
+	return nil
+}
+
+func (s *session) Flush() error {
+	s.projectsMutex.RLock()
+	projects := make([]*project, 0, len(s.projects))
+	for _, p := range s.projects {
+		projects = append(projects, p)
+	}
+	s.projectsMutex.RUnlock()
+
+	deadline := time.Now().Add(flushTimeout)
+	var firstErr error
+	for _, p := range projects {
+		if err := p.pending.wait(time.Until(deadline)); err != nil && firstErr == nil {
+			firstErr = err
+		}
+	}
+	return firstErr
+}
+
+func (p *project) Flush() error {
+	return p.pending.wait(flushTimeout)
+}
@@ -0,0 +1,343 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"context"
+	"math/rand"
+	"sync"
+	"time"
+
+	monorailv3 "chromium.googlesource.com/infra/infra.git/go/src/infra/monorailv2/api/v3/api_proto"
+
+	"google.golang.org/grpc"
+	"google.golang.org/grpc/codes"
+	"google.golang.org/grpc/status"
+)
+
+const (
+	// Delay before the first retry of a failed request. Each retry doubles
+	// the delay, up to retryMaxDelay, and sleeps for a random fraction of it.
+	retryBaseDelay = 250 * time.Millisecond
+	retryMaxDelay  = 16 * time.Second
+)
+
+// Limits controls the rate and concurrency of the monorail API requests
+type Limits struct {
+	// Rate is the maximum number of requests started per second, with bursts
+	// of up to Burst requests. A Rate of 0 disables the rate limit.
+	Rate  float64
+	Burst int
+	// MaxConcurrency is the maximum number of requests in flight. The limit
+	// starts at MaxConcurrency, is halved whenever a request fails with a
+	// quota or deadline error, and grows back by one for each limit's worth
+	// of successful requests.
+	MaxConcurrency int
+	// Retries is the maximum number of times a failed idempotent request is
+	// retried. Only unavailable, quota and deadline errors are retried.
+	Retries int
+}
+
+// DefaultLimits are the Limits used by New()
+var DefaultLimits = Limits{Rate: 20, Burst: 10, MaxConcurrency: 8, Retries: 4}
+
+// RPCStats holds the statistics of one of the monorail API methods, as
+// returned by Monorail.RPCStats()
+type RPCStats struct {
+	Method string
+	// Number of requests made, including retries, and the number that failed
+	Calls, Errors int64
+	// Number of failed requests that were retried
+	Retries int64
+	// Total and maximum time spent in requests, excluding the time spent
+	// waiting for the rate and concurrency limits
+	TotalLatency, MaxLatency time.Duration
+	// Total time spent waiting for the rate and concurrency limits
+	WaitTime time.Duration
+}
+
+// MeanLatency returns the mean latency of a request
+func (s RPCStats) MeanLatency() time.Duration {
+	if s.Calls == 0 {
+		return 0
+	}
+	return s.TotalLatency / time.Duration(s.Calls)
+}
+
+// rpcMethod is a monorail API method called through an rpcLimiter
+type rpcMethod int
+
+const (
+	rpcSearchIssues rpcMethod = iota
+	rpcModifyIssues
+	rpcBatchGetUsers
+	rpcGatherProjectEnvironment
+	rpcMethodCount
+)
+
+var rpcMethodNames = [rpcMethodCount]string{
+	rpcSearchIssues:             "SearchIssues",
+	rpcModifyIssues:             "ModifyIssues",
+	rpcBatchGetUsers:            "BatchGetUsers",
+	rpcGatherProjectEnvironment: "GatherProjectEnvironment",
+}
+
+// rpcLimiter applies the Limits to the monorail API requests, and records
+// their RPCStats. A single rpcLimiter is shared by all the clients of a
+// Monorail, as the quota is per caller.
+type rpcLimiter struct {
+	limits Limits
+
+	mutex    sync.Mutex
+	changed  chan struct{} // Closed and replaced when inFlight or limit change
+	tokens   float64       // Rate limit tokens available at refilled
+	refilled time.Time
+	limit    float64 // Current concurrency limit
+	inFlight int
+	stats    [rpcMethodCount]RPCStats
+}
+
+func newRPCLimiter(limits Limits) *rpcLimiter {
+	if limits.MaxConcurrency < 1 {
+		limits.MaxConcurrency = 1
+	}
+	if limits.Burst < 1 {
+		limits.Burst = 1
+	}
+	return &rpcLimiter{
+		limits:   limits,
+		changed:  make(chan struct{}),
+		tokens:   float64(limits.Burst),
+		refilled: time.Now(),
+		limit:    float64(limits.MaxConcurrency),
+	}
+}
+
+// do calls f, retrying it if idempotent and the error is transient
+func (l *rpcLimiter) do(ctx context.Context, m rpcMethod, idempotent bool, f func() error) error {
+	for attempt := 0; ; attempt++ {
+		err := l.call(ctx, m, f)
+		retry := idempotent && attempt < l.limits.Retries && transient(err) && ctx.Err() == nil
+		if !retry {
+			return err
+		}
+		l.mutex.Lock()
+		l.stats[m].Retries++
+		l.mutex.Unlock()
+
+		delay := retryBaseDelay << attempt
+		if delay > retryMaxDelay || delay <= 0 {
+			delay = retryMaxDelay
+		}
+		timer := time.NewTimer(time.Duration(rand.Int63n(int64(delay))))
+		select {
+		case <-timer.C:
+		case <-ctx.Done():
+			timer.Stop()
+			return err
+		}
+	}
+}
+
+// call waits for the rate and concurrency limits, and makes a single request
+// with f
+func (l *rpcLimiter) call(ctx context.Context, m rpcMethod, f func() error) error {
+	waitStart := time.Now()
+	if err := l.acquire(ctx); err != nil {
+		return err
+	}
+	start := time.Now()
+	err := f()
+	latency := time.Since(start)
+
+	l.mutex.Lock()
+	defer l.mutex.Unlock()
+	l.inFlight--
+	switch {
+	case overloaded(err):
+		l.limit /= 2
+		if l.limit < 1 {
+			l.limit = 1
+		}
+	case err == nil:
+		if l.limit += 1 / l.limit; l.limit > float64(l.limits.MaxConcurrency) {
+			l.limit = float64(l.limits.MaxConcurrency)
+		}
+	}
+	l.signal()
+
+	s := &l.stats[m]
+	s.Calls++
+	if err != nil {
+		s.Errors++
+	}
+	s.TotalLatency += latency
+	if latency > s.MaxLatency {
+		s.MaxLatency = latency
+	}
+	s.WaitTime += start.Sub(waitStart)
+	return err
+}
+
+// acquire blocks until a request can be started without exceeding the limits,
+// and counts the request as in flight. The rate limit token is taken first, so
+// that a request waiting for its token does not hold a concurrency slot.
+func (l *rpcLimiter) acquire(ctx context.Context) error {
+	if err := l.takeToken(ctx); err != nil {
+		return err
+	}
+	l.mutex.Lock()
+	for float64(l.inFlight) >= l.limit {
+		changed := l.changed
+		l.mutex.Unlock()
+		select {
+		case <-changed:
+		case <-ctx.Done():
+			return ctx.Err()
+		}
+		l.mutex.Lock()
+	}
+	l.inFlight++
+	l.mutex.Unlock()
+	return nil
+}
+
+// takeToken takes a rate limit token, sleeping until it has been refilled
+func (l *rpcLimiter) takeToken(ctx context.Context) error {
+	if l.limits.Rate <= 0 {
+		return nil
+	}
+	l.mutex.Lock()
+	now := time.Now()
+	l.tokens += now.Sub(l.refilled).Seconds() * l.limits.Rate
+	if l.tokens > float64(l.limits.Burst) {
+		l.tokens = float64(l.limits.Burst)
+	}
+	l.refilled = now
+	l.tokens--
+	wait := time.Duration(-l.tokens / l.limits.Rate * float64(time.Second))
+	l.mutex.Unlock()
+	if wait <= 0 {
+		return nil
+	}
+	timer := time.NewTimer(wait)
+	defer timer.Stop()
+	select {
+	case <-timer.C:
+		return nil
+	case <-ctx.Done():
+		l.mutex.Lock()
+		l.tokens++
+		l.mutex.Unlock()
+		return ctx.Err()
+	}
+}
+
+// signal wakes the requests waiting in acquire() for a concurrency slot.
+// Must be called with the mutex held.
+func (l *rpcLimiter) signal() {
+	close(l.changed)
+	l.changed = make(chan struct{})
+}
+
+func (l *rpcLimiter) rpcStats() []RPCStats {
+	l.mutex.Lock()
+	defer l.mutex.Unlock()
+	out := []RPCStats{}
+	for m, s := range l.stats {
+		if s.Calls > 0 {
+			s.Method = rpcMethodNames[m]
+			out = append(out, s)
+		}
+	}
+	return out
+}
+
+// transient returns true if the request that failed with err may succeed if
+// retried
+func transient(err error) bool {
+	switch status.Code(err) {
+	case codes.Unavailable, codes.ResourceExhausted, codes.DeadlineExceeded, codes.Aborted:
+		return true
+	}
+	return false
+}
+
+// overloaded returns true if err indicates that requests are being made
+// faster than the server or quota allows
+func overloaded(err error) bool {
+	switch status.Code(err) {
+	case codes.ResourceExhausted, codes.DeadlineExceeded:
+		return true
+	}
+	return false
+}
+
+// issuesClient is a monorailv3.IssuesClient that makes the methods used by
+// this package through an rpcLimiter. The other methods are not limited.
+type issuesClient struct {
+	monorailv3.IssuesClient
+	l *rpcLimiter
+}
+
+func (c issuesClient) SearchIssues(ctx context.Context, in *monorailv3.SearchIssuesRequest, opts ...grpc.CallOption) (out *monorailv3.SearchIssuesResponse, err error) {
+	err = c.l.do(ctx, rpcSearchIssues, true, func() (err error) {
+		out, err = c.IssuesClient.SearchIssues(ctx, in, opts...)
+		return err
+	})
+	return out, err
+}
+
+// ModifyIssues is not retried, as a request that timed out may have been
+// applied, and would add a second comment.
+func (c issuesClient) ModifyIssues(ctx context.Context, in *monorailv3.ModifyIssuesRequest, opts ...grpc.CallOption) (out *monorailv3.ModifyIssuesResponse, err error) {
+	err = c.l.do(ctx, rpcModifyIssues, false, func() (err error) {
+		out, err = c.IssuesClient.ModifyIssues(ctx, in, opts...)
+		return err
+	})
+	return out, err
+}
+
+// usersClient is a monorailv3.UsersClient that makes BatchGetUsers() through
+// an rpcLimiter
+type usersClient struct {
+	monorailv3.UsersClient
+	l *rpcLimiter
+}
+
+func (c usersClient) BatchGetUsers(ctx context.Context, in *monorailv3.BatchGetUsersRequest, opts ...grpc.CallOption) (out *monorailv3.BatchGetUsersResponse, err error) {
+	err = c.l.do(ctx, rpcBatchGetUsers, true, func() (err error) {
+		out, err = c.UsersClient.BatchGetUsers(ctx, in, opts...)
+		return err
+	})
+	return out, err
+}
+
+// frontendClient is a monorailv3.FrontendClient that makes
+// GatherProjectEnvironment() through an rpcLimiter
+type frontendClient struct {
+	monorailv3.FrontendClient
+	l *rpcLimiter
+}
+
+func (c frontendClient) GatherProjectEnvironment(ctx context.Context, in *monorailv3.GatherProjectEnvironmentRequest, opts ...grpc.CallOption) (out *monorailv3.GatherProjectEnvironmentResponse, err error) {
+	err = c.l.do(ctx, rpcGatherProjectEnvironment, true, func() (err error) {
+		out, err = c.FrontendClient.GatherProjectEnvironment(ctx, in, opts...)
+		return err
+	})
+	return out, err
+}
+
+func (m *mr) RPCStats() []RPCStats { return m.rpc.rpcStats() }
@@ -0,0 +1,89 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"log"
+	"os"
+	"time"
+)
+
+// The version of the field cache file format.
+// Bump this whenever the format changes, to invalidate old caches.
+const fieldCacheVersion = 1
+
+type fieldCache struct {
+	Version    int
+	Project    string
+	Fetched    time.Time
+	FieldNames map[string]string // Field name to display name
+}
+
+func (m *mr) ProjectCached(name string, mapping Mapping, cachePath string, ttl time.Duration) (Project, error) {
+	monorailName := "projects/" + name
+
+	cache, err := loadFieldCache(cachePath)
+	if err != nil {
+		log.Printf("Ignoring monorail field cache: %v\n", err)
+	}
+	if cache != nil && cache.Version == fieldCacheVersion && cache.Project == name && time.Since(cache.Fetched) < ttl {
+		return m.newProject(name, cache.FieldNames, mapping)
+	}
+
+	fetched := time.Now()
+	fieldNames, err := m.fieldNames(monorailName)
+	if err != nil {
+		return nil, err
+	}
+	saveFieldCache(cachePath, &fieldCache{
+		Version:    fieldCacheVersion,
+		Project:    name,
+		Fetched:    fetched,
+		FieldNames: fieldNames,
+	})
+	return m.newProject(name, fieldNames, mapping)
+}
+
+func loadFieldCache(path string) (*fieldCache, error) {
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return nil, nil
+		}
+		return nil, err
+	}
+	cache := &fieldCache{}
+	if err := json.NewDecoder(bytes.NewReader(body)).Decode(cache); err != nil {
+		return nil, fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	return cache, nil
+}
+
+func saveFieldCache(path string, cache *fieldCache) {
+	body, err := json.Marshal(cache)
+	if err == nil {
+		tmp := path + ".tmp"
+		if err = ioutil.WriteFile(tmp, body, 0666); err == nil {
+			err = os.Rename(tmp, path)
+		}
+	}
+	if err != nil {
+		log.Printf("Failed to write monorail field cache '%v': %v\n", path, err)
+	}
+}
@@ -0,0 +1,235 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"log"
+	"os"
+	"sort"
+	"time"
+)
+
+// The version of the incremental cache file format.
+// Bump this whenever the format changes, to invalidate old caches.
+const incrementalCacheVersion = 3
+
+// Incremental is a Project that only fetches the issues that have been
+// modified since the last successful call to Issues(), merging these with a
+// cached full set of issues. The cache is persisted to disk, so it is reused
+// across runs. A full scan is performed when there is no usable cache, when
+// the last full scan is older than the full scan interval, or after a call to
+// ForceFullScan(). Deleted issues, and issues that no longer match the search,
+// are not reported by an incremental fetch, so they are only dropped from the
+// cache by the next full scan.
+type Incremental struct {
+	Project
+	cachePath        string
+	fullScanInterval time.Duration
+	cache            *incrementalCache
+	forceFullScan    bool
+}
+
+type incrementalCache struct {
+	Version      int
+	Project      string
+	Columns      []string  // Names of the mapped columns of each issue
+	Watermark    time.Time // Start time of the last successful fetch
+	LastFullScan time.Time // Start time of the last successful full scan
+	Issues       []cachedIssue
+}
+
+type cachedIssue struct {
+	ID                int
+	Summary           string
+	Assignee          string
+	Status            Status
+	EstimatedDuration time.Duration
+	Priority          Priority
+	Milestone         string
+	Sprint            string
+	Columns           []string
+	ModifyTime        time.Time
+}
+
+// NewIncremental returns an Incremental wrapping the project p, persisting
+// its cache to the file at cachePath. A full scan is performed at least every
+// fullScanInterval.
+func NewIncremental(p Project, cachePath string, fullScanInterval time.Duration) *Incremental {
+	return &Incremental{
+		Project:          p,
+		cachePath:        cachePath,
+		fullScanInterval: fullScanInterval,
+	}
+}
+
+// ForceFullScan makes the next call to Issues() perform a full scan of the
+// project.
+func (i *Incremental) ForceFullScan() { i.forceFullScan = true }
+
+// Issues returns all the issues of the project
+func (i *Incremental) Issues() ([]Issue, error) {
+	return collectIssues(i.IssuesStream)
+}
+
+// IssuesStream sends all the issues of the project to out, closing out once
+// all the issues have been sent, or an error occurs.
+func (i *Incremental) IssuesStream(out chan<- Issue) error {
+	if i.cache == nil {
+		cache, err := i.loadCache()
+		if err != nil {
+			log.Printf("Ignoring monorail issue cache: %v\n", err)
+		}
+		i.cache = cache
+	}
+
+	start := time.Now()
+	if i.cache == nil || i.forceFullScan || start.Sub(i.cache.LastFullScan) > i.fullScanInterval {
+		return i.fullScan(start, out)
+	}
+
+	defer close(out)
+
+	modified, err := i.Project.IssuesModifiedSince(i.cache.Watermark)
+	if err != nil {
+		return err
+	}
+	byID := make(map[int]cachedIssue, len(i.cache.Issues)+len(modified))
+	for _, issue := range i.cache.Issues {
+		byID[issue.ID] = issue
+	}
+	for _, issue := range modified {
+		byID[issue.ID()] = toCachedIssue(issue)
+	}
+	merged := make([]cachedIssue, 0, len(byID))
+	for _, issue := range byID {
+		merged = append(merged, issue)
+	}
+	sort.Slice(merged, func(a, b int) bool { return merged[a].ID < merged[b].ID })
+
+	i.cache.Issues = merged
+	i.cache.Watermark = start
+	i.saveCache()
+
+	for _, c := range merged {
+		out <- c.issue()
+	}
+	return nil
+}
+
+// fullScan streams all the issues of the wrapped project to out, replacing
+// the cache with the streamed issues.
+func (i *Incremental) fullScan(start time.Time, out chan<- Issue) error {
+	defer close(out)
+
+	in := make(chan Issue, issuesStreamBuffer)
+	errc := make(chan error, 1)
+	go func() { errc <- i.Project.IssuesStream(in) }()
+
+	cache := &incrementalCache{
+		Version:      incrementalCacheVersion,
+		Project:      i.Name(),
+		Columns:      i.Columns(),
+		Watermark:    start,
+		LastFullScan: start,
+	}
+	for issue := range in {
+		cache.Issues = append(cache.Issues, toCachedIssue(issue))
+		out <- issue
+	}
+	if err := <-errc; err != nil {
+		return err
+	}
+	i.cache = cache
+	i.forceFullScan = false
+	i.saveCache()
+	return nil
+}
+
+func (i *Incremental) loadCache() (*incrementalCache, error) {
+	body, err := ioutil.ReadFile(i.cachePath)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return nil, nil
+		}
+		return nil, err
+	}
+	cache := &incrementalCache{}
+	if err := json.NewDecoder(bytes.NewReader(body)).Decode(cache); err != nil {
+		return nil, fmt.Errorf("Failed to parse '%v': %w", i.cachePath, err)
+	}
+	if cache.Version != incrementalCacheVersion || cache.Project != i.Name() || !equalStrings(cache.Columns, i.Columns()) {
+		return nil, nil
+	}
+	return cache, nil
+}
+
+func (i *Incremental) saveCache() {
+	body, err := json.Marshal(i.cache)
+	if err == nil {
+		tmp := i.cachePath + ".tmp"
+		if err = ioutil.WriteFile(tmp, body, 0666); err == nil {
+			err = os.Rename(tmp, i.cachePath)
+		}
+	}
+	if err != nil {
+		log.Printf("Failed to write monorail issue cache '%v': %v\n", i.cachePath, err)
+	}
+}
+
+func toCachedIssue(i Issue) cachedIssue {
+	return cachedIssue{
+		ID:                i.ID(),
+		Summary:           i.Summary(),
+		Assignee:          i.Assignee(),
+		Status:            i.Status(),
+		EstimatedDuration: i.EstimatedDuration(),
+		Priority:          i.Priority(),
+		Milestone:         i.Milestone(),
+		Sprint:            i.Sprint(),
+		Columns:           i.Columns(),
+		ModifyTime:        i.ModifyTime(),
+	}
+}
+
+func (c cachedIssue) issue() Issue {
+	return issue{
+		id:                c.ID,
+		summary:           c.Summary,
+		assignee:          c.Assignee,
+		status:            c.Status,
+		estimatedDuration: c.EstimatedDuration,
+		priority:          c.Priority,
+		milestone:         c.Milestone,
+		sprint:            c.Sprint,
+		columns:           c.Columns,
+		modifyTime:        c.ModifyTime,
+	}
+}
+
+func equalStrings(a, b []string) bool {
+	if len(a) != len(b) {
+		return false
+	}
+	for i := range a {
+		if a[i] != b[i] {
+			return false
+		}
+	}
+	return true
+}
@@ -0,0 +1,168 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"fmt"
+	"sort"
+	"strconv"
+	"strings"
+	"time"
+
+	monorailv3 "chromium.googlesource.com/infra/infra.git/go/src/infra/monorailv2/api/v3/api_proto"
+)
+
+// Mapping describes the additional monorail fields and labels that are
+// decoded into Issue.Columns()
+type Mapping struct {
+	// Fields maps a monorail field display name to a column name
+	Fields map[string]string
+	// Labels maps a monorail label prefix to a column name. The prefix does
+	// not include the '-', so a 'Area' prefix maps the label 'Area-GPU' to the
+	// value 'GPU'.
+	Labels map[string]string
+}
+
+// labelTarget is what a label prefix decodes to. Non-negative values are
+// column indices.
+type labelTarget int
+
+const (
+	labelPriority  labelTarget = -1
+	labelMilestone labelTarget = -2
+	labelSprint    labelTarget = -3
+)
+
+// issueDecoder converts monorail API issues to issues. It is compiled once per
+// project, so that decoding an issue performs no name lookups or string
+// comparisons of field display names, and no allocations for labels.
+type issueDecoder struct {
+	estimatedTime string                 // Field resource name of EstimateTime. "" if none.
+	fields        map[string]int         // Field resource name to column index
+	labels        map[string]labelTarget // Label prefix to target
+	columns       []string               // Column names
+}
+
+// compileMapping builds the issueDecoder for a project with the given fields,
+// keyed by field resource name, with display name values.
+func compileMapping(fieldNames map[string]string, mapping Mapping) (*issueDecoder, error) {
+	d := &issueDecoder{
+		fields: map[string]int{},
+		labels: map[string]labelTarget{
+			"Priority":  labelPriority,
+			"Milestone": labelMilestone,
+			"Sprint":    labelSprint,
+		},
+	}
+
+	columnIndex := map[string]int{}
+	column := func(name string) int {
+		idx, ok := columnIndex[name]
+		if !ok {
+			idx = len(d.columns)
+			columnIndex[name] = idx
+			d.columns = append(d.columns, name)
+		}
+		return idx
+	}
+
+	byDisplayName := make(map[string]string, len(fieldNames))
+	for name, displayName := range fieldNames {
+		byDisplayName[displayName] = name
+	}
+	if name, ok := byDisplayName[fieldEstimatedTime]; ok {
+		d.estimatedTime = name
+	}
+	// Sort so that the column order is stable across runs
+	for _, displayName := range sortedKeys(mapping.Fields) {
+		name, ok := byDisplayName[displayName]
+		if !ok {
+			return nil, fmt.Errorf("Monorail project does not have a field '%v'", displayName)
+		}
+		d.fields[name] = column(mapping.Fields[displayName])
+	}
+	for _, prefix := range sortedKeys(mapping.Labels) {
+		if _, reserved := d.labels[prefix]; reserved {
+			return nil, fmt.Errorf("Monorail label prefix '%v' cannot be mapped to a column", prefix)
+		}
+		if strings.Contains(prefix, "-") {
+			return nil, fmt.Errorf("Monorail label prefix '%v' must not contain '-'", prefix)
+		}
+		d.labels[prefix] = labelTarget(column(mapping.Labels[prefix]))
+	}
+	return d, nil
+}
+
+func sortedKeys(m map[string]string) []string {
+	out := make([]string, 0, len(m))
+	for k := range m {
+		out = append(out, k)
+	}
+	sort.Strings(out)
+	return out
+}
+
+// decode converts the monorail API issue to an issue, with the given ID. The
+// assignee of the returned issue is the owner's user ID.
+func (d *issueDecoder) decode(id int, item *monorailv3.Issue) *issue {
+	out := &issue{
+		id:         id,
+		summary:    item.GetSummary(),
+		assignee:   item.GetOwner().GetUser(),
+		status:     Status(item.GetStatus().GetStatus()),
+		priority:   PriorityMedium,
+		modifyTime: item.GetModifyTime().AsTime(),
+	}
+	if len(d.columns) > 0 {
+		out.columns = make([]string, len(d.columns))
+	}
+
+	estimated := false
+	for _, field := range item.FieldValues {
+		name := field.GetField()
+		if !estimated && name == d.estimatedTime && name != "" {
+			hours, _ := strconv.Atoi(field.GetValue())
+			out.estimatedDuration = time.Hour * time.Duration(hours)
+			estimated = true
+		} else if idx, ok := d.fields[name]; ok {
+			out.columns[idx] = field.GetValue()
+		}
+	}
+
+	for _, l := range item.GetLabels() {
+		label := l.GetLabel()
+		// Only labels of the form <key>-<value> are decoded
+		dash := strings.IndexByte(label, '-')
+		if dash < 0 || strings.IndexByte(label[dash+1:], '-') >= 0 {
+			continue
+		}
+		target, ok := d.labels[label[:dash]]
+		if !ok {
+			continue
+		}
+		val := label[dash+1:]
+		switch target {
+		case labelPriority:
+			out.priority = Priority(val)
+		case labelMilestone:
+			out.milestone = val
+		case labelSprint:
+			out.sprint = val
+		default:
+			out.columns[target] = val
+		}
+	}
+	return out
+}
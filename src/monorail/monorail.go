@@ -17,6 +17,7 @@ package monorail
 import (
 	"context"
 	"fmt"
+	"log"
 	"os"
 	"strconv"
 	"strings"
@@ -45,8 +46,9 @@ func run(ctx context.Context) error {
 	return nil
 }
 
-// New constructs and returns a new Monorail
-func New(authJSONPath string) (Monorail, error) {
+// New constructs and returns a new Monorail, making its requests within the
+// limits
+func New(authJSONPath string, limits Limits) (Monorail, error) {
 	ctx := context.Background()
 	authenticator := auth.NewAuthenticator(ctx, auth.InteractiveLogin, auth.Options{
 		ServiceAccountJSONPath: authJSONPath,
@@ -61,22 +63,61 @@ func New(authJSONPath string) (Monorail, error) {
 
 	prpcClient := &prpc.Client{C: httpClient, Host: "api-dot-monorail-prod.appspot.com"}
 
-	issuesClient := monorailv3.NewIssuesPRPCClient(prpcClient)
-	usersClient := monorailv3.NewUsersPRPCClient(prpcClient)
-	frontendClient := monorailv3.NewFrontendPRPCClient(prpcClient)
-
-	return &mr{issuesClient, usersClient, frontendClient}, nil
+	rpc := newRPCLimiter(limits)
+	return &mr{
+		issuesClient:   issuesClient{monorailv3.NewIssuesPRPCClient(prpcClient), rpc},
+		usersClient:    usersClient{monorailv3.NewUsersPRPCClient(prpcClient), rpc},
+		frontendClient: frontendClient{monorailv3.NewFrontendPRPCClient(prpcClient), rpc},
+		users:          newUserCache(),
+		rpc:            rpc,
+	}, nil
 }
 
 // Monorail is the interface to the monorail API
 type Monorail interface {
-	Project(name string) (Project, error)
+	// Project returns the monorail project with the given name. The project's
+	// issues have the additional fields and labels described by mapping
+	// decoded into Issue.Columns().
+	Project(name string, mapping Mapping) (Project, error)
+	// ProjectCached is like Project(), but loads the project's field
+	// definitions from the file at cachePath if the file is younger than ttl,
+	// otherwise fetches the field definitions and writes them to the file.
+	ProjectCached(name string, mapping Mapping, cachePath string, ttl time.Duration) (Project, error)
+	// LoadUsers loads the user ID to email address cache from the file at
+	// path, if it exists. Cached users older than ttl are fetched again. A ttl
+	// of 0 means cached users never expire.
+	LoadUsers(path string, ttl time.Duration) error
+	// SaveUsers writes the user ID to email address cache to the file at path.
+	SaveUsers(path string) error
+	// RPCStats returns the statistics of the API methods called so far
+	RPCStats() []RPCStats
 }
 
 // Project is the interface to a monorail project
 type Project interface {
 	Name() string
+	// Columns returns the names of the columns described by the project's
+	// Mapping, in the order of Issue.Columns()
+	Columns() []string
 	Issues() ([]Issue, error)
+	// IssuesStream sends all the issues of the project to out, closing out
+	// once all the issues have been sent, or an error occurs.
+	IssuesStream(out chan<- Issue) error
+	// IssuesModifiedSince returns the issues that have been modified since t.
+	// The search has a granularity of a day, so issues modified up to a day
+	// before t may also be returned.
+	IssuesModifiedSince(t time.Time) ([]Issue, error)
+	// StreamStats returns the statistics of the last search made by
+	// IssuesStream() or IssuesModifiedSince().
+	StreamStats() StreamStats
+	// UpdateIssues writes the updates to the project's issues. The updates
+	// that could not be written are returned, along with the first error.
+	// Updates that change nothing are skipped.
+	UpdateIssues(updates []IssueUpdate) ([]IssueUpdate, error)
+	// WritableFields returns the fields that UpdateIssues() can write. The
+	// estimated duration can only be written if the project has an
+	// EstimateTime field.
+	WritableFields() IssueFields
 }
 
 // Issue is the interface to a single issue
@@ -89,147 +130,226 @@ type Issue interface {
 	Priority() Priority
 	Milestone() string
 	Sprint() string
+	// Columns returns the values of the project's mapped columns, in the
+	// order of Project.Columns()
+	Columns() []string
+	// ModifyTime returns the time the issue was last modified
+	ModifyTime() time.Time
 }
 
 type mr struct {
 	issuesClient   monorailv3.IssuesClient
 	usersClient    monorailv3.UsersClient
 	frontendClient monorailv3.FrontendClient
+	users          *userCache
+	rpc            *rpcLimiter
 }
 
-func (m *mr) Project(name string) (Project, error) {
-	ctx := context.Background()
+func (m *mr) Project(name string, mapping Mapping) (Project, error) {
 	monorailName := "projects/" + name
+	fieldNames, err := m.fieldNames(monorailName)
+	if err != nil {
+		return nil, err
+	}
+	return m.newProject(name, fieldNames, mapping)
+}
 
-	fieldDefs := map[string]*monorailv3.FieldDef{}
-	{
-		request := &monorailv3.GatherProjectEnvironmentRequest{Parent: monorailName}
-		response, err := m.frontendClient.GatherProjectEnvironment(ctx, request)
-		if err != nil {
-			return nil, fmt.Errorf("GatherProjectEnvironment returned %w", err)
-		}
-		for _, field := range response.Fields {
-			fieldDefs[field.GetName()] = field
-		}
+func (m *mr) newProject(name string, fieldNames map[string]string, mapping Mapping) (*project, error) {
+	decoder, err := compileMapping(fieldNames, mapping)
+	if err != nil {
+		return nil, fmt.Errorf("Failed to compile mapping for monorail project '%v': %w", name, err)
 	}
+	return &project{m: m, name: name, monorailName: "projects/" + name, decoder: decoder}, nil
+}
 
-	return &project{m, name, monorailName, fieldDefs}, nil
+// fieldNames returns the display names of the project's fields, keyed by field
+// name.
+func (m *mr) fieldNames(monorailName string) (map[string]string, error) {
+	ctx := context.Background()
+	request := &monorailv3.GatherProjectEnvironmentRequest{Parent: monorailName}
+	response, err := m.frontendClient.GatherProjectEnvironment(ctx, request)
+	if err != nil {
+		return nil, fmt.Errorf("GatherProjectEnvironment returned %w", err)
+	}
+	fieldNames := make(map[string]string, len(response.Fields))
+	for _, field := range response.Fields {
+		fieldNames[field.GetName()] = field.GetDisplayName()
+	}
+	return fieldNames, nil
 }
 
 type project struct {
 	m            *mr
 	name         string
 	monorailName string
-	fieldDefs    map[string]*monorailv3.FieldDef
+	decoder      *issueDecoder
+	stats        streamStats
 }
 
-func (p *project) Name() string { return p.name }
+func (p *project) Name() string      { return p.name }
+func (p *project) Columns() []string { return p.decoder.columns }
 
 func (p *project) Issues() ([]Issue, error) {
-	ctx := context.Background()
+	return collectIssues(p.IssuesStream)
+}
 
-	issuesRequest := monorailv3.SearchIssuesRequest{
-		Projects: []string{p.monorailName},
-	}
+func (p *project) IssuesStream(out chan<- Issue) error {
+	return p.searchStream("", out)
+}
 
-	userIDsToEmail := map[string]string{}
+func (p *project) IssuesModifiedSince(t time.Time) ([]Issue, error) {
+	// Monorail dates have a granularity of a day, so step back a day to ensure
+	// nothing modified on the day of t is missed.
+	day := t.UTC().AddDate(0, 0, -1).Format("2006/01/02")
+	return collectIssues(func(out chan<- Issue) error {
+		return p.searchStream("modified>"+day, out)
+	})
+}
 
-	issues := []*issue{}
-	namePrefix := p.monorailName + "/issues/"
+// issuesStreamBuffer is the capacity of the channels used to stream issues
+const issuesStreamBuffer = 1024
+
+// collectIssues calls stream, gathering all the streamed issues into a slice
+func collectIssues(stream func(chan<- Issue) error) ([]Issue, error) {
+	c := make(chan Issue, issuesStreamBuffer)
+	errc := make(chan error, 1)
+	go func() { errc <- stream(c) }()
+	out := []Issue{}
+	for issue := range c {
+		out = append(out, issue)
+	}
+	if err := <-errc; err != nil {
+		return nil, err
+	}
+	return out, nil
+}
 
-	for {
-		issuesResponse, err := p.m.issuesClient.SearchIssues(ctx, &issuesRequest)
-		if err != nil {
-			return nil, err
-		}
-		fmt.Println("issues returned: ", len(issuesResponse.Issues))
+// searchPage is a single page of results fetched by searchStream()
+type searchPage struct {
+	issues  []*monorailv3.Issue
+	err     error
+	latency time.Duration // Time taken by the SearchIssues() request
+}
 
-		for _, item := range issuesResponse.Issues {
-			name := item.GetName()
-			if !strings.HasPrefix(name, namePrefix) {
-				return nil, fmt.Errorf("Expected issue '%v' to have '%v' prefix", name, namePrefix)
-			}
-			idStr := name[len(namePrefix):]
-			id, err := strconv.Atoi(idStr)
-			if err != nil {
-				return nil, fmt.Errorf("Failed to parse issue ID from '%v'", idStr)
-			}
-			estimatedHours := 0
-			for _, field := range item.FieldValues {
-				if def, ok := p.fieldDefs[field.GetField()]; ok {
-					if def.GetDisplayName() == fieldEstimatedTime {
-						estimatedHours, _ = strconv.Atoi(field.GetValue())
-						break
-					}
-				}
+// searchStream streams all the issues in the project that match the query to
+// out, closing out once all issues have been sent or an error has occurred.
+// The next page of results is fetched while the current page is being decoded
+// and having its owners resolved.
+func (p *project) searchStream(query string, out chan<- Issue) error {
+	defer close(out)
+	stats := StreamStats{}
+	defer func() { p.stats.set(stats) }()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+
+	pages := make(chan searchPage, 1)
+	go func() {
+		defer close(pages)
+		issuesRequest := monorailv3.SearchIssuesRequest{
+			Projects: []string{p.monorailName},
+			Query:    query,
+		}
+		for {
+			start := time.Now()
+			issuesResponse, err := p.m.issuesClient.SearchIssues(ctx, &issuesRequest)
+			page := searchPage{err: err, latency: time.Since(start)}
+			if err == nil {
+				page.issues = issuesResponse.Issues
 			}
-			priority := PriorityMedium
-			milestone := ""
-			sprint := ""
-			for _, label := range item.GetLabels() {
-				if parts := strings.Split(label.GetLabel(), "-"); len(parts) == 2 {
-					key, val := parts[0], parts[1]
-					switch key {
-					case "Priority":
-						priority = Priority(val)
-						continue
-					case "Milestone":
-						milestone = val
-						continue
-					case "Sprint":
-						sprint = val
-						continue
-					}
-				}
+			select {
+			case pages <- page:
+			case <-ctx.Done():
+				return
 			}
-			userID := item.GetOwner().GetUser()
-			issues = append(issues, &issue{
-				id:                id,
-				summary:           item.GetSummary(),
-				assignee:          userID, // We'll transform this to email address in a second pass
-				status:            Status(item.GetStatus().GetStatus()),
-				estimatedDuration: time.Hour * time.Duration(estimatedHours),
-				priority:          priority,
-				milestone:         milestone,
-				sprint:            sprint,
-			})
-			if userID != "" {
-				userIDsToEmail[userID] = ""
+			if err != nil || issuesResponse.GetNextPageToken() == "" {
+				return
 			}
+			issuesRequest.PageToken = issuesResponse.GetNextPageToken()
+		}
+	}()
+
+	for page := range pages {
+		stats.Pages++
+		stats.SearchTime += page.latency
+		if page.err != nil {
+			return page.err
+		}
+		stats.Issues += len(page.issues)
+		fmt.Println("issues returned: ", len(page.issues))
+
+		issues, err := p.decodeIssues(page.issues)
+		if err != nil {
+			return err
+		}
+		start := time.Now()
+		users, err := p.resolveAssignees(ctx, issues)
+		stats.Users += users
+		stats.UserTime += time.Since(start)
+		if err != nil {
+			return err
+		}
+		for _, issue := range issues {
+			out <- issue
+		}
+	}
+	return nil
+}
+
+// decodeIssues converts the monorail API issues to issues. The assignee of
+// each returned issue is the owner's user ID, which needs to be transformed
+// to an email address with resolveAssignees().
+func (p *project) decodeIssues(items []*monorailv3.Issue) ([]*issue, error) {
+	namePrefix := p.monorailName + "/issues/"
+	issues := make([]*issue, 0, len(items))
+	for _, item := range items {
+		name := item.GetName()
+		if !strings.HasPrefix(name, namePrefix) {
+			return nil, fmt.Errorf("Expected issue '%v' to have '%v' prefix", name, namePrefix)
 		}
-		if issuesResponse.GetNextPageToken() == "" {
-			break
+		idStr := name[len(namePrefix):]
+		id, err := strconv.Atoi(idStr)
+		if err != nil {
+			return nil, fmt.Errorf("Failed to parse issue ID from '%v'", idStr)
 		}
-		issuesRequest.PageToken = issuesResponse.GetNextPageToken()
+		issues = append(issues, p.decoder.decode(id, item))
 	}
-	usersRequest := &monorailv3.BatchGetUsersRequest{}
-	for id := range userIDsToEmail {
-		if id != "" {
-			usersRequest.Names = append(usersRequest.Names, id)
+	return issues, nil
+}
+
+// resolveAssignees transforms the assignee user IDs of issues to email
+// addresses. Users missing from the Monorail's user cache are fetched, and
+// added to the cache. The number of users fetched is returned.
+func (p *project) resolveAssignees(ctx context.Context, issues []*issue) (int, error) {
+	missing := []string{}
+	requested := map[string]bool{}
+	for _, issue := range issues {
+		id := issue.assignee
+		if id == "" || requested[id] {
+			continue
+		}
+		if _, known := p.m.users.lookup(id); !known {
+			missing = append(missing, id)
+			requested[id] = true
 		}
 	}
-	usersResponse, err := p.m.usersClient.BatchGetUsers(ctx, usersRequest)
-	if err != nil {
-		return nil, fmt.Errorf("BatchGetUsers() returned %w", err)
+	if err := p.m.fetchUsers(ctx, missing); err != nil {
+		return len(missing), err
 	}
-	for _, user := range usersResponse.Users {
-		userIDsToEmail[user.GetName()] = user.GetEmail()
+	for _, id := range missing {
+		if email, _ := p.m.users.lookup(id); email == "" {
+			log.Printf("warning: Couldn't resolve email address of '%v'. Its issues are left unassigned\n", id)
+		}
 	}
 
-	out := make([]Issue, len(issues))
-	for i, issue := range issues {
+	for _, issue := range issues {
 		if issue.assignee != "" {
-			// Remap assignee ID to email address
-			email, ok := userIDsToEmail[issue.assignee]
-			if !ok {
-				return nil, fmt.Errorf("Couldn't resolve email address of '%v'", issue.assignee)
-			}
-			issue.assignee = email
+			// Remap assignee ID to email address. Unresolved users are
+			// cached by fetchUsers() with no email address.
+			issue.assignee, _ = p.m.users.lookup(issue.assignee)
 		}
-		out[i] = issue
 	}
-
-	return out, nil
+	return len(missing), nil
 }
 
 type issue struct {
@@ -241,6 +361,8 @@ type issue struct {
 	priority          Priority
 	milestone         string
 	sprint            string
+	columns           []string
+	modifyTime        time.Time
 }
 
 func (i issue) ID() int                          { return i.id }
@@ -251,6 +373,8 @@ func (i issue) EstimatedDuration() time.Duration { return i.estimatedDuration }
 func (i issue) Priority() Priority               { return i.priority }
 func (i issue) Milestone() string                { return i.milestone }
 func (i issue) Sprint() string                   { return i.sprint }
+func (i issue) Columns() []string                { return i.columns }
+func (i issue) ModifyTime() time.Time            { return i.modifyTime }
 
 // Status is an enumerator of issue status
 type Status string
@@ -0,0 +1,55 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"sync"
+	"time"
+)
+
+// StreamStats holds the statistics of a single issue search, as returned by
+// Project.StreamStats()
+type StreamStats struct {
+	// Number of SearchIssues() requests made, and the number of issues they
+	// returned
+	Pages, Issues int
+	// Total time spent waiting for SearchIssues() responses
+	SearchTime time.Duration
+	// Number of users fetched with BatchGetUsers()
+	Users int
+	// Total time spent resolving the assignees' email addresses, including
+	// the BatchGetUsers() requests
+	UserTime time.Duration
+}
+
+// streamStats holds the StreamStats of a project's last search
+type streamStats struct {
+	mutex sync.Mutex
+	last  StreamStats
+}
+
+func (s *streamStats) get() StreamStats {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	return s.last
+}
+
+func (s *streamStats) set(stats StreamStats) {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	s.last = stats
+}
+
+func (p *project) StreamStats() StreamStats { return p.stats.get() }
@@ -0,0 +1,207 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"context"
+	"fmt"
+	"strconv"
+	"sync"
+	"time"
+
+	monorailv3 "chromium.googlesource.com/infra/infra.git/go/src/infra/monorailv2/api/v3/api_proto"
+	"google.golang.org/protobuf/types/known/fieldmaskpb"
+)
+
+const (
+	// Maximum number of issues modified by a single ModifyIssues() call
+	modifyIssuesChunkSize = 50
+	// Maximum number of concurrent ModifyIssues() calls
+	modifyIssuesConcurrency = 4
+	// Comment added to the issues modified by UpdateIssues()
+	updateComment = "Synchronized from Hansoft"
+)
+
+// IssueFields is a bit mask of issue fields
+type IssueFields int
+
+// Bit values of IssueFields
+const (
+	FieldSummary IssueFields = 1 << iota
+	FieldStatus
+	FieldPriority
+	FieldEstimatedDuration
+	FieldMilestone
+)
+
+// IssueValues holds the values of the issue fields that can be written by
+// Project.UpdateIssues()
+type IssueValues struct {
+	Summary           string
+	Status            Status
+	Priority          Priority
+	EstimatedDuration time.Duration
+	Milestone         string
+}
+
+// IssueUpdate is a change to the fields of a single issue
+type IssueUpdate struct {
+	ID     int
+	Fields IssueFields // The fields to write
+	// Old holds the issue's current values, used to remove the labels and
+	// field values replaced by New
+	Old, New IssueValues
+}
+
+func (p *project) UpdateIssues(updates []IssueUpdate) ([]IssueUpdate, error) {
+	deltas := make([]*monorailv3.IssueDelta, 0, len(updates))
+	sent := make([]int, 0, len(updates)) // Index in updates of each delta
+	for i, u := range updates {
+		// An empty update mask would fail the whole ModifyIssues() chunk
+		if delta := p.delta(u); len(delta.UpdateMask.Paths) > 0 {
+			deltas = append(deltas, delta)
+			sent = append(sent, i)
+		}
+	}
+	if len(deltas) == 0 {
+		return nil, nil
+	}
+	failed, err := p.m.modifyIssues(context.Background(), p.monorailName, deltas)
+	out := make([]IssueUpdate, 0, len(failed))
+	for _, i := range failed {
+		out = append(out, updates[sent[i]])
+	}
+	return out, err
+}
+
+func (p *project) WritableFields() IssueFields {
+	fields := FieldSummary | FieldStatus | FieldPriority | FieldMilestone
+	if p.decoder.estimatedTime != "" {
+		fields |= FieldEstimatedDuration
+	}
+	return fields
+}
+
+// delta returns the ModifyIssues() delta for the update
+func (p *project) delta(u IssueUpdate) *monorailv3.IssueDelta {
+	issue := &monorailv3.Issue{Name: fmt.Sprintf("%v/issues/%v", p.monorailName, u.ID)}
+	delta := &monorailv3.IssueDelta{Issue: issue, UpdateMask: &fieldmaskpb.FieldMask{}}
+	mask := func(path string) {
+		for _, p := range delta.UpdateMask.Paths {
+			if p == path {
+				return
+			}
+		}
+		delta.UpdateMask.Paths = append(delta.UpdateMask.Paths, path)
+	}
+	label := func(prefix, old, new string) {
+		if new == old {
+			return
+		}
+		if old != "" {
+			delta.LabelsRemove = append(delta.LabelsRemove, prefix+"-"+old)
+		}
+		if new != "" {
+			issue.Labels = append(issue.Labels, &monorailv3.Issue_LabelValue{Label: prefix + "-" + new})
+		}
+		mask("labels")
+	}
+
+	if u.Fields&FieldSummary != 0 {
+		issue.Summary = u.New.Summary
+		mask("summary")
+	}
+	if u.Fields&FieldStatus != 0 {
+		issue.Status = &monorailv3.Issue_StatusValue{Status: string(u.New.Status)}
+		mask("status")
+	}
+	if u.Fields&FieldPriority != 0 {
+		label("Priority", string(u.Old.Priority), string(u.New.Priority))
+	}
+	if u.Fields&FieldMilestone != 0 {
+		label("Milestone", u.Old.Milestone, u.New.Milestone)
+	}
+	if u.Fields&FieldEstimatedDuration != 0 && p.decoder.estimatedTime != "" {
+		hours := func(d time.Duration) string { return strconv.Itoa(int(d / time.Hour)) }
+		if u.Old.EstimatedDuration != 0 {
+			delta.FieldValsRemove = append(delta.FieldValsRemove, &monorailv3.FieldValue{
+				Field: p.decoder.estimatedTime,
+				Value: hours(u.Old.EstimatedDuration),
+			})
+		}
+		if u.New.EstimatedDuration != 0 {
+			issue.FieldValues = append(issue.FieldValues, &monorailv3.FieldValue{
+				Field: p.decoder.estimatedTime,
+				Value: hours(u.New.EstimatedDuration),
+			})
+		}
+		mask("field_values")
+	}
+	return delta
+}
+
+// modifyIssues applies the deltas to the issues of the project with the given
+// resource name. The deltas are split into chunks of modifyIssuesChunkSize,
+// with up to modifyIssuesConcurrency chunks written at a time. A failed chunk
+// does not stop the others from being written. The indices of the deltas of
+// the failed chunks are returned, along with the first error.
+func (m *mr) modifyIssues(ctx context.Context, parent string, deltas []*monorailv3.IssueDelta) ([]int, error) {
+	type chunk struct{ start, end int }
+	chunks := make(chan chunk, (len(deltas)+modifyIssuesChunkSize-1)/modifyIssuesChunkSize)
+	for start := 0; start < len(deltas); start += modifyIssuesChunkSize {
+		end := start + modifyIssuesChunkSize
+		if end > len(deltas) {
+			end = len(deltas)
+		}
+		chunks <- chunk{start, end}
+	}
+	close(chunks)
+
+	workers := len(chunks)
+	if workers > modifyIssuesConcurrency {
+		workers = modifyIssuesConcurrency
+	}
+
+	mutex := sync.Mutex{}
+	failed := []int{}
+	var firstErr error
+	wg := sync.WaitGroup{}
+	wg.Add(workers)
+	for w := 0; w < workers; w++ {
+		go func() {
+			defer wg.Done()
+			for c := range chunks {
+				request := &monorailv3.ModifyIssuesRequest{
+					Parent:         parent,
+					Deltas:         deltas[c.start:c.end],
+					NotifyType:     monorailv3.NotifyType_NO_NOTIFICATION,
+					CommentContent: updateComment,
+				}
+				if _, err := m.issuesClient.ModifyIssues(ctx, request); err != nil {
+					mutex.Lock()
+					for i := c.start; i < c.end; i++ {
+						failed = append(failed, i)
+					}
+					if firstErr == nil {
+						firstErr = fmt.Errorf("ModifyIssues() returned %w", err)
+					}
+					mutex.Unlock()
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	return failed, firstErr
+}
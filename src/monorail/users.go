@@ -0,0 +1,190 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monorail
+
+import (
+	"bytes"
+	"context"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"sync"
+	"time"
+
+	monorailv3 "chromium.googlesource.com/infra/infra.git/go/src/infra/monorailv2/api/v3/api_proto"
+)
+
+const (
+	// Maximum number of users requested by a single BatchGetUsers() call
+	usersChunkSize = 100
+	// Maximum number of concurrent BatchGetUsers() calls
+	usersConcurrency = 4
+	// The version of the user cache file format.
+	// Bump this whenever the format changes, to invalidate old caches.
+	userCacheVersion = 1
+)
+
+// userCache maps user IDs to email addresses. It is shared by all the projects
+// of a Monorail, and lives for the lifetime of the Monorail.
+type userCache struct {
+	mutex sync.Mutex
+	users map[string]cachedUser // User ID to user
+	ttl   time.Duration         // 0 means entries never expire
+
+	saveMutex sync.Mutex // Serializes SaveUsers()
+}
+
+type cachedUser struct {
+	Email   string // Empty if the user could not be resolved
+	Fetched time.Time
+}
+
+type userCacheFile struct {
+	Version int
+	Users   map[string]cachedUser
+}
+
+func newUserCache() *userCache {
+	return &userCache{users: map[string]cachedUser{}}
+}
+
+// lookup returns the email address of the user with the given ID, if cached
+// and not expired.
+func (c *userCache) lookup(id string) (string, bool) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	user, ok := c.users[id]
+	if !ok || (c.ttl > 0 && time.Since(user.Fetched) > c.ttl) {
+		return "", false
+	}
+	return user.Email, true
+}
+
+// add caches the users fetched for the requested IDs. The IDs that were not
+// returned are cached with no email address, so that they are not requested
+// again until they expire.
+func (c *userCache) add(requested []string, users []*monorailv3.User, fetched time.Time) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	for _, id := range requested {
+		c.users[id] = cachedUser{"", fetched}
+	}
+	for _, user := range users {
+		c.users[user.GetName()] = cachedUser{user.GetEmail(), fetched}
+	}
+}
+
+func (m *mr) LoadUsers(path string, ttl time.Duration) error {
+	m.users.mutex.Lock()
+	defer m.users.mutex.Unlock()
+	m.users.ttl = ttl
+
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return nil
+		}
+		return fmt.Errorf("Failed to load '%v': %w", path, err)
+	}
+	file := userCacheFile{}
+	if err := json.NewDecoder(bytes.NewReader(body)).Decode(&file); err != nil {
+		return fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	if file.Version != userCacheVersion {
+		return nil
+	}
+	for id, user := range file.Users {
+		if existing, ok := m.users.users[id]; !ok || existing.Fetched.Before(user.Fetched) {
+			m.users.users[id] = user
+		}
+	}
+	return nil
+}
+
+func (m *mr) SaveUsers(path string) error {
+	m.users.saveMutex.Lock()
+	defer m.users.saveMutex.Unlock()
+
+	m.users.mutex.Lock()
+	file := userCacheFile{Version: userCacheVersion, Users: make(map[string]cachedUser, len(m.users.users))}
+	for id, user := range m.users.users {
+		// Unresolved users are not saved, and are retried by the next process
+		if user.Email != "" && (m.users.ttl == 0 || time.Since(user.Fetched) <= m.users.ttl) {
+			file.Users[id] = user
+		}
+	}
+	m.users.mutex.Unlock()
+
+	body, err := json.Marshal(file)
+	if err != nil {
+		return fmt.Errorf("Failed to encode user cache: %w", err)
+	}
+	tmp := path + ".tmp"
+	if err := ioutil.WriteFile(tmp, body, 0666); err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", tmp, err)
+	}
+	if err := os.Rename(tmp, path); err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", path, err)
+	}
+	return nil
+}
+
+// fetchUsers resolves the email addresses of the users with the given IDs,
+// adding them to the user cache. The IDs are split into chunks of
+// usersChunkSize, with up to usersConcurrency chunks fetched at a time.
+func (m *mr) fetchUsers(ctx context.Context, ids []string) error {
+	chunks := make(chan []string, (len(ids)+usersChunkSize-1)/usersChunkSize)
+	for len(ids) > 0 {
+		n := len(ids)
+		if n > usersChunkSize {
+			n = usersChunkSize
+		}
+		chunks <- ids[:n]
+		ids = ids[n:]
+	}
+	close(chunks)
+
+	workers := len(chunks)
+	if workers > usersConcurrency {
+		workers = usersConcurrency
+	}
+
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+
+	errs := make(chan error, workers)
+	wg := sync.WaitGroup{}
+	wg.Add(workers)
+	for w := 0; w < workers; w++ {
+		go func() {
+			defer wg.Done()
+			for chunk := range chunks {
+				fetched := time.Now()
+				request := &monorailv3.BatchGetUsersRequest{Names: chunk}
+				response, err := m.usersClient.BatchGetUsers(ctx, request)
+				if err != nil {
+					errs <- fmt.Errorf("BatchGetUsers() returned %w", err)
+					cancel()
+					return
+				}
+				m.users.add(chunk, response.Users, fetched)
+			}
+		}()
+	}
+	wg.Wait()
+	close(errs)
+	return <-errs
+}
@@ -0,0 +1,225 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+// The benchmarks synchronize fake monorail and hansoft projects, without a
+// Hansoft server or Monorail credentials. The fake projects are configured by
+// the flags below, for example:
+//
+//	go test ./src/projectsync -run=^$ -bench=. -args -issues=200000 -chunk-size=10000
+//
+// Along with the standard metrics, each benchmark reports the backend calls
+// and items read or written per operation ("calls/op", "items/op"), and the
+// time and bytes allocated per issue ("ns/issue", "B/issue").
+
+import (
+	"flag"
+	"fmt"
+	"io/ioutil"
+	"log"
+	"mhs/src/fake"
+	"mhs/src/hansoft"
+	"mhs/src/monorail"
+	"runtime"
+	"sort"
+	"strings"
+	"testing"
+	"time"
+)
+
+var (
+	benchIssues        = flag.Int("issues", 10000, "number of issues of the benchmarked fake projects")
+	benchMonorailChurn = flag.Float64("monorail-churn", 0.01, "fraction of monorail issues changed before each incremental sync")
+	benchHansoftChurn  = flag.Float64("hansoft-churn", 0.001, "fraction of hansoft tasks changed before each incremental sync")
+	benchCallLatency   = flag.Duration("call-latency", 0, "simulated latency of each backend call")
+	benchItemLatency   = flag.Duration("item-latency", 0, "simulated additional latency for each task or issue read or written by a backend call")
+	benchSeed          = flag.Int64("seed", 1, "seed of the synthetic datasets")
+	benchColumns       = flag.String("columns", "", "comma separated list of mapped custom columns")
+	benchWriteBack     = flag.Bool("write-back", false, "write the hansoft changes back to the monorail issues")
+	benchChunkSize     = flag.Int("chunk-size", 0, "number of issues reconciled at a time. 0 reconciles all the issues at once")
+)
+
+// newBenchPair returns a new fake project pair, described by the flags
+func newBenchPair() *fake.Pair {
+	if !testing.Verbose() {
+		log.SetOutput(ioutil.Discard)
+	}
+	latency := fake.Latency{Call: *benchCallLatency, Item: *benchItemLatency}
+	d := fake.Dataset{
+		Issues:          *benchIssues,
+		Seed:            *benchSeed,
+		MonorailLatency: latency,
+		HansoftLatency:  latency,
+	}
+	if *benchColumns != "" {
+		d.Columns = strings.Split(*benchColumns, ",")
+	}
+	return fake.New("bench", d)
+}
+
+// newBenchSyncer returns a Syncer of the pair, configured by the flags
+func newBenchSyncer(pair *fake.Pair) *Syncer {
+	s := New(pair.Monorail, pair.Hansoft)
+	s.SetWriteBack(*benchWriteBack)
+	s.SetChunkSize(*benchChunkSize)
+	return s
+}
+
+// newSyncedBenchSyncer returns a new fake project pair, and a Syncer that has
+// populated its hansoft project
+func newSyncedBenchSyncer(b *testing.B) (*Syncer, *fake.Pair) {
+	pair := newBenchPair()
+	s := newBenchSyncer(pair)
+	if err := s.Sync(); err != nil {
+		b.Fatalf("Failed to populate the fake hansoft project: %v", err)
+	}
+	return s, pair
+}
+
+// runBenchmark runs op b.N times, calling setup outside of the timed region
+// before each op, and reports the backend calls and items per op, and the
+// time and bytes allocated per issue
+func runBenchmark(b *testing.B, pair *fake.Pair, setup func(), op func() error) {
+	b.ReportAllocs()
+	pair.Monorail.ResetStats()
+	pair.Hansoft.ResetStats()
+	elapsed, alloced := time.Duration(0), uint64(0)
+	mem := runtime.MemStats{}
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		b.StopTimer()
+		if setup != nil {
+			setup()
+		}
+		runtime.ReadMemStats(&mem)
+		before, start := mem.TotalAlloc, time.Now()
+		b.StartTimer()
+		err := op()
+		b.StopTimer()
+		elapsed += time.Since(start)
+		runtime.ReadMemStats(&mem)
+		alloced += mem.TotalAlloc - before
+		if err != nil {
+			b.Fatal(err)
+		}
+		b.StartTimer()
+	}
+	b.StopTimer()
+	m, h := pair.Monorail.Stats(), pair.Hansoft.Stats()
+	b.ReportMetric(float64(m.Calls+h.Calls)/float64(b.N), "calls/op")
+	b.ReportMetric(float64(m.Items+h.Items)/float64(b.N), "items/op")
+	if issues := float64(*benchIssues * b.N); issues > 0 {
+		b.ReportMetric(float64(elapsed.Nanoseconds())/issues, "ns/issue")
+		b.ReportMetric(float64(alloced)/issues, "B/issue")
+	}
+}
+
+// BenchmarkGatherHansoftIssues benchmarks gathering all the linked hansoft
+// tasks
+func BenchmarkGatherHansoftIssues(b *testing.B) {
+	s, pair := newSyncedBenchSyncer(b)
+	runBenchmark(b, pair, nil, func() error {
+		_, err := s.gatherHansoftIssues(s.h)
+		return err
+	})
+}
+
+// BenchmarkGatherMonorailIssues benchmarks streaming and interning all the
+// monorail issues
+func BenchmarkGatherMonorailIssues(b *testing.B) {
+	pair := newBenchPair()
+	s := newBenchSyncer(pair)
+	runBenchmark(b, pair, nil, s.collectMonorailIssues)
+}
+
+// BenchmarkDiff benchmarks diffing every issue, with the projects in sync
+func BenchmarkDiff(b *testing.B) {
+	s, pair := newSyncedBenchSyncer(b)
+	if err := s.collectMonorailIssues(); err != nil {
+		b.Fatal(err)
+	}
+	sort.Slice(s.mIssues, func(a, b int) bool { return s.mIssues[a].id < s.mIssues[b].id })
+	if err := s.readAll(); err != nil {
+		b.Fatal(err)
+	}
+	runBenchmark(b, pair, nil, s.diffAll)
+}
+
+// BenchmarkSync benchmarks an incremental Sync() after churning the projects
+func BenchmarkSync(b *testing.B) {
+	s, pair := newSyncedBenchSyncer(b)
+	churn := func() { pair.Churn(*benchMonorailChurn, *benchHansoftChurn) }
+	runBenchmark(b, pair, churn, s.Sync)
+}
+
+// BenchmarkSyncCold benchmarks a Sync() by a new Syncer, reading everything
+func BenchmarkSyncCold(b *testing.B) {
+	s, pair := newSyncedBenchSyncer(b)
+	fresh := func() { s = newBenchSyncer(pair) }
+	runBenchmark(b, pair, fresh, func() error { return s.Sync() })
+}
+
+// collectMonorailIssues streams and interns all the monorail issues into
+// s.mIssues, as Sync() does
+func (s *Syncer) collectMonorailIssues() error {
+	issues := make(chan monorail.Issue, monorailStreamBuffer)
+	errc := make(chan error, 1)
+	go func() { errc <- s.m.IssuesStream(issues) }()
+	s.mIssues = s.mIssues[:0]
+	for i := range issues {
+		s.mIssues = append(s.mIssues, s.internIssue(i))
+	}
+	return <-errc
+}
+
+// readAll reads the fields of every hansoft task of the issue table
+func (s *Syncer) readAll() error {
+	rows := s.issues.rows
+	tasks := make([]hansoft.Task, len(rows))
+	for i, h := range rows {
+		tasks[i] = h.Task
+	}
+	snapshots, err := s.h.Backlog().Snapshot(tasks, s.columns...)
+	if err != nil {
+		return err
+	}
+	for i, snap := range snapshots {
+		if snap.Err != nil {
+			return snap.Err
+		}
+		rows[i] = s.hIssueFromSnapshot(rows[i].id, snap)
+	}
+	return nil
+}
+
+// diffAll diffs each of the sorted s.mIssues against its hansoft issue, as
+// mergeIssues() does, but without writing to hansoft
+func (s *Syncer) diffAll() error {
+	rows := s.issues.rows
+	row, diffs := 0, 0
+	for i := range s.mIssues {
+		m := &s.mIssues[i]
+		for row < len(rows) && rows[row].id < m.id {
+			row++
+		}
+		if row < len(rows) && rows[row].id == m.id {
+			diffs += len(s.diff(&rows[row], m))
+		}
+	}
+	if diffs > 0 {
+		return fmt.Errorf("%v differences found between the synchronized projects", diffs)
+	}
+	return nil
+}
@@ -0,0 +1,293 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"bufio"
+	"encoding/binary"
+	"fmt"
+	"hash"
+	"hash/fnv"
+	"io"
+	"mhs/src/hansoft"
+	"os"
+	"sort"
+	"time"
+)
+
+// The magic and version of the fingerprint file format.
+// Bump the version whenever the format or the fingerprint hashes change, to
+// invalidate old files.
+const (
+	fingerprintsMagic   = 0x4d485346 // 'MHSF'
+	fingerprintsVersion = 2
+)
+
+// fingerprint is the state of an issue when it was last synchronized
+type fingerprint struct {
+	monorail uint64 // Hash of the monorail issue fields
+	hansoft  uint64 // Hash of the hansoft task fields written
+}
+
+// fingerprintRecord is the on-disk form of a single fingerprint
+type fingerprintRecord struct {
+	ID       uint32
+	Monorail uint64
+	Hansoft  uint64
+}
+
+// syncedRecord is the on-disk form of the syncedFields of a single issue
+type syncedRecord struct {
+	ID     uint32
+	Fields syncedFields
+}
+
+// editRecord is the on-disk form of a single unresolved hansoft field change
+type editRecord struct {
+	ID    uint32
+	Field uint32 // hansoft.FieldMask
+	Time  int64  // UnixNano
+}
+
+// fingerprintHeader is the on-disk header of the fingerprint file. The header
+// is followed by Count fingerprintRecords, Synced syncedRecords and Edits
+// editRecords.
+type fingerprintHeader struct {
+	Magic    uint32
+	Version  uint32
+	Verified int64 // UnixNano of the last full read of the hansoft tasks
+	Count    uint32
+	Synced   uint32
+	Edits    uint32
+}
+
+// LoadFingerprints loads the fingerprints of the last synchronized state of
+// each issue from the file at path, written by SaveFingerprints(). Issues
+// whose monorail fields and hansoft mapping are unchanged since then, and
+// whose hansoft task has not changed, are skipped without reading the task.
+// Changes made to the hansoft tasks while no Syncer was running cannot be
+// detected, so the first Sync() reads all the hansoft tasks. The fingerprints
+// are only trusted by later calls to Sync(), and all the hansoft tasks are
+// read again at least once every verifyInterval.
+// The write-back state is also restored, if write-back is enabled.
+// A missing file is not an error.
+func (s *Syncer) LoadFingerprints(path string, verifyInterval time.Duration) error {
+	s.fingerprints = map[int]fingerprint{}
+	s.verifyInterval = verifyInterval
+	s.watched = false
+
+	file, err := os.Open(path)
+	if err != nil {
+		if os.IsNotExist(err) {
+			return nil
+		}
+		return fmt.Errorf("Failed to load '%v': %w", path, err)
+	}
+	defer file.Close()
+
+	r := bufio.NewReader(file)
+	header := fingerprintHeader{}
+	if err := binary.Read(r, binary.LittleEndian, &header); err != nil {
+		return fmt.Errorf("Failed to parse '%v': %w", path, err)
+	}
+	if header.Magic != fingerprintsMagic || header.Version != fingerprintsVersion {
+		return nil
+	}
+	records := make([]fingerprintRecord, header.Count)
+	synced := make([]syncedRecord, header.Synced)
+	edits := make([]editRecord, header.Edits)
+	for _, data := range []interface{}{records, synced, edits} {
+		if err := binary.Read(r, binary.LittleEndian, data); err != nil {
+			s.fingerprints = map[int]fingerprint{}
+			return fmt.Errorf("Failed to parse '%v': %w", path, err)
+		}
+	}
+	for _, rec := range records {
+		s.fingerprints[int(rec.ID)] = fingerprint{rec.Monorail, rec.Hansoft}
+	}
+	s.verified = time.Unix(0, header.Verified)
+	if s.writeBack {
+		for _, rec := range synced {
+			s.synced[int(rec.ID)] = rec.Fields
+		}
+		for _, rec := range edits {
+			s.recordHansoftEdits(int(rec.ID), hansoft.FieldTimes{hansoft.FieldMask(rec.Field): time.Unix(0, rec.Time)})
+		}
+	}
+	return nil
+}
+
+// SaveFingerprints writes the fingerprints to the file at path. It should
+// only be called once the hansoft writes of the last Sync() have completed.
+func (s *Syncer) SaveFingerprints(path string) error {
+	if s.fingerprints == nil {
+		return nil
+	}
+	records := make([]fingerprintRecord, 0, len(s.fingerprints))
+	for id, fp := range s.fingerprints {
+		records = append(records, fingerprintRecord{uint32(id), fp.monorail, fp.hansoft})
+	}
+	sort.Slice(records, func(a, b int) bool { return records[a].ID < records[b].ID })
+	synced := make([]syncedRecord, 0, len(s.synced))
+	for id, fields := range s.synced {
+		synced = append(synced, syncedRecord{uint32(id), fields})
+	}
+	sort.Slice(synced, func(a, b int) bool { return synced[a].ID < synced[b].ID })
+	edits := []editRecord{}
+	for id, times := range s.hansoftEdits {
+		for f, t := range times {
+			edits = append(edits, editRecord{uint32(id), uint32(f), t.UnixNano()})
+		}
+	}
+
+	tmp := path + ".tmp"
+	file, err := os.Create(tmp)
+	if err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", tmp, err)
+	}
+	w := bufio.NewWriter(file)
+	header := fingerprintHeader{
+		Magic:    fingerprintsMagic,
+		Version:  fingerprintsVersion,
+		Verified: s.verified.UnixNano(),
+		Count:    uint32(len(records)),
+		Synced:   uint32(len(synced)),
+		Edits:    uint32(len(edits)),
+	}
+	err = binary.Write(w, binary.LittleEndian, header)
+	for _, data := range []interface{}{records, synced, edits} {
+		if err == nil {
+			err = binary.Write(w, binary.LittleEndian, data)
+		}
+	}
+	if err == nil {
+		err = w.Flush()
+	}
+	if closeErr := file.Close(); err == nil {
+		err = closeErr
+	}
+	if err == nil {
+		err = os.Rename(tmp, path)
+	}
+	if err != nil {
+		return fmt.Errorf("Failed to write '%v': %w", path, err)
+	}
+	return nil
+}
+
+// trusted returns true if the hansoft task of the monorail issue m can be
+// assumed to be in sync without reading it.
+func (s *Syncer) trusted(m *mIssue) bool {
+	fp, ok := s.fingerprints[m.id]
+	if !ok || fp.monorail != s.monorailFingerprint(m) {
+		return false
+	}
+	target := s.target(m)
+	return fp.hansoft == s.hansoftFingerprint(&target, m.closed)
+}
+
+// recordFingerprint records the synchronized state of the monorail issue and
+// its hansoft task
+func (s *Syncer) recordFingerprint(m *mIssue, h *hIssue) {
+	if s.fingerprints != nil {
+		s.fingerprints[m.id] = fingerprint{s.monorailFingerprint(m), s.hansoftFingerprint(h, m.closed)}
+	}
+	if s.synced != nil {
+		s.recordSynced(m.id, s.monorailValues(m))
+	}
+}
+
+// target returns the hansoft field values that the monorail issue maps to.
+func (s *Syncer) target(m *mIssue) hIssue {
+	h := hIssue{
+		id:                m.id,
+		summary:           m.summary,
+		estimatedDuration: m.estimatedDuration,
+		priority:          hansoft.PriorityMedium,
+		columns:           s.hansoftColumnValues(m),
+	}
+	h.assignee, _ = s.assigneeMap.get(m.assignee)
+	h.status, _ = s.statusMap.get(m.status)
+	if priority, ok := s.priorityMap.get(m.priority); ok {
+		h.priority = hansoft.Priority(priority)
+	}
+	h.milestone, _ = s.milestoneMap.get(m.milestone)
+	h.sprint, _ = s.sprintMap.get(m.sprint)
+	return h
+}
+
+func (s *Syncer) monorailFingerprint(m *mIssue) uint64 {
+	f := fnv.New64a()
+	writeInt(f, int64(m.id))
+	writeString(f, m.summary)
+	writeString(f, s.mEmails.name(m.assignee))
+	writeString(f, s.mStatuses.name(m.status))
+	writeInt(f, int64(m.estimatedDuration/time.Minute))
+	writeString(f, s.mPriorities.name(m.priority))
+	writeString(f, s.mMilestones.name(m.milestone))
+	writeString(f, s.mSprints.name(m.sprint))
+	for _, c := range m.columns {
+		writeString(f, c)
+	}
+	return f.Sum64()
+}
+
+// hansoftFingerprint returns the hash of the task's fields. The assignee,
+// milestone and sprint of closed issues are not synchronized, so are excluded
+// if closed is true.
+func (s *Syncer) hansoftFingerprint(h *hIssue, closed bool) uint64 {
+	f := fnv.New64a()
+	writeInt(f, int64(h.id))
+	writeString(f, h.summary)
+	writeString(f, s.hStatuses.name(h.status))
+	writeInt(f, int64(h.estimatedDuration/time.Minute))
+	writeInt(f, int64(h.priority))
+	if !closed {
+		if r := s.resource(h.assignee); r != nil {
+			writeString(f, r.Email())
+		} else {
+			writeString(f, "")
+		}
+		writeName(f, s.milestone(h.milestone))
+		writeName(f, s.sprint(h.sprint))
+	}
+	for _, c := range h.columns {
+		writeString(f, c)
+	}
+	return f.Sum64()
+}
+
+func writeInt(w io.Writer, i int64) {
+	var b [8]byte
+	binary.LittleEndian.PutUint64(b[:], uint64(i))
+	w.Write(b[:])
+}
+
+// writeString writes the length-prefixed string, so that adjacent strings
+// cannot collide
+func writeString(w hash.Hash64, s string) {
+	writeInt(w, int64(len(s)))
+	io.WriteString(w, s)
+}
+
+// writeName writes the name of the hansoft milestone or sprint n, or an empty
+// string if n is nil
+func writeName(w hash.Hash64, n interface{ Name() (string, error) }) {
+	name := ""
+	if n != nil {
+		name, _ = n.Name()
+	}
+	writeString(w, name)
+}
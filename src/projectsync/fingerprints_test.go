@@ -0,0 +1,208 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io/ioutil"
+	"mhs/src/fake"
+	"path/filepath"
+	"reflect"
+	"testing"
+	"time"
+)
+
+const fingerprintIssues = 20
+
+// newFingerprintedPair returns a new fake project pair, synchronized by a
+// Syncer that saved its fingerprints to the file at path. The pair has a
+// custom column, so untrusted tasks are read rather than compared.
+func newFingerprintedPair(t *testing.T, path string) *fake.Pair {
+	t.Helper()
+	pair := newTestPair(fingerprintIssues, "Component")
+	s := New(pair.Monorail, pair.Hansoft)
+	if err := s.LoadFingerprints(path, time.Hour); err != nil {
+		t.Fatalf("LoadFingerprints() returned %v", err)
+	}
+	mustSync(t, s)
+	if err := s.SaveFingerprints(path); err != nil {
+		t.Fatalf("SaveFingerprints() returned %v", err)
+	}
+	return pair
+}
+
+// newLoadedSyncer returns a Syncer of the pair, with the fingerprints loaded
+// from the file at path
+func newLoadedSyncer(t *testing.T, pair *fake.Pair, path string, verifyInterval time.Duration) *Syncer {
+	t.Helper()
+	s := New(pair.Monorail, pair.Hansoft)
+	if err := s.LoadFingerprints(path, verifyInterval); err != nil {
+		t.Fatalf("LoadFingerprints() returned %v", err)
+	}
+	return s
+}
+
+// readTasks returns the bug IDs of the hansoft tasks read by the Syncer
+func readTasks(s *Syncer) []int {
+	out := []int{}
+	for _, h := range s.issues.rows {
+		if !h.unread {
+			out = append(out, h.id)
+		}
+	}
+	return out
+}
+
+// newVerifiedSyncer returns a Syncer of the pair, with the fingerprints loaded
+// from the file at path, that has performed the full read of the first Sync().
+// The next Sync() re-gathers the hansoft tasks, as if the hansoft metadata had
+// changed.
+func newVerifiedSyncer(t *testing.T, pair *fake.Pair, path string, verifyInterval time.Duration) *Syncer {
+	t.Helper()
+	s := newLoadedSyncer(t, pair, path, verifyInterval)
+	mustSync(t, s)
+	pair.ReloadHansoft()
+	return s
+}
+
+func TestFingerprintsUntrustedAfterLoad(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newLoadedSyncer(t, pair, path, time.Hour)
+	mustSync(t, s)
+	if got := len(readTasks(s)); got != fingerprintIssues {
+		t.Errorf("Read %v tasks, want all %v", got, fingerprintIssues)
+	}
+	if got := phase(s, "write").Issues; got != 0 {
+		t.Errorf("Wrote %v tasks, want 0", got)
+	}
+}
+
+func TestFingerprintsSkipUnchangedTasks(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newVerifiedSyncer(t, pair, path, time.Hour)
+	mustSync(t, s)
+	if got := readTasks(s); len(got) != 0 {
+		t.Errorf("Read tasks %v, want none", got)
+	}
+	if got := phase(s, "write").Issues; got != 0 {
+		t.Errorf("Wrote %v tasks, want 0", got)
+	}
+}
+
+func TestFingerprintsHansoftEditBetweenProcesses(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	pair.EditHansoftDescription(6, "Edited in hansoft", time.Now())
+	pair.DropHansoftChanges()
+	s := newLoadedSyncer(t, pair, path, time.Hour)
+	mustSync(t, s)
+	if got := phase(s, "write").Issues; got != 1 {
+		t.Errorf("Wrote %v tasks, want 1", got)
+	}
+	checkInSync(t, pair)
+}
+
+func TestFingerprintInvalidatedByMonorailEdit(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newVerifiedSyncer(t, pair, path, time.Hour)
+	pair.EditMonorailSummary(3, "Edited in monorail", time.Now())
+	mustSync(t, s)
+	if got, want := readTasks(s), []int{3}; !reflect.DeepEqual(got, want) {
+		t.Errorf("Read tasks %v, want %v", got, want)
+	}
+	if got := descriptions(t, pair)[3]; got != "Edited in monorail" {
+		t.Errorf("Task 3 description is '%v', want the monorail summary", got)
+	}
+}
+
+func TestFingerprintInvalidatedByHansoftMapping(t *testing.T) {
+	// The hansoft values that the monorail issue maps to are not those last
+	// written, as if a hansoft milestone had been renamed
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newVerifiedSyncer(t, pair, path, time.Hour)
+	fp := s.fingerprints[4]
+	fp.hansoft++
+	s.fingerprints[4] = fp
+	mustSync(t, s)
+	if got, want := readTasks(s), []int{4}; !reflect.DeepEqual(got, want) {
+		t.Errorf("Read tasks %v, want %v", got, want)
+	}
+}
+
+func TestFingerprintInvalidatedByHansoftEdit(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newLoadedSyncer(t, pair, path, time.Hour)
+	mustSync(t, s)
+	before := s.fingerprints[5]
+
+	pair.EditHansoftDescription(5, "Edited in hansoft", time.Now())
+	mustSync(t, s)
+	if got := phase(s, "write").Issues; got != 1 {
+		t.Errorf("Wrote %v tasks, want 1", got)
+	}
+	checkInSync(t, pair)
+	if got, ok := s.fingerprints[5]; !ok || got != before {
+		t.Errorf("Task 5 fingerprint is %v (%v), want %v", got, ok, before)
+	}
+}
+
+func TestFingerprintsVerifiedAfterInterval(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	s := newVerifiedSyncer(t, pair, path, 0)
+	mustSync(t, s)
+	if got := len(readTasks(s)); got != fingerprintIssues {
+		t.Errorf("Read %v tasks, want all %v", got, fingerprintIssues)
+	}
+}
+
+func TestFingerprintsIgnoreOtherVersions(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	buf := bytes.Buffer{}
+	binary.Write(&buf, binary.LittleEndian, fingerprintHeader{Magic: fingerprintsMagic, Version: fingerprintsVersion + 1})
+	if err := ioutil.WriteFile(path, buf.Bytes(), 0666); err != nil {
+		t.Fatal(err)
+	}
+	s := newLoadedSyncer(t, pair, path, time.Hour)
+	if got := len(s.fingerprints); got != 0 {
+		t.Errorf("Loaded %v fingerprints, want none", got)
+	}
+}
+
+func TestFingerprintsTruncatedFile(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	pair := newFingerprintedPair(t, path)
+	body, err := ioutil.ReadFile(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := ioutil.WriteFile(path, body[:len(body)-1], 0666); err != nil {
+		t.Fatal(err)
+	}
+	s := New(pair.Monorail, pair.Hansoft)
+	if err := s.LoadFingerprints(path, time.Hour); err == nil {
+		t.Errorf("LoadFingerprints() of a truncated file returned no error")
+	}
+	if got := len(s.fingerprints); got != 0 {
+		t.Errorf("Loaded %v fingerprints, want none", got)
+	}
+}
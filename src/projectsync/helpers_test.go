@@ -0,0 +1,104 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"io/ioutil"
+	"log"
+	"mhs/src/fake"
+	"testing"
+)
+
+// testPrefix is the hyperlink prefix of the tasks of the pairs returned by
+// newTestPair()
+const testPrefix = "crbug.com/test/"
+
+// newTestPair returns a new fake project pair with the given number of
+// issues, and mapped custom columns
+func newTestPair(issues int, columns ...string) *fake.Pair {
+	if !testing.Verbose() {
+		log.SetOutput(ioutil.Discard)
+	}
+	return fake.New("test", fake.Dataset{Issues: issues, Columns: columns, Seed: 1})
+}
+
+// mustSync calls s.Sync(), failing the test if it returns an error
+func mustSync(t *testing.T, s *Syncer) {
+	t.Helper()
+	if err := s.Sync(); err != nil {
+		t.Fatalf("Sync() returned %v", err)
+	}
+}
+
+// phase returns the named phase of the last Sync() by s
+func phase(s *Syncer, name string) Phase {
+	for _, p := range s.LastCycle().Phases {
+		if p.Name == name {
+			return p
+		}
+	}
+	return Phase{Name: name}
+}
+
+// summaries returns the summary of each monorail issue, keyed by bug ID
+func summaries(t *testing.T, pair *fake.Pair) map[int]string {
+	t.Helper()
+	issues, err := pair.Monorail.Issues()
+	if err != nil {
+		t.Fatalf("Issues() returned %v", err)
+	}
+	out := map[int]string{}
+	for _, i := range issues {
+		out[i.ID()] = i.Summary()
+	}
+	return out
+}
+
+// descriptions returns the description of each linked hansoft task, keyed by
+// bug ID, failing the test if a bug ID has more than one task
+func descriptions(t *testing.T, pair *fake.Pair) map[int]string {
+	t.Helper()
+	linked, _, err := pair.Hansoft.LinkedTasks(testPrefix)
+	if err != nil {
+		t.Fatalf("LinkedTasks() returned %v", err)
+	}
+	out := map[int]string{}
+	for _, l := range linked {
+		if _, dup := out[l.ID]; dup {
+			t.Errorf("Bug %v has more than one hansoft task", l.ID)
+		}
+		d, err := l.Task.Description()
+		if err != nil {
+			t.Fatalf("Description() returned %v", err)
+		}
+		out[l.ID] = d
+	}
+	return out
+}
+
+// checkInSync fails the test if the hansoft tasks do not match the monorail
+// issues
+func checkInSync(t *testing.T, pair *fake.Pair) {
+	t.Helper()
+	want, got := summaries(t, pair), descriptions(t, pair)
+	if len(got) != len(want) {
+		t.Errorf("%v hansoft tasks, want %v", len(got), len(want))
+	}
+	for id, summary := range want {
+		if got[id] != summary {
+			t.Errorf("Task %v description is '%v', want '%v'", id, got[id], summary)
+		}
+	}
+}
@@ -0,0 +1,199 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"mhs/src/hansoft"
+	"sort"
+	"time"
+)
+
+// symbol is an interned value, held by a symbolTable or an objectTable.
+// Symbol 0 is always the zero value: the empty string, or nil.
+type symbol int32
+
+// symbolTable interns strings
+type symbolTable struct {
+	names []string
+	ids   map[string]symbol
+}
+
+func newSymbolTable() *symbolTable {
+	return &symbolTable{names: []string{""}, ids: map[string]symbol{"": 0}}
+}
+
+func (t *symbolTable) intern(name string) symbol {
+	if sym, ok := t.ids[name]; ok {
+		return sym
+	}
+	sym := symbol(len(t.names))
+	t.names = append(t.names, name)
+	t.ids[name] = sym
+	return sym
+}
+
+func (t *symbolTable) name(sym symbol) string { return t.names[sym] }
+
+// objectTable interns hansoft resources, milestones and sprints. Objects are
+// compared by identity, as they are by the hansoft package.
+type objectTable struct {
+	values []interface{}
+	ids    map[interface{}]symbol
+}
+
+func newObjectTable() *objectTable {
+	return &objectTable{values: []interface{}{nil}, ids: map[interface{}]symbol{}}
+}
+
+func (t *objectTable) intern(v interface{}) symbol {
+	if v == nil {
+		return 0
+	}
+	if sym, ok := t.ids[v]; ok {
+		return sym
+	}
+	sym := symbol(len(t.values))
+	t.values = append(t.values, v)
+	t.ids[v] = sym
+	return sym
+}
+
+func (t *objectTable) value(sym symbol) interface{} { return t.values[sym] }
+
+// symbolMapping is a lookup array from monorail symbols to hansoft symbols.
+// Each entry is compiled on first use, from the value of the monorail symbol.
+type symbolMapping struct {
+	compile func(from symbol) (to symbol, ok bool)
+	to      []mappedSymbol
+}
+
+type mappedSymbol struct {
+	sym symbol
+	ok  bool // false if the monorail value has no hansoft mapping
+}
+
+// get returns the hansoft symbol of the monorail symbol from, and whether the
+// monorail value has a hansoft mapping. Unmapped values return symbol 0.
+func (m *symbolMapping) get(from symbol) (symbol, bool) {
+	for int(from) >= len(m.to) {
+		to, ok := m.compile(symbol(len(m.to)))
+		m.to = append(m.to, mappedSymbol{to, ok})
+	}
+	e := m.to[from]
+	return e.sym, e.ok
+}
+
+// reset discards the compiled entries. Called when the hansoft symbols are
+// rebuilt.
+func (m *symbolMapping) reset() { m.to = m.to[:0] }
+
+// hIssue is a row of the issueTable. The hansoft values are held as symbols
+// of the Syncer's hansoft tables.
+type hIssue struct {
+	hansoft.Task
+	id                int
+	summary           string
+	assignee          symbol // In Syncer.hResources
+	status            symbol // In Syncer.hStatuses
+	estimatedDuration time.Duration
+	priority          hansoft.Priority
+	milestone         symbol   // In Syncer.hMilestones
+	sprint            symbol   // In Syncer.hSprints
+	columns           []string // Values of Syncer.columns
+	// unread is true if the task's fields have not been read, as the task was
+	// trusted to be in sync by its fingerprint.
+	unread bool
+	// rewrite is true if all the task's fields are to be written, as the last
+	// write failed.
+	rewrite bool
+}
+
+// mIssue is a monorail issue, with the values held as symbols of the Syncer's
+// monorail tables.
+type mIssue struct {
+	id                int
+	summary           string
+	assignee          symbol // In Syncer.mEmails
+	status            symbol // In Syncer.mStatuses
+	closed            bool   // True if status is a closed status
+	estimatedDuration time.Duration
+	priority          symbol   // In Syncer.mPriorities
+	milestone         symbol   // In Syncer.mMilestones
+	sprint            symbol   // In Syncer.mSprints
+	columns           []string // Values of monorail.Project.Columns()
+	modified          time.Time
+}
+
+// issueTable holds the hansoft issues, ordered by bug ID. Rows are held by
+// value in a single slice, so matching the table against the sorted monorail
+// issues is a linear walk, and the table costs a handful of heap objects
+// rather than several per issue. Rows appended by add() are only ordered by
+// the next call to order(), so row indices remain valid until then.
+type issueTable struct {
+	rows []hIssue
+}
+
+// add appends the row to the table, returning its index
+func (t *issueTable) add(h hIssue) int {
+	t.rows = append(t.rows, h)
+	return len(t.rows) - 1
+}
+
+// remove removes the rows with the given bug IDs
+func (t *issueTable) remove(ids map[int]struct{}) {
+	if len(ids) == 0 {
+		return
+	}
+	out := t.rows[:0]
+	for _, h := range t.rows {
+		if _, ok := ids[h.id]; !ok {
+			out = append(out, h)
+		}
+	}
+	for i := len(out); i < len(t.rows); i++ {
+		t.rows[i] = hIssue{} // Release the references
+	}
+	t.rows = out
+}
+
+// order sorts the rows by bug ID. Where there are several rows with the same
+// bug ID, the last added is kept.
+func (t *issueTable) order() {
+	if t.ordered() {
+		return
+	}
+	sort.SliceStable(t.rows, func(a, b int) bool { return t.rows[a].id < t.rows[b].id })
+	out := t.rows[:0]
+	for i, h := range t.rows {
+		if i+1 < len(t.rows) && t.rows[i+1].id == h.id {
+			continue
+		}
+		out = append(out, h)
+	}
+	for i := len(out); i < len(t.rows); i++ {
+		t.rows[i] = hIssue{}
+	}
+	t.rows = out
+}
+
+// ordered returns true if the rows are ordered by bug ID, without duplicates
+func (t *issueTable) ordered() bool {
+	for i := 1; i < len(t.rows); i++ {
+		if t.rows[i-1].id >= t.rows[i].id {
+			return false
+		}
+	}
+	return true
+}
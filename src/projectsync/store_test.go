@@ -0,0 +1,110 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"reflect"
+	"testing"
+)
+
+func TestSymbolTable(t *testing.T) {
+	table := newSymbolTable()
+	if got := table.intern(""); got != 0 {
+		t.Errorf("intern(\"\") returned %v, want 0", got)
+	}
+	a, b := table.intern("a"), table.intern("b")
+	if a == 0 || b == 0 || a == b {
+		t.Errorf("intern() returned %v and %v for distinct names", a, b)
+	}
+	if got := table.intern("a"); got != a {
+		t.Errorf("intern(\"a\") returned %v, then %v", a, got)
+	}
+	if got := table.name(b); got != "b" {
+		t.Errorf("name(%v) returned '%v', want 'b'", b, got)
+	}
+}
+
+func TestObjectTable(t *testing.T) {
+	type object struct{ name string }
+	table := newObjectTable()
+	if got := table.intern(nil); got != 0 {
+		t.Errorf("intern(nil) returned %v, want 0", got)
+	}
+	// Objects are compared by identity, not by value
+	a, b := &object{"same"}, &object{"same"}
+	symA, symB := table.intern(a), table.intern(b)
+	if symA == 0 || symA == symB {
+		t.Errorf("intern() returned %v and %v for distinct objects", symA, symB)
+	}
+	if got := table.intern(a); got != symA {
+		t.Errorf("intern(a) returned %v, then %v", symA, got)
+	}
+	if got := table.value(symB); got != b {
+		t.Errorf("value(%v) returned %v, want %v", symB, got, b)
+	}
+	if got := table.value(0); got != nil {
+		t.Errorf("value(0) returned %v, want nil", got)
+	}
+}
+
+func TestSymbolMapping(t *testing.T) {
+	compiled := 0
+	m := symbolMapping{compile: func(from symbol) (symbol, bool) {
+		compiled++
+		return from * 10, from%2 == 0
+	}}
+	if to, ok := m.get(3); to != 30 || ok {
+		t.Errorf("get(3) returned %v, %v, want 30, false", to, ok)
+	}
+	if to, ok := m.get(2); to != 20 || !ok {
+		t.Errorf("get(2) returned %v, %v, want 20, true", to, ok)
+	}
+	if compiled != 4 {
+		t.Errorf("Compiled %v entries, want 4", compiled)
+	}
+	m.reset()
+	m.get(1)
+	if compiled != 6 {
+		t.Errorf("Compiled %v entries after reset(), want 6", compiled)
+	}
+}
+
+func TestIssueTable(t *testing.T) {
+	ids := func(table *issueTable) []int {
+		out := []int{}
+		for _, h := range table.rows {
+			out = append(out, h.id)
+		}
+		return out
+	}
+	table := &issueTable{}
+	for _, id := range []int{5, 1, 3, 5, 2} {
+		table.add(hIssue{id: id, summary: "row"})
+	}
+	table.order()
+	if got, want := ids(table), []int{1, 2, 3, 5}; !reflect.DeepEqual(got, want) {
+		t.Errorf("Ordered table is %v, want %v", got, want)
+	}
+	if !table.ordered() {
+		t.Errorf("ordered() returned false after order()")
+	}
+	table.remove(map[int]struct{}{2: {}, 5: {}, 7: {}})
+	if got, want := ids(table), []int{1, 3}; !reflect.DeepEqual(got, want) {
+		t.Errorf("Table after remove() is %v, want %v", got, want)
+	}
+	if released := table.rows[:cap(table.rows)][2]; released.summary != "" {
+		t.Errorf("remove() kept the removed row %+v", released)
+	}
+}
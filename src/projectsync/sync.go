@@ -15,16 +15,23 @@
 package projectsync
 
 import (
+	"context"
 	"fmt"
 	"log"
 	"mhs/src/hansoft"
 	"mhs/src/monorail"
-	"strconv"
+	"runtime/pprof"
+	"sort"
 	"strings"
+	"sync"
 	"time"
 )
 
-type sync struct {
+// Syncer synchronizes a monorail and hansoft project.
+// A Syncer can be used to repeatedly synchronize the projects, in which case
+// the hansoft change callbacks are used so that only the hansoft tasks that
+// have changed since the last call to Sync() are re-read.
+type Syncer struct {
 	h                hansoft.Project
 	m                monorail.Project
 	crbugPrefix      string
@@ -35,6 +42,55 @@ type sync struct {
 	milestones       map[string]hansoft.Milestone
 	sprints          map[string]hansoft.Sprint
 	resourcesByEmail map[string]hansoft.Resource
+	columns          []hansoft.CustomColumn // Hansoft columns of the monorail mapped columns
+	columnSources    []int                  // Index of each of columns in monorail.Issue.Columns()
+
+	// Interned monorail values. These live for the lifetime of the Syncer.
+	mEmails, mStatuses, mPriorities, mMilestones, mSprints *symbolTable
+	// Interned hansoft values. The object tables are rebuilt whenever all the
+	// hansoft issues are re-gathered.
+	hStatuses                         *symbolTable
+	hResources, hMilestones, hSprints *objectTable
+	// The mappings from monorail symbols to hansoft symbols, compiled from the
+	// maps above
+	statusMap, priorityMap, assigneeMap, milestoneMap, sprintMap symbolMapping
+
+	issues      *issueTable          // Cached hansoft issues. nil before the first Sync()
+	bugIDs      map[hansoft.Task]int // Bug IDs of the tasks in issues
+	mIssues     []mIssue             // Monorail issues of the current Sync()
+	created     []hIssue             // Issues waiting for a hansoft task to be created
+	createdFrom []*mIssue            // The monorail issues of created
+	sprintLinks []int                // Rows of the issues waiting for their sprint to be set
+	unread      []unreadIssue        // Issues waiting for their untrusted hansoft task to be read
+
+	// Fingerprints of the last synchronized state of each issue, keyed by bug
+	// ID. nil if LoadFingerprints() has not been called.
+	fingerprints   map[int]fingerprint
+	verified       time.Time     // Time of the last full read of the hansoft tasks
+	watched        bool          // True if this Syncer has observed all the hansoft changes since verified
+	verifyInterval time.Duration // Maximum time between full reads
+	verifying      bool          // True if this Sync() performed a full read
+
+	// Write-back of hansoft changes to monorail. See SetWriteBack().
+	writeBack    bool
+	hansoftEdits map[int]hansoft.FieldTimes // Unresolved hansoft changes, keyed by bug ID
+	synced       map[int]syncedFields       // Monorail fields when last synchronized, keyed by bug ID
+	updates      []monorail.IssueUpdate     // Monorail updates waiting to be written
+
+	// Number of monorail issues reconciled at a time. 0 reconciles all the
+	// issues at once. See SetChunkSize().
+	chunkSize int
+
+	trace          *tracer // Phases of the Sync() in progress
+	lastCycleMutex sync.Mutex
+	lastCycle      Cycle // Phases of the last completed Sync()
+}
+
+// unreadIssue is a monorail issue whose hansoft task, at row of the issue
+// table, is to be read by readUnread()
+type unreadIssue struct {
+	m   *mIssue
+	row int
 }
 
 func alternativeEmail(email string) string {
@@ -49,9 +105,15 @@ func alternativeEmail(email string) string {
 	return email
 }
 
-// Sync performs a two-way synchronization of the monorail and hansoft projects
+// Sync performs a one-shot two-way synchronization of the monorail and hansoft
+// projects
 func Sync(m monorail.Project, h hansoft.Project) error {
-	s := sync{
+	return New(m, h).Sync()
+}
+
+// New returns a Syncer for the monorail and hansoft projects
+func New(m monorail.Project, h hansoft.Project) *Syncer {
+	s := &Syncer{
 		m:           m,
 		h:           h,
 		crbugPrefix: "crbug.com/" + m.Name() + "/",
@@ -88,159 +150,810 @@ func Sync(m monorail.Project, h hansoft.Project) error {
 			hansoft.PriorityHigh:     monorail.PriorityHigh,
 			hansoft.PriorityVeryHigh: monorail.PriorityCritical,
 		},
-		milestones:       map[string]hansoft.Milestone{},
-		sprints:          map[string]hansoft.Sprint{},
-		resourcesByEmail: map[string]hansoft.Resource{},
+		mEmails:     newSymbolTable(),
+		mStatuses:   newSymbolTable(),
+		mPriorities: newSymbolTable(),
+		mMilestones: newSymbolTable(),
+		mSprints:    newSymbolTable(),
+		hStatuses:   newSymbolTable(),
+		hResources:  newObjectTable(),
+		hMilestones: newObjectTable(),
+		hSprints:    newObjectTable(),
 	}
-	for _, r := range h.Resources() {
-		if email := r.Email(); email != "" {
-			s.resourcesByEmail[email] = r
-			s.resourcesByEmail[alternativeEmail(email)] = r
-		}
+	s.statusMap.compile = func(from symbol) (symbol, bool) {
+		status, ok := s.statusMtoH[monorail.Status(s.mStatuses.name(from))]
+		return s.hStatuses.intern(status), ok
 	}
-	for _, m := range h.Milestones() {
-		name, err := m.Name()
-		if err != nil {
-			return err
+	s.priorityMap.compile = func(from symbol) (symbol, bool) {
+		priority, ok := s.priorityMtoH[monorail.Priority(s.mPriorities.name(from))]
+		return symbol(priority), ok // The hansoft priority value
+	}
+	s.assigneeMap.compile = func(from symbol) (symbol, bool) {
+		r, ok := s.resourcesByEmail[s.mEmails.name(from)]
+		return s.hResources.intern(r), ok
+	}
+	s.milestoneMap.compile = func(from symbol) (symbol, bool) {
+		m, ok := s.milestones[s.mMilestones.name(from)]
+		return s.hMilestones.intern(m), ok
+	}
+	s.sprintMap.compile = func(from symbol) (symbol, bool) {
+		sprint, ok := s.sprints[s.mSprints.name(from)]
+		return s.hSprints.intern(sprint), ok
+	}
+	return s
+}
+
+// LoadTaskIndex loads the index of the hansoft tasks linked to monorail
+// issues from the file at path, written by SaveTaskIndex(). With the index,
+// only the hansoft tasks created or relinked since the index was written
+// have their hyperlinks read when gathering the hansoft issues. The index is
+// rebuilt from all the hyperlinks once it is older than rebuildInterval.
+func (s *Syncer) LoadTaskIndex(path string, rebuildInterval time.Duration) error {
+	return s.h.Backlog().LoadIndex(path, s.crbugPrefix, rebuildInterval)
+}
+
+// RebuildTaskIndex makes the next gather of the hansoft issues read all the
+// hyperlinks, rebuilding the index loaded by LoadTaskIndex()
+func (s *Syncer) RebuildTaskIndex() {
+	s.h.Backlog().RebuildIndex()
+}
+
+// SaveTaskIndex writes the index loaded by LoadTaskIndex() to the file at path.
+func (s *Syncer) SaveTaskIndex(path string) error {
+	return s.h.Backlog().SaveIndex(path)
+}
+
+// SetChunkSize sets the number of issues reconciled at a time. With a chunk
+// size of n, the monorail issues are diffed and written as they are streamed,
+// n at a time. The hansoft tasks of each chunk are looked up by bug ID in the
+// issue table, built from the task index when loaded, and are read when their
+// chunk is reconciled, then released. Only a chunk of issues and task values
+// is held in memory at once, along with the task and bug ID of each linked
+// hansoft task. The hansoft reads and writes are batched per chunk, spread
+// over the reader sessions, so smaller chunks make more hansoft calls. As the
+// task values are released, the tasks without a trusted fingerprint are read
+// again by each Sync(). If fetching the monorail issues fails part way, the
+// chunks fetched before the failure have already been written when Sync()
+// returns the error. A chunk size of 0, the default, reconciles all the
+// issues at once, and writes nothing if the fetch fails.
+func (s *Syncer) SetChunkSize(n int) {
+	s.chunkSize = n
+}
+
+// Sync performs a two-way synchronization of the monorail and hansoft projects.
+// Each Sync() is timed phase by phase, see LastCycle(), and the goroutines
+// running each phase are given 'project' and 'phase' pprof labels.
+func (s *Syncer) Sync() (err error) {
+	pprof.Do(context.Background(), pprof.Labels("project", s.m.Name()), func(ctx context.Context) {
+		s.trace = newTracer(ctx, s.m.Name())
+		err = s.syncCycle()
+		cycle := s.trace.finish(err)
+		s.lastCycleMutex.Lock()
+		s.lastCycle = cycle
+		s.lastCycleMutex.Unlock()
+	})
+	return err
+}
+
+// syncCycle performs the synchronization of Sync(), recording its phases in
+// s.trace
+func (s *Syncer) syncCycle() error {
+	start := time.Now()
+	s.verifying = false
+	t := s.trace
+
+	// The monorail issues are streamed and interned while the hansoft issues
+	// are gathered. Once both are complete, the issues are matched by bug ID.
+	issues := make(chan monorail.Issue, monorailStreamBuffer)
+	mErr := make(chan error, 1)
+	go func() {
+		t.label("monorail-stream")
+		mErr <- s.m.IssuesStream(issues)
+	}()
+
+	hErr := make(chan error, 1)
+	go func() {
+		span := t.begin("hansoft-gather")
+		err := s.updateHansoftIssues()
+		if err == nil {
+			span.end(len(s.issues.rows))
+		}
+		hErr <- err
+	}()
+
+	// drain consumes the rest of the monorail stream after a hansoft error, so
+	// that the IssuesStream() goroutine can finish. issues is nil once the
+	// stream is complete, and ranging over a nil channel would block forever.
+	drain := func() {
+		if issues != nil {
+			go func() {
+				for range issues {
+				}
+			}()
 		}
-		s.milestones[name] = m
 	}
-	for _, m := range h.Sprints() {
-		name, err := m.Name()
-		if err != nil {
-			return err
+
+	stream := t.begin("monorail-stream")
+	streamed := 0
+	s.mIssues = s.mIssues[:0]
+	for hDone := hErr; hDone != nil || issues != nil; {
+		select {
+		case err := <-hDone:
+			if err != nil {
+				drain()
+				return err
+			}
+			hDone = nil
+		case i, ok := <-issues:
+			if !ok {
+				issues = nil // Stream complete
+				stream.end(streamed)
+				continue
+			}
+			s.mIssues = append(s.mIssues, s.internIssue(i))
+			streamed++
+			if s.chunkSize > 0 && len(s.mIssues) >= s.chunkSize {
+				// The chunk can only be matched once all the hansoft issues
+				// have been gathered
+				if hDone != nil {
+					if err := <-hDone; err != nil {
+						drain()
+						return err
+					}
+					hDone = nil
+				}
+				// The stream is not timed while the chunk is reconciled
+				stream.end(streamed)
+				streamed = 0
+				s.reconcile()
+				s.releaseChunk()
+				s.mIssues = s.mIssues[:0]
+				stream = t.begin("monorail-stream")
+			}
 		}
-		s.sprints[name] = m
 	}
+	// An incomplete stream is not reconciled, as the missing issues would be
+	// created in hansoft. In chunked mode, the chunks streamed before the
+	// error have already been reconciled.
+	if err := <-mErr; err != nil {
+		return fmt.Errorf("Failed to fetch monorail issues: %w", err)
+	}
+	s.reconcile()
+	if s.chunkSize > 0 {
+		s.releaseChunk()
+	}
+	stats := s.m.StreamStats()
+	t.add(Phase{"monorail-search", stats.SearchTime, stats.Issues})
+	t.add(Phase{"monorail-users", stats.UserTime, stats.Users})
+	if s.verifying {
+		s.verified = start
+		s.watched = true
+	}
+	return nil
+}
+
+// reconcile synchronizes the monorail issues in s.mIssues with the hansoft
+// issue table: matching and diffing the issues, then performing the queued
+// hansoft reads, creations and writes, and monorail updates.
+func (s *Syncer) reconcile() {
+	t := s.trace
+	span := t.begin("diff")
+	s.mergeIssues()
+	span.end(len(s.mIssues))
+
+	span = t.begin("read-unread")
+	unread := len(s.unread)
+	s.readUnread()
+	span.end(unread)
+
+	span = t.begin("create")
+	created := len(s.created)
+	s.createHansoftIssues()
+	span.end(created)
+
+	span = t.begin("sprints")
+	sprints := len(s.sprintLinks)
+	s.setHansoftSprints()
+	span.end(sprints)
+
+	span = t.begin("write-back")
+	updates := len(s.updates)
+	s.writeMonorailIssues()
+	span.end(updates)
 
-	hIssues, err := s.gatherHansoftIssues(h)
+	span = t.begin("order")
+	s.issues.order()
+	span.end(created)
+}
+
+// updateHansoftIssues brings the cached hansoft issues up to date, either by
+// applying the changes made since the last Sync(), or by re-gathering all the
+// issues. When re-gathering, the hansoft metadata maps are rebuilt
+// concurrently.
+func (s *Syncer) updateHansoftIssues() error {
+	changes, err := s.h.Changes()
 	if err != nil {
-		return err
+		return fmt.Errorf("Failed to fetch hansoft changes: %w", err)
+	}
+	if s.issues != nil && !changes.Reloaded {
+		return s.applyHansoftChanges(changes)
+	}
+
+	// The hansoft objects are re-interned by gatherHansoftIssues(), so the
+	// mappings to them are recompiled.
+	s.hResources, s.hMilestones, s.hSprints = newObjectTable(), newObjectTable(), newObjectTable()
+	s.assigneeMap.reset()
+	s.milestoneMap.reset()
+	s.sprintMap.reset()
+
+	metadataErr := make(chan error, 1)
+	go func() { metadataErr <- s.loadMetadata() }()
+
+	issues, err := s.gatherHansoftIssues(s.h)
+	if mdErr := <-metadataErr; err == nil {
+		err = mdErr
 	}
-	mIssues, err := s.gatherMonorailIssues(m)
 	if err != nil {
+		s.issues = nil
 		return err
 	}
+	s.issues = issues
+	s.bugIDs = make(map[hansoft.Task]int, len(issues.rows))
+	for _, h := range issues.rows {
+		s.bugIDs[h.Task] = h.id
+	}
+	for t, times := range changes.FieldTimes {
+		if id, ok := s.bugIDs[t]; ok {
+			s.recordHansoftEdits(id, times)
+		}
+	}
+	return nil
+}
 
-	for id, m := range mIssues {
-		h, exists := hIssues[id]
-		if exists {
-			diffs := s.diff(h, m)
-			if len(diffs) == 0 {
-				continue // in sync
-			}
-			log.Printf("Updating hansoft task %s%v. Diffs: %v\n", s.crbugPrefix, m.id, diffs)
+// internIssue returns the monorail issue with its values interned
+func (s *Syncer) internIssue(i monorail.Issue) mIssue {
+	status := i.Status()
+	return mIssue{
+		id:                i.ID(),
+		summary:           i.Summary(),
+		assignee:          s.mEmails.intern(i.Assignee()),
+		status:            s.mStatuses.intern(string(status)),
+		closed:            status.IsClosed(),
+		estimatedDuration: i.EstimatedDuration(),
+		priority:          s.mPriorities.intern(string(i.Priority())),
+		milestone:         s.mMilestones.intern(i.Milestone()),
+		sprint:            s.mSprints.intern(i.Sprint()),
+		columns:           i.Columns(),
+		modified:          i.ModifyTime(),
+	}
+}
+
+// mergeIssues sorts the monorail issues by bug ID, and walks them alongside
+// the hansoft issue table from the row of the lowest bug ID, synchronizing
+// each.
+func (s *Syncer) mergeIssues() {
+	if len(s.mIssues) == 0 {
+		return
+	}
+	sort.Slice(s.mIssues, func(a, b int) bool { return s.mIssues[a].id < s.mIssues[b].id })
+	rows := s.issues.rows
+	first := s.mIssues[0].id
+	row := sort.Search(len(rows), func(r int) bool { return rows[r].id >= first })
+	for i := range s.mIssues {
+		m := &s.mIssues[i]
+		for row < len(rows) && rows[row].id < m.id {
+			row++
+		}
+		if row < len(rows) && rows[row].id == m.id {
+			s.syncIssue(m, row)
 		} else {
-			h = &hIssue{}
-			hIssues[id] = h
-			log.Printf("Creating hansoft task %s%v: %v\n", s.crbugPrefix, m.id, m.summary)
+			s.createIssue(m)
 		}
+	}
+}
 
-		if status, ok := s.statusMtoH[m.status]; ok {
-			h.status = status
-		} else {
-			warn("Don't know how to translate monorail status '%v' to hansoft", m.status)
+// releaseChunk drops the hansoft field values read for the issues of the
+// reconciled chunk, so that only a chunk of task values is held at once. The
+// released tasks are read again by the next Sync(), unless their fingerprints
+// are trusted.
+func (s *Syncer) releaseChunk() {
+	if len(s.mIssues) == 0 {
+		return
+	}
+	rows := s.issues.rows
+	first := s.mIssues[0].id
+	row := sort.Search(len(rows), func(r int) bool { return rows[r].id >= first })
+	for i := range s.mIssues {
+		id := s.mIssues[i].id
+		for row < len(rows) && rows[row].id < id {
+			row++
 		}
+		if row < len(rows) && rows[row].id == id && !rows[row].unread && !rows[row].rewrite {
+			rows[row] = hIssue{Task: rows[row].Task, id: id, unread: true}
+		}
+	}
+}
 
-		if priority, ok := s.priorityMtoH[m.priority]; ok {
-			h.priority = priority
-		} else {
-			warn("Don't know how to translate monorail priority '%v' to hansoft", m.priority)
-			h.priority = hansoft.PriorityMedium
+// syncIssue updates the hansoft task at the issues row with the monorail
+// issue, which has the same bug ID.
+func (s *Syncer) syncIssue(m *mIssue, row int) {
+	h := &s.issues.rows[row]
+	if h.unread {
+		if s.trusted(m) {
+			return // in sync
 		}
+		// Read with the other untrusted tasks by readUnread()
+		s.unread = append(s.unread, unreadIssue{m, row})
+		return
+	}
+	diffs := s.diff(h, m)
+	var won []issueDiff
+	if s.writeBack {
+		diffs, won = s.resolveConflicts(h, m, diffs)
+	}
+	if len(diffs) == 0 {
+		if len(won) == 0 {
+			s.recordFingerprint(m, h)
+		}
+		return // in sync, or waiting for the monorail write-back
+	}
+	log.Printf("Updating hansoft task %s%v. Diffs: %v\n", s.crbugPrefix, m.id, diffs)
+	saved := *h
+	s.assign(h, m)
+	keepHansoftValues(h, &saved, won)
+	s.writeHansoftIssue(m, row, diffs, saved.columns)
+}
 
-		if m.milestone != "" {
-			h.milestone = s.milestones[m.milestone]
-			if h.milestone == nil {
-				warn("Hansoft does not contain sprint '%v'", m.sprint)
-			}
+// createIssue queues the creation of the hansoft task of the monorail issue
+func (s *Syncer) createIssue(m *mIssue) {
+	log.Printf("Creating hansoft task %s%v: %v\n", s.crbugPrefix, m.id, m.summary)
+	h := hIssue{}
+	s.assign(&h, m)
+	// Tasks are created in bulk by createHansoftIssues()
+	s.created = append(s.created, h)
+	s.createdFrom = append(s.createdFrom, m)
+}
+
+// assign sets the fields of h to the hansoft values of the monorail issue
+func (s *Syncer) assign(h *hIssue, m *mIssue) {
+	if status, ok := s.statusMap.get(m.status); ok {
+		h.status = status
+	} else {
+		warn("Don't know how to translate monorail status '%v' to hansoft", s.mStatuses.name(m.status))
+	}
+
+	if priority, ok := s.priorityMap.get(m.priority); ok {
+		h.priority = hansoft.Priority(priority)
+	} else {
+		warn("Don't know how to translate monorail priority '%v' to hansoft", s.mPriorities.name(m.priority))
+		h.priority = hansoft.PriorityMedium
+	}
+
+	if m.milestone != 0 {
+		var ok bool
+		if h.milestone, ok = s.milestoneMap.get(m.milestone); !ok {
+			warn("Hansoft does not contain milestone '%v'", s.mMilestones.name(m.milestone))
 		}
+	}
 
-		if m.sprint != "" {
-			h.sprint = s.sprints[m.sprint]
-			if h.sprint == nil {
-				warn("Hansoft does not contain sprint '%v'", m.sprint)
-			}
+	if m.sprint != 0 {
+		var ok bool
+		if h.sprint, ok = s.sprintMap.get(m.sprint); !ok {
+			warn("Hansoft does not contain sprint '%v'", s.mSprints.name(m.sprint))
 		}
+	}
+
+	h.id = m.id
+	h.summary = m.summary
+	h.assignee, _ = s.assigneeMap.get(m.assignee)
+	h.estimatedDuration = m.estimatedDuration
+	h.columns = s.hansoftColumnValues(m)
 
-		h.id = m.id
-		h.summary = m.summary
-		h.assignee = s.resourcesByEmail[m.assignee]
-		h.estimatedDuration = m.estimatedDuration
+	if h.assignee == 0 && m.assignee != 0 && !m.closed {
+		warn("Hansoft project does not have a user with address '%v'", s.mEmails.name(m.assignee))
+	}
+}
+
+// writeHansoftIssue calls updateHansoftIssue(), forcing a full rewrite of
+// the task on the next Sync() if it fails.
+func (s *Syncer) writeHansoftIssue(m *mIssue, row int, diffs []issueDiff, columns []string) {
+	defer s.trace.wrote(time.Now())
+	h := &s.issues.rows[row]
+	if err := s.updateHansoftIssue(row, diffs, columns); err != nil {
+		warn("%v", err)
+		*h = hIssue{Task: h.Task, id: h.id, rewrite: true}
+		delete(s.fingerprints, h.id)
+		return
+	}
+	h.rewrite = false
+	s.recordFingerprint(m, h)
+}
 
-		if h.assignee == nil && m.assignee != "" && !m.status.IsClosed() {
-			warn("Hansoft project does not have a user with address '%v'", m.assignee)
+// readUnread compares or reads the hansoft tasks of the issues queued by
+// syncIssue() in a single batch, and synchronizes them.
+func (s *Syncer) readUnread() {
+	if len(s.unread) == 0 {
+		return
+	}
+	unread := s.unread
+	s.unread = nil
+	if len(s.columns) == 0 {
+		// Custom columns cannot be compared, Snapshot() is needed for those
+		if unread = s.compareUnread(unread); len(unread) == 0 {
+			return
+		}
+	}
+	tasks := make([]hansoft.Task, len(unread))
+	for i, u := range unread {
+		tasks[i] = s.issues.rows[u.row].Task
+	}
+	snapshots, err := s.h.Backlog().Snapshot(tasks, s.columns...)
+	if err != nil {
+		warn("Failed to fetch hansoft task fields: %w", err)
+		return
+	}
+	for i, snap := range snapshots {
+		u := unread[i]
+		if snap.Err != nil {
+			warn("%v%v: %w", s.crbugPrefix, u.m.id, snap.Err)
+			continue
 		}
+		s.issues.rows[u.row] = s.hIssueFromSnapshot(u.m.id, snap)
+		s.syncIssue(u.m, u.row)
+	}
+}
 
-		if err := s.updateHansoftIssue(h); err != nil {
-			warn("%v", err)
+// compareUnread compares the hansoft tasks of the unread issues against the
+// monorail issues without reading their fields. The tasks that are in sync are
+// marked as trusted, and the mismatched fields of the others are written.
+// The issues whose hansoft edits may be written back to monorail are returned,
+// as resolving the conflicts needs the hansoft values.
+func (s *Syncer) compareUnread(unread []unreadIssue) []unreadIssue {
+	expected := make([]hansoft.TaskExpected, len(unread))
+	for i, u := range unread {
+		expected[i] = s.expected(u.m, s.issues.rows[u.row].Task)
+	}
+	masks, err := s.h.Backlog().Compare(expected)
+	if err != nil {
+		warn("Failed to compare hansoft task fields: %w", err)
+		return unread
+	}
+	edited := []unreadIssue{}
+	for i, u := range unread {
+		h := &s.issues.rows[u.row]
+		if masks[i] == 0 {
+			*h = s.comparand(u.m)
+			h.Task = expected[i].Task
+			h.unread = true
+			s.recordFingerprint(u.m, h)
+			continue
+		}
+		if _, ok := s.hansoftEdits[u.m.id]; ok {
+			edited = append(edited, u)
+			continue
 		}
+		diffs := maskDiffs(masks[i])
+		log.Printf("Updating hansoft task %s%v. Diffs: %v\n", s.crbugPrefix, u.m.id, diffs)
+		*h = hIssue{Task: expected[i].Task}
+		s.assign(h, u.m)
+		s.writeHansoftIssue(u.m, u.row, diffs, nil)
 	}
+	return edited
+}
+
+// compareDiffs maps the fields reported by Backlog().Compare() to the
+// issueDiffs that write them, in the order of allDiffs
+var compareDiffs = []struct {
+	field hansoft.FieldMask
+	diff  issueDiff
+}{
+	{hansoft.FieldDescription, diffSummary},
+	{hansoft.FieldAssignee, diffAssignee},
+	{hansoft.FieldStatus, diffStatus},
+	{hansoft.FieldEstimatedDuration, diffDuration},
+	{hansoft.FieldPriority, diffPriority},
+	{hansoft.FieldMilestone, diffMilestone},
+	{hansoft.FieldSprint, diffSprint},
+}
 
+// maskDiffs returns the issueDiffs of the mismatched fields in mask
+func maskDiffs(mask hansoft.FieldMask) []issueDiff {
+	diffs := []issueDiff{}
+	for _, c := range compareDiffs {
+		if mask&c.field != 0 {
+			diffs = append(diffs, c.diff)
+		}
+	}
+	return diffs
+}
+
+// comparand returns the hansoft issue that diff() finds no differences with for
+// the monorail issue. The Task and columns are not set.
+func (s *Syncer) comparand(m *mIssue) hIssue {
+	h := hIssue{
+		id:                m.id,
+		summary:           m.summary,
+		estimatedDuration: m.estimatedDuration,
+	}
+	h.status, _ = s.statusMap.get(m.status)
+	h.assignee, _ = s.assigneeMap.get(m.assignee)
+	priority, _ := s.priorityMap.get(m.priority)
+	h.priority = hansoft.Priority(priority)
+	h.milestone, _ = s.milestoneMap.get(m.milestone)
+	h.sprint, _ = s.sprintMap.get(m.sprint)
+	return h
+}
+
+// expected returns the hansoft field values that diff() compares the task of
+// the monorail issue against. The fields that diff() does not compare are
+// ignored.
+func (s *Syncer) expected(m *mIssue, t hansoft.Task) hansoft.TaskExpected {
+	h := s.comparand(m)
+	e := hansoft.TaskExpected{
+		Task:              t,
+		Description:       h.summary,
+		Assignee:          s.resource(h.assignee),
+		Status:            s.hStatuses.name(h.status),
+		EstimatedDuration: h.estimatedDuration,
+		Priority:          h.priority,
+		Milestone:         s.milestone(h.milestone),
+		Sprint:            s.sprint(h.sprint),
+		Ignore:            hansoft.FieldHyperlink, // The task was found by its hyperlink
+	}
+	if m.closed {
+		e.Ignore |= hansoft.FieldAssignee | hansoft.FieldMilestone | hansoft.FieldSprint
+	}
+	return e
+}
+
+// createHansoftIssues creates the hansoft tasks for all the issues queued by
+// createIssue(), and writes their fields.
+func (s *Syncer) createHansoftIssues() {
+	if len(s.created) == 0 {
+		return
+	}
+	tasks, err := s.h.Backlog().NewTasks(len(s.created))
+	if err != nil {
+		warn("Failed to create new hansoft tasks: %w", err)
+	}
+	// Only the fields that differ from the new tasks' defaults are written
+	snapshots, err := s.h.Backlog().Snapshot(tasks, s.columns...)
+	if err != nil {
+		warn("Failed to fetch new hansoft task fields: %w", err)
+		snapshots = nil
+	}
+	rows := make([]int, 0, len(tasks))
+	for i, h := range s.created {
+		if i >= len(tasks) {
+			break
+		}
+		h.Task = tasks[i]
+		s.bugIDs[h.Task] = h.id
+		rows = append(rows, s.issues.add(h))
+	}
+	for i, row := range rows {
+		m := s.createdFrom[i]
+		if snapshots == nil || snapshots[i].Err != nil {
+			s.writeHansoftIssue(m, row, allDiffs, nil)
+			continue
+		}
+		fresh := s.hIssueFromSnapshot(0, snapshots[i])
+		s.writeHansoftIssue(m, row, s.diff(&fresh, m), fresh.columns)
+	}
+	s.created = nil
+	s.createdFrom = nil
+}
+
+// loadMetadata (re)builds the maps of hansoft resources, milestones and sprints
+func (s *Syncer) loadMetadata() error {
+	resources, err := s.h.Resources()
+	if err != nil {
+		return fmt.Errorf("Failed to get hansoft resources: %w", err)
+	}
+	milestones, err := s.h.Milestones()
+	if err != nil {
+		return fmt.Errorf("Failed to get hansoft milestones: %w", err)
+	}
+	sprints, err := s.h.Sprints()
+	if err != nil {
+		return fmt.Errorf("Failed to get hansoft sprints: %w", err)
+	}
+
+	s.milestones = map[string]hansoft.Milestone{}
+	s.sprints = map[string]hansoft.Sprint{}
+	s.resourcesByEmail = map[string]hansoft.Resource{}
+	for _, r := range resources {
+		if email := r.Email(); email != "" {
+			s.resourcesByEmail[email] = r
+			s.resourcesByEmail[alternativeEmail(email)] = r
+		}
+	}
+	for _, m := range milestones {
+		name, err := m.Name()
+		if err != nil {
+			return err
+		}
+		s.milestones[name] = m
+	}
+	for _, m := range sprints {
+		name, err := m.Name()
+		if err != nil {
+			return err
+		}
+		s.sprints[name] = m
+	}
 	return nil
 }
 
-func (s *sync) diff(h *hIssue, m *mIssue) []issueDiff {
+// resource returns the hansoft resource with the symbol, or nil for symbol 0
+func (s *Syncer) resource(sym symbol) hansoft.Resource {
+	r, _ := s.hResources.value(sym).(hansoft.Resource)
+	return r
+}
+
+// milestone returns the hansoft milestone with the symbol, or nil for symbol 0
+func (s *Syncer) milestone(sym symbol) hansoft.Milestone {
+	m, _ := s.hMilestones.value(sym).(hansoft.Milestone)
+	return m
+}
+
+// sprint returns the hansoft sprint with the symbol, or nil for symbol 0
+func (s *Syncer) sprint(sym symbol) hansoft.Sprint {
+	sprint, _ := s.hSprints.value(sym).(hansoft.Sprint)
+	return sprint
+}
+
+func (s *Syncer) diff(h *hIssue, m *mIssue) []issueDiff {
+	if h.rewrite {
+		return allDiffs
+	}
+	e := s.comparand(m)
 	diffs := []issueDiff{}
-	if h.id != m.id {
+	if h.id != e.id {
 		diffs = append(diffs, diffID)
 	}
-	if h.summary != m.summary {
+	if h.summary != e.summary {
 		diffs = append(diffs, diffSummary)
 	}
-	if h.status != s.statusMtoH[m.status] {
+	if h.status != e.status {
 		diffs = append(diffs, diffStatus)
 	}
-	if h.assignee != s.resourcesByEmail[m.assignee] && !m.status.IsClosed() {
+	if h.assignee != e.assignee && !m.closed {
 		diffs = append(diffs, diffAssignee)
 	}
-	if (h.estimatedDuration / time.Minute) != (m.estimatedDuration / time.Minute) {
+	if (h.estimatedDuration / time.Minute) != (e.estimatedDuration / time.Minute) {
 		diffs = append(diffs, diffDuration)
 	}
-	if h.priority != s.priorityMtoH[m.priority] {
+	if h.priority != e.priority {
 		diffs = append(diffs, diffPriority)
 	}
-	if h.milestone != s.milestones[m.milestone] && !m.status.IsClosed() {
+	if h.milestone != e.milestone && !m.closed {
 		diffs = append(diffs, diffMilestone)
 	}
-	if h.sprint != s.sprints[m.sprint] && !m.status.IsClosed() {
+	if h.sprint != e.sprint && !m.closed {
 		diffs = append(diffs, diffSprint)
 	}
+	if len(s.columns) > 0 && !s.columnsEqual(h, m) {
+		diffs = append(diffs, diffColumns)
+	}
 	return diffs
 }
 
-func (s *sync) updateHansoftIssue(i *hIssue) error {
-	if i.Task == nil {
-		task, err := s.h.Backlog().NewTask()
-		if err != nil {
-			return fmt.Errorf("Failed to create new hansoft task: %w", err)
+// resolveColumns finds the hansoft custom columns of the monorail project's
+// mapped columns
+func (s *Syncer) resolveColumns() error {
+	s.columns, s.columnSources = nil, nil
+	names := s.m.Columns()
+	if len(names) == 0 {
+		return nil
+	}
+	columns, err := s.h.CustomColumns()
+	if err != nil {
+		return fmt.Errorf("Failed to get hansoft custom columns: %w", err)
+	}
+	for i, name := range names {
+		found := false
+		for _, c := range columns {
+			if strings.EqualFold(c.Name, name) {
+				s.columns = append(s.columns, c)
+				s.columnSources = append(s.columnSources, i)
+				found = true
+				break
+			}
+		}
+		if !found {
+			warn("Hansoft project does not have a custom column '%v'", name)
 		}
-		i.Task = task
 	}
-	if err := i.Task.SetDescription(i.summary); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task description: %w", err)
+	return nil
+}
+
+// hansoftColumnValues returns the values of the monorail issue's mapped
+// columns, in the order of s.columns
+func (s *Syncer) hansoftColumnValues(m *mIssue) []string {
+	if len(s.columns) == 0 {
+		return nil
 	}
-	hyperlink := fmt.Sprintf("%s%v", s.crbugPrefix, i.id)
-	if err := i.Task.SetHyperlink(hyperlink); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task hyperlink: %w", err)
+	out := make([]string, len(s.columns))
+	for i, src := range s.columnSources {
+		out[i] = m.columns[src]
 	}
-	if err := i.Task.SetAssignee(i.assignee); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task assignee: %w", err)
+	return out
+}
+
+func (s *Syncer) columnsEqual(h *hIssue, m *mIssue) bool {
+	if len(h.columns) != len(s.columns) {
+		return false
 	}
-	if err := i.Task.SetStatus(i.status); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task status: %w", err)
+	for i, src := range s.columnSources {
+		if h.columns[i] != m.columns[src] {
+			return false
+		}
 	}
-	if err := i.Task.SetEstimatedDuration(i.estimatedDuration); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task status: %w", err)
+	return true
+}
+
+// setHansoftSprints sets the sprints of all the issues queued by
+// updateHansoftIssue()
+func (s *Syncer) setHansoftSprints() {
+	if len(s.sprintLinks) == 0 {
+		return
 	}
-	if err := i.Task.SetPriority(i.priority); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task status: %w", err)
+	sprints := make(map[hansoft.Task]hansoft.Sprint, len(s.sprintLinks))
+	for _, row := range s.sprintLinks {
+		h := &s.issues.rows[row]
+		sprints[h.Task] = s.sprint(h.sprint)
 	}
-	if err := i.Task.SetMilestone(i.milestone); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task milestone: %w", err)
+	if err := s.h.SetSprints(sprints); err != nil {
+		warn("Failed to set hansoft task sprints: %w", err)
+		for _, row := range s.sprintLinks {
+			h := &s.issues.rows[row]
+			h.sprint = 0 // Retry on the next Sync()
+			delete(s.fingerprints, h.id)
+		}
 	}
-	if err := i.Task.SetSprint(i.sprint); err != nil {
-		return fmt.Errorf("Failed to set new hansoft task sprint: %w", err)
+	s.sprintLinks = nil
+}
+
+// updateHansoftIssue writes the fields listed in diffs to the hansoft task at
+// the issues row. columns holds the task's custom column values before the
+// write, so that only the changed columns are written, or is nil to write all
+// the columns.
+func (s *Syncer) updateHansoftIssue(row int, diffs []issueDiff, columns []string) error {
+	i := &s.issues.rows[row]
+	for _, d := range diffs {
+		var err error
+		switch d {
+		case diffSummary:
+			err = i.Task.SetDescription(i.summary)
+		case diffID:
+			err = i.Task.SetHyperlink(fmt.Sprintf("%s%v", s.crbugPrefix, i.id))
+		case diffAssignee:
+			err = i.Task.SetAssignee(s.resource(i.assignee))
+		case diffStatus:
+			err = i.Task.SetStatus(s.hStatuses.name(i.status))
+		case diffDuration:
+			err = i.Task.SetEstimatedDuration(i.estimatedDuration)
+		case diffPriority:
+			err = i.Task.SetPriority(i.priority)
+		case diffMilestone:
+			err = i.Task.SetMilestone(s.milestone(i.milestone))
+		case diffSprint:
+			// Sprints are set in bulk by setHansoftSprints()
+			s.sprintLinks = append(s.sprintLinks, row)
+		case diffColumns:
+			for c, column := range s.columns {
+				if len(columns) == len(s.columns) && columns[c] == i.columns[c] {
+					continue // Unchanged
+				}
+				if err = i.Task.SetCustomColumn(column, i.columns[c]); err != nil {
+					break
+				}
+			}
+		}
+		if err != nil {
+			return fmt.Errorf("Failed to set hansoft task %v: %w", d, err)
+		}
 	}
 	return nil
 }
@@ -256,127 +969,191 @@ const (
 	diffPriority  issueDiff = "priority"
 	diffMilestone issueDiff = "milestone"
 	diffSprint    issueDiff = "sprint"
+	diffColumns   issueDiff = "columns"
 )
 
-type hIssue struct {
-	hansoft.Task
-	id                int
-	summary           string
-	assignee          hansoft.Resource
-	status            hansoft.Status
-	estimatedDuration time.Duration
-	priority          hansoft.Priority
-	milestone         hansoft.Milestone
-	sprint            hansoft.Sprint
-}
-
-type mIssue struct {
-	monorail.Issue
-	id                int
-	summary           string
-	assignee          string
-	status            monorail.Status
-	estimatedDuration time.Duration
-	priority          monorail.Priority
-	milestone         string
-	sprint            string
-}
-
-func (s *sync) gatherHansoftIssues(h hansoft.Project) (map[int]*hIssue, error) {
-	tasks, err := h.Backlog().Tasks()
+// allDiffs is the list of all the issueDiffs, in the order they are written
+// to new hansoft tasks.
+var allDiffs = []issueDiff{
+	diffSummary,
+	diffID,
+	diffAssignee,
+	diffStatus,
+	diffDuration,
+	diffPriority,
+	diffMilestone,
+	diffSprint,
+	diffColumns,
+}
+
+// gatherHansoftIssues gathers all the hansoft tasks linked to monorail issues,
+// reading the fields of those that cannot be compared or read later by
+// readUnread().
+// Called by the updateHansoftIssues() goroutine, which is the only user of the
+// hansoft symbol tables while the monorail issues are streamed.
+func (s *Syncer) gatherHansoftIssues(h hansoft.Project) (*issueTable, error) {
+	linked, counts, err := h.Backlog().LinkedTasks(s.crbugPrefix)
 	if err != nil {
 		return nil, fmt.Errorf("Failed to fetch hansoft tasks: %w", err)
 	}
+	if counts.Malformed > 0 {
+		warn("%v hansoft tasks have a '%v' hyperlink that could not be parsed", counts.Malformed, s.crbugPrefix)
+	}
+	if counts.Unreadable > 0 {
+		warn("%v hansoft tasks have a hyperlink that could not be read", counts.Unreadable)
+	}
 
-	out := map[int]*hIssue{}
-	for _, task := range tasks {
-		hyperlink, err := task.Hyperlink()
-		if err != nil {
-			warn("Failed to get hansoft task url: %w", err)
-			continue
+	if err := s.resolveColumns(); err != nil {
+		return nil, err
+	}
+
+	// Tasks with a fingerprint are not read, unless they are due verification.
+	// The hansoft changes made before this Syncer's first full read were not
+	// observed through the change callbacks, so the fingerprints loaded from a
+	// previous process are only trusted after that read.
+	trust := s.fingerprints != nil && s.watched && time.Since(s.verified) < s.verifyInterval
+	s.verifying = s.fingerprints != nil && !trust
+
+	// Without custom columns, the other tasks are not read either, but are
+	// compared against their monorail issues by readUnread(). In chunked
+	// mode they are read by readUnread() as the chunk of their monorail
+	// issues is reconciled.
+	deferred := len(s.columns) == 0 || s.chunkSize > 0
+
+	out := &issueTable{rows: make([]hIssue, 0, len(linked))}
+	trusted := map[int]struct{}{}
+	read := make([]hansoft.LinkedTask, 0, len(linked))
+	for _, l := range linked {
+		_, ok := s.fingerprints[l.ID]
+		switch {
+		case ok && trust:
+			out.add(hIssue{Task: l.Task, id: l.ID, unread: true})
+			trusted[l.ID] = struct{}{}
+		case deferred:
+			out.add(hIssue{Task: l.Task, id: l.ID, unread: true})
+		default:
+			read = append(read, l)
 		}
-		if !strings.HasPrefix(hyperlink, s.crbugPrefix) {
-			continue
+	}
+	if s.fingerprints != nil {
+		for id := range s.fingerprints {
+			if _, ok := trusted[id]; !ok {
+				delete(s.fingerprints, id) // Read, or no longer in hansoft
+			}
 		}
-		id, err := strconv.Atoi(hyperlink[len(s.crbugPrefix):])
-		if err != nil {
-			warn("%v: Failed to parse bug ID from hyperlink '%v'", hyperlink, s.crbugPrefix)
-			continue
+	}
+	if len(s.synced) > 0 {
+		present := make(map[int]struct{}, len(linked))
+		for _, l := range linked {
+			present[l.ID] = struct{}{}
 		}
-		description, err := task.Description()
-		if err != nil {
-			warn("%v: Failed to get hansoft task description: %w", hyperlink, err)
-			continue
+		for id := range s.synced {
+			if _, ok := present[id]; !ok {
+				delete(s.synced, id)
+			}
 		}
-		assignee, err := task.Assignee()
-		if err != nil {
-			warn("%v: Failed to get hansoft task assignee: %w", hyperlink, err)
+	}
+
+	tasks := make([]hansoft.Task, len(read))
+	for i, l := range read {
+		tasks[i] = l.Task
+	}
+	snapshots, err := h.Backlog().Snapshot(tasks, s.columns...)
+	if err != nil {
+		return nil, fmt.Errorf("Failed to fetch hansoft task fields: %w", err)
+	}
+	for i, snap := range snapshots {
+		id := read[i].ID
+		if snap.Err != nil {
+			warn("%v%v: %w", s.crbugPrefix, id, snap.Err)
 			continue
 		}
-		status, err := task.Status()
-		if err != nil {
-			warn("%v: Failed to get hansoft task assignee: %w", hyperlink, err)
-			continue
+		out.add(s.hIssueFromSnapshot(id, snap))
+	}
+	out.order()
+	return out, nil
+}
+
+// applyHansoftChanges updates the cached hansoft issues with the changes made
+// to the hansoft project since the last Sync()
+func (s *Syncer) applyHansoftChanges(changes hansoft.Changes) error {
+	removed := map[int]struct{}{}
+	for _, t := range changes.Deleted {
+		if id, ok := s.bugIDs[t]; ok {
+			removed[id] = struct{}{}
+			delete(s.bugIDs, t)
+			delete(s.fingerprints, id)
+			delete(s.hansoftEdits, id)
+			delete(s.synced, id)
 		}
-		estimatedDuration, err := task.EstimatedDuration()
-		if err != nil {
-			warn("%v: Failed to get hansoft task estimated duration: %w", hyperlink, err)
+	}
+	if len(changes.Modified) == 0 {
+		s.issues.remove(removed)
+		return nil
+	}
+	snapshots, err := s.h.Backlog().Snapshot(changes.Modified, s.columns...)
+	if err != nil {
+		s.issues.remove(removed)
+		return fmt.Errorf("Failed to fetch hansoft task fields: %w", err)
+	}
+	added := []hIssue{}
+	for _, snap := range snapshots {
+		if id, ok := s.bugIDs[snap.Task]; ok {
+			removed[id] = struct{}{}
+			delete(s.bugIDs, snap.Task)
+		}
+		hyperlink := snap.Hyperlink
+		if hyperlink == "" && snap.Err != nil {
+			warn("%w", snap.Err)
 			continue
 		}
-		priority, err := task.Priority()
-		if err != nil {
-			warn("%v: Failed to get hansoft task priority: %w", hyperlink, err)
+		if !strings.HasPrefix(hyperlink, s.crbugPrefix) {
 			continue
 		}
-		milestone, err := task.Milestone()
-		if err != nil {
-			warn("%v: Failed to get hansoft task milestone: %w", hyperlink, err)
+		id, ok := hansoft.ParseBugID(hyperlink[len(s.crbugPrefix):])
+		if !ok {
+			warn("Failed to parse bug ID from hyperlink '%v'", hyperlink)
 			continue
 		}
-		sprint, err := task.Sprint()
-		if err != nil {
-			warn("%v: Failed to get hansoft task sprint: %w", hyperlink, err)
+		if snap.Err != nil {
+			warn("%v: %w", hyperlink, snap.Err)
 			continue
 		}
-		out[id] = &hIssue{
-			Task:              task,
-			id:                id,
-			summary:           description,
-			assignee:          assignee,
-			status:            status,
-			estimatedDuration: estimatedDuration,
-			priority:          priority,
-			milestone:         milestone,
-			sprint:            sprint,
+		added = append(added, s.hIssueFromSnapshot(id, snap))
+		s.bugIDs[snap.Task] = id
+		if times, ok := changes.FieldTimes[snap.Task]; ok {
+			s.recordHansoftEdits(id, times)
 		}
 	}
-	return out, nil
-}
-
-func (s *sync) gatherMonorailIssues(m monorail.Project) (map[int]*mIssue, error) {
-	issues, err := m.Issues()
-	if err != nil {
-		return nil, fmt.Errorf("Failed to fetch monorail issues: %w", err)
+	s.issues.remove(removed)
+	for _, h := range added {
+		s.issues.add(h)
 	}
+	s.issues.order()
+	return nil
+}
 
-	out := map[int]*mIssue{}
-	for _, i := range issues {
-		id := i.ID()
-		out[id] = &mIssue{
-			Issue:             i,
-			id:                id,
-			summary:           i.Summary(),
-			assignee:          i.Assignee(),
-			status:            i.Status(),
-			estimatedDuration: i.EstimatedDuration(),
-			priority:          i.Priority(),
-			milestone:         i.Milestone(),
-			sprint:            i.Sprint(),
-		}
+// hIssueFromSnapshot returns the issue of the task snapshot, interning its
+// hansoft values
+func (s *Syncer) hIssueFromSnapshot(id int, snap hansoft.TaskSnapshot) hIssue {
+	return hIssue{
+		Task:              snap.Task,
+		id:                id,
+		summary:           snap.Description,
+		assignee:          s.hResources.intern(snap.Assignee),
+		status:            s.hStatuses.intern(snap.Status),
+		estimatedDuration: snap.EstimatedDuration,
+		priority:          snap.Priority,
+		milestone:         s.hMilestones.intern(snap.Milestone),
+		sprint:            s.hSprints.intern(snap.Sprint),
+		columns:           snap.Columns,
 	}
-	return out, nil
 }
 
+// monorailStreamBuffer is the capacity of the channel used to stream monorail
+// issues into Sync()
+const monorailStreamBuffer = 1024
+
 func warn(msg string, args ...interface{}) {
 	err := fmt.Errorf(msg, args...)
 	log.Printf("warning: %v\n", err)
@@ -0,0 +1,58 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"fmt"
+	"testing"
+)
+
+func TestChunkBoundaries(t *testing.T) {
+	const issues = 23
+	for _, chunk := range []int{0, 1, 5, issues - 1, issues, issues + 1} {
+		t.Run(fmt.Sprintf("chunk-%v", chunk), func(t *testing.T) {
+			pair := newTestPair(issues)
+			s := New(pair.Monorail, pair.Hansoft)
+			s.SetChunkSize(chunk)
+
+			mustSync(t, s)
+			if got := phase(s, "diff").Issues; got != issues {
+				t.Errorf("Diffed %v issues, want %v", got, issues)
+			}
+			if got := phase(s, "create").Issues; got != issues {
+				t.Errorf("Created %v tasks, want %v", got, issues)
+			}
+			checkInSync(t, pair)
+			if chunk > 0 {
+				for _, h := range s.issues.rows {
+					if !h.unread {
+						t.Errorf("Task %v was not released after its chunk", h.id)
+					}
+				}
+			}
+
+			pair.Churn(0.3, 0.3)
+			mustSync(t, s)
+			checkInSync(t, pair)
+			mustSync(t, s)
+			if got := phase(s, "write").Issues; got != 0 {
+				t.Errorf("Wrote %v tasks with the projects in sync, want 0", got)
+			}
+			if got := phase(s, "create").Issues; got != 0 {
+				t.Errorf("Created %v tasks with the projects in sync, want 0", got)
+			}
+		})
+	}
+}
@@ -0,0 +1,169 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"context"
+	"fmt"
+	"runtime/pprof"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Phase is the time spent in one stage of a Sync(), and the number of issues
+// handled by the stage
+type Phase struct {
+	Name     string
+	Duration time.Duration
+	Issues   int
+}
+
+// Cycle is the phase breakdown of a single Sync(), as returned by
+// Syncer.LastCycle().
+//
+// The phases are:
+//
+//	hansoft-gather   applying the hansoft changes, or reading all the tasks
+//	monorail-stream  streaming and interning the monorail issues
+//	monorail-search  waiting for SearchIssues() pages, within monorail-stream
+//	monorail-users   resolving assignees with BatchGetUsers(), within
+//	                 monorail-stream. Issues is the number of users fetched.
+//	diff             matching and diffing the issues
+//	read-unread      reading the untrusted hansoft tasks
+//	create           creating the new hansoft tasks
+//	sprints          setting the sprints of the hansoft tasks
+//	write-back       writing the hansoft changes to monorail, see
+//	                 Syncer.SetWriteBack()
+//	order            re-ordering the issue table. Issues is the number of
+//	                 rows added by create.
+//	write            writing the fields of the hansoft tasks
+//
+// hansoft-gather and monorail-stream run concurrently. The time spent writing
+// is counted by write, and excluded from the other phases. In chunked mode,
+// see Syncer.SetChunkSize(), the phases from diff to order are repeated for
+// each chunk, and summed. The stream is not timed while a chunk is reconciled.
+type Cycle struct {
+	Project  string
+	Start    time.Time
+	Duration time.Duration
+	Phases   []Phase
+	Err      string `json:",omitempty"`
+}
+
+func (c Cycle) String() string {
+	sb := strings.Builder{}
+	fmt.Fprintf(&sb, "%v", c.Duration)
+	for _, p := range c.Phases {
+		fmt.Fprintf(&sb, ", %v %v (%v)", p.Name, p.Duration, p.Issues)
+	}
+	return sb.String()
+}
+
+// tracer records the phases of the Sync() in progress, and labels the
+// goroutines running each phase for pprof
+type tracer struct {
+	ctx       context.Context // Holds the project's pprof labels
+	mutex     sync.Mutex
+	cycle     Cycle
+	writeTime time.Duration // Time spent in wrote() calls
+	writes    int
+}
+
+// newTracer returns a tracer for a Sync() of the project. ctx holds the
+// project's pprof labels.
+func newTracer(ctx context.Context, project string) *tracer {
+	return &tracer{ctx: ctx, cycle: Cycle{Project: project, Start: time.Now()}}
+}
+
+// span is a phase in progress
+type span struct {
+	t         *tracer
+	name      string
+	start     time.Time
+	writeTime time.Duration // tracer.writeTime when the span began
+}
+
+// label labels the calling goroutine with the project and phase
+func (t *tracer) label(phase string) {
+	pprof.SetGoroutineLabels(pprof.WithLabels(t.ctx, pprof.Labels("phase", phase)))
+}
+
+// begin labels the calling goroutine with the phase, and starts timing it
+func (t *tracer) begin(phase string) span {
+	t.label(phase)
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	return span{t, phase, time.Now(), t.writeTime}
+}
+
+// end records the phase, which handled the given number of issues, and
+// removes the phase label from the calling goroutine
+func (s span) end(issues int) {
+	t := s.t
+	pprof.SetGoroutineLabels(t.ctx)
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	d := time.Since(s.start) - (t.writeTime - s.writeTime)
+	t.record(Phase{s.name, d, issues})
+}
+
+// add records a phase timed elsewhere
+func (t *tracer) add(p Phase) {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	t.record(p)
+}
+
+// record adds p to the cycle, summing it with any earlier phase of the same
+// name. Must be called with the mutex locked.
+func (t *tracer) record(p Phase) {
+	for i := range t.cycle.Phases {
+		if q := &t.cycle.Phases[i]; q.Name == p.Name {
+			q.Duration += p.Duration
+			q.Issues += p.Issues
+			return
+		}
+	}
+	t.cycle.Phases = append(t.cycle.Phases, p)
+}
+
+// wrote accounts for a write of a hansoft task that started at start
+func (t *tracer) wrote(start time.Time) {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	t.writeTime += time.Since(start)
+	t.writes++
+}
+
+// finish completes the cycle, and returns it
+func (t *tracer) finish(err error) Cycle {
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+	t.cycle.Phases = append(t.cycle.Phases, Phase{"write", t.writeTime, t.writes})
+	t.cycle.Duration = time.Since(t.cycle.Start)
+	if err != nil {
+		t.cycle.Err = err.Error()
+	}
+	return t.cycle
+}
+
+// LastCycle returns the phase breakdown of the last completed Sync(). Safe to
+// call concurrently with Sync().
+func (s *Syncer) LastCycle() Cycle {
+	s.lastCycleMutex.Lock()
+	defer s.lastCycleMutex.Unlock()
+	return s.lastCycle
+}
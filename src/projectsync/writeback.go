@@ -0,0 +1,260 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"hash/fnv"
+	"io"
+	"log"
+	"mhs/src/hansoft"
+	"mhs/src/monorail"
+	"strconv"
+	"time"
+)
+
+// writeBackField is a field that can be written back from hansoft to monorail
+type writeBackField struct {
+	hansoft  hansoft.FieldMask
+	monorail monorail.IssueFields
+	index    int // Index of the field in syncedFields
+}
+
+// writeBackFields are the issueDiffs that can be resolved in favor of hansoft.
+// Assignees, sprints and custom columns always take the monorail value.
+var writeBackFields = map[issueDiff]writeBackField{
+	diffSummary:   {hansoft.FieldDescription, monorail.FieldSummary, 0},
+	diffStatus:    {hansoft.FieldStatus, monorail.FieldStatus, 1},
+	diffDuration:  {hansoft.FieldEstimatedDuration, monorail.FieldEstimatedDuration, 2},
+	diffPriority:  {hansoft.FieldPriority, monorail.FieldPriority, 3},
+	diffMilestone: {hansoft.FieldMilestone, monorail.FieldMilestone, 4},
+}
+
+// syncedFields holds the hash of each writable monorail field of an issue, as
+// it was when the issue was last synchronized
+type syncedFields [syncedFieldCount]uint32
+
+const syncedFieldCount = 5
+
+// SetWriteBack enables or disables writing hansoft changes back to monorail.
+// When enabled, a field that differs between the projects takes the hansoft
+// value if it was changed in hansoft since the last Sync(), and either the
+// monorail field is unchanged since the issue was last synchronized, or the
+// hansoft change is newer than the monorail issue's last modification.
+// Monorail only has issue-level modification times, so when both projects
+// changed the field, any later change to the monorail issue, such as a
+// comment, makes monorail win. Hansoft changes made while the syncer was not
+// running are not seen as edits, and are overwritten by monorail. Only a
+// non-blocking hansoft session tells the syncer's own writes apart from
+// hansoft edits, so with a blocking session a monorail change made while the
+// issue is being written to hansoft can be reverted.
+// The monorail issues are updated in batches at the end of each Sync().
+// Must be called before LoadFingerprints(), which restores the write-back
+// state.
+func (s *Syncer) SetWriteBack(enabled bool) {
+	s.writeBack = enabled
+	s.hansoftEdits = nil
+	s.synced = nil
+	if enabled {
+		s.synced = map[int]syncedFields{}
+	}
+}
+
+// recordHansoftEdits records the times of the hansoft field changes of the
+// issue with the bug ID, for resolveConflicts()
+func (s *Syncer) recordHansoftEdits(id int, times hansoft.FieldTimes) {
+	if !s.writeBack {
+		return
+	}
+	if s.hansoftEdits == nil {
+		s.hansoftEdits = map[int]hansoft.FieldTimes{}
+	}
+	edits, ok := s.hansoftEdits[id]
+	if !ok {
+		edits = hansoft.FieldTimes{}
+		s.hansoftEdits[id] = edits
+	}
+	for f, t := range times {
+		edits[f] = t
+	}
+}
+
+// recordSynced records the writable monorail field values of the issue with
+// the bug ID as synchronized
+func (s *Syncer) recordSynced(id int, v monorail.IssueValues) {
+	if s.synced != nil {
+		s.synced[id] = hashFields(v)
+	}
+}
+
+// hashFields returns the syncedFields of the monorail field values
+func hashFields(v monorail.IssueValues) syncedFields {
+	values := [syncedFieldCount]string{
+		v.Summary,
+		string(v.Status),
+		strconv.FormatInt(int64(v.EstimatedDuration/time.Minute), 10),
+		string(v.Priority),
+		v.Milestone,
+	}
+	out := syncedFields{}
+	for i, value := range values {
+		f := fnv.New32a()
+		io.WriteString(f, value)
+		out[i] = f.Sum32()
+	}
+	return out
+}
+
+// resolveConflicts removes the diffs won by hansoft from diffs, queuing the
+// monorail update that writes them. The diffs left for writing to hansoft,
+// and the diffs won by hansoft, are returned.
+func (s *Syncer) resolveConflicts(h *hIssue, m *mIssue, diffs []issueDiff) (toHansoft, toMonorail []issueDiff) {
+	edits, ok := s.hansoftEdits[m.id]
+	if !ok || h.rewrite {
+		return diffs, nil
+	}
+	delete(s.hansoftEdits, m.id)
+
+	u := monorail.IssueUpdate{ID: m.id, Old: s.monorailValues(m)}
+	u.New = u.Old
+	synced, known := s.synced[m.id]
+	current := hashFields(u.Old)
+	won := hansoft.FieldTimes{}
+	toHansoft = make([]issueDiff, 0, len(diffs))
+	for _, d := range diffs {
+		f, ok := writeBackFields[d]
+		t, edited := edits[f.hansoft]
+		// Only changed in hansoft, or changed in both and hansoft is newer
+		hansoftWins := edited && ((known && synced[f.index] == current[f.index]) || t.After(m.modified))
+		if !ok || !hansoftWins || !s.setMonorailValue(&u.New, h, d) {
+			toHansoft = append(toHansoft, d)
+			continue
+		}
+		u.Fields |= f.monorail
+		won[f.hansoft] = t
+		toMonorail = append(toMonorail, d)
+	}
+	if u.Fields != 0 {
+		log.Printf("Updating monorail issue %s%v. Diffs: %v\n", s.crbugPrefix, m.id, toMonorail)
+		// Kept until the update is written, so a failed update is retried
+		s.hansoftEdits[m.id] = won
+		s.updates = append(s.updates, u)
+	}
+	return toHansoft, toMonorail
+}
+
+// monorailValues returns the writable field values of the monorail issue
+func (s *Syncer) monorailValues(m *mIssue) monorail.IssueValues {
+	return monorail.IssueValues{
+		Summary:           m.summary,
+		Status:            monorail.Status(s.mStatuses.name(m.status)),
+		Priority:          monorail.Priority(s.mPriorities.name(m.priority)),
+		EstimatedDuration: m.estimatedDuration,
+		Milestone:         s.mMilestones.name(m.milestone),
+	}
+}
+
+// setMonorailValue sets the field of v described by the diff to the monorail
+// equivalent of the hansoft issue's value. Returns false if the monorail
+// project cannot write the field, or the hansoft value has no monorail
+// equivalent that maps back to the same hansoft value, in which case the
+// monorail value is kept, so the projects do not flip-flop.
+func (s *Syncer) setMonorailValue(v *monorail.IssueValues, h *hIssue, d issueDiff) bool {
+	if f, ok := writeBackFields[d]; !ok || s.m.WritableFields()&f.monorail == 0 {
+		return false
+	}
+	switch d {
+	case diffSummary:
+		v.Summary = h.summary
+	case diffStatus:
+		hStatus := s.hStatuses.name(h.status)
+		status, ok := s.statusHtoM[hStatus]
+		if !ok || s.statusMtoH[status] != hStatus {
+			return false
+		}
+		v.Status = status
+	case diffPriority:
+		priority, ok := s.priorityHtoM[h.priority]
+		// An issue without a priority label is decoded as medium priority
+		if !ok || priority == "" || s.priorityMtoH[priority] != h.priority {
+			return false
+		}
+		v.Priority = priority
+	case diffDuration:
+		// Monorail estimates are in whole hours
+		if h.estimatedDuration%time.Hour != 0 {
+			return false
+		}
+		v.EstimatedDuration = h.estimatedDuration
+	case diffMilestone:
+		v.Milestone = ""
+		if milestone := s.milestone(h.milestone); milestone != nil {
+			name, err := milestone.Name()
+			if err != nil || s.milestones[name] != milestone {
+				return false
+			}
+			v.Milestone = name
+		}
+	default:
+		return false
+	}
+	return true
+}
+
+// keepHansoftValues restores the fields of h won by hansoft from saved, the
+// issue before it was assigned the monorail values
+func keepHansoftValues(h, saved *hIssue, won []issueDiff) {
+	for _, d := range won {
+		switch d {
+		case diffSummary:
+			h.summary = saved.summary
+		case diffStatus:
+			h.status = saved.status
+		case diffPriority:
+			h.priority = saved.priority
+		case diffDuration:
+			h.estimatedDuration = saved.estimatedDuration
+		case diffMilestone:
+			h.milestone = saved.milestone
+		}
+	}
+}
+
+// writeMonorailIssues writes the monorail updates queued by resolveConflicts()
+// in batches. The hansoft changes of the updates that fail are kept, so that
+// they are written by the next Sync().
+func (s *Syncer) writeMonorailIssues() {
+	if len(s.updates) == 0 {
+		return
+	}
+	updates := s.updates
+	s.updates = nil
+	failed, err := s.m.UpdateIssues(updates)
+	if err != nil {
+		warn("Failed to update %v monorail issues: %w", len(failed), err)
+	}
+	retry := make(map[int]struct{}, len(failed))
+	for _, u := range failed {
+		retry[u.ID] = struct{}{}
+	}
+	for _, u := range updates {
+		// The hansoft task no longer matches the fingerprinted monorail
+		// issue, and must be re-read if the update is to be retried
+		delete(s.fingerprints, u.ID)
+		if _, ok := retry[u.ID]; !ok {
+			delete(s.hansoftEdits, u.ID)
+			s.recordSynced(u.ID, u.New)
+		}
+	}
+}
@@ -0,0 +1,146 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package projectsync
+
+import (
+	"mhs/src/fake"
+	"mhs/src/hansoft"
+	"mhs/src/monorail"
+	"path/filepath"
+	"reflect"
+	"testing"
+	"time"
+)
+
+// newWriteBackSyncer returns a new fake project pair, synchronized by the
+// returned Syncer with write-back enabled
+func newWriteBackSyncer(t *testing.T) (*Syncer, *fake.Pair) {
+	t.Helper()
+	pair := newTestPair(10)
+	s := New(pair.Monorail, pair.Hansoft)
+	s.SetWriteBack(true)
+	mustSync(t, s)
+	return s, pair
+}
+
+// checkSummary fails the test if the monorail issue and hansoft task with the
+// bug ID do not both have the summary
+func checkSummary(t *testing.T, pair *fake.Pair, id int, want string) {
+	t.Helper()
+	if got := summaries(t, pair)[id]; got != want {
+		t.Errorf("Issue %v summary is '%v', want '%v'", id, got, want)
+	}
+	if got := descriptions(t, pair)[id]; got != want {
+		t.Errorf("Task %v description is '%v', want '%v'", id, got, want)
+	}
+}
+
+func TestWriteBackHansoftEdit(t *testing.T) {
+	s, pair := newWriteBackSyncer(t)
+	pair.EditHansoftDescription(1, "Edited in hansoft", time.Now())
+	mustSync(t, s)
+	checkSummary(t, pair, 1, "Edited in hansoft")
+	if got := phase(s, "write-back").Issues; got != 1 {
+		t.Errorf("Wrote back %v issues, want 1", got)
+	}
+}
+
+func TestWriteBackHansoftEditBeforeComment(t *testing.T) {
+	// A comment bumps the modification time of the issue, but does not
+	// change the summary, so the hansoft edit is not in conflict
+	s, pair := newWriteBackSyncer(t)
+	now := time.Now()
+	pair.EditHansoftDescription(1, "Edited in hansoft", now)
+	pair.TouchMonorail(1, now.Add(time.Minute))
+	mustSync(t, s)
+	checkSummary(t, pair, 1, "Edited in hansoft")
+}
+
+func TestWriteBackConflictNewerHansoftEdit(t *testing.T) {
+	s, pair := newWriteBackSyncer(t)
+	now := time.Now()
+	pair.EditMonorailSummary(1, "Edited in monorail", now)
+	pair.EditHansoftDescription(1, "Edited in hansoft", now.Add(time.Minute))
+	mustSync(t, s)
+	checkSummary(t, pair, 1, "Edited in hansoft")
+}
+
+func TestWriteBackConflictNewerMonorailEdit(t *testing.T) {
+	s, pair := newWriteBackSyncer(t)
+	now := time.Now()
+	pair.EditHansoftDescription(1, "Edited in hansoft", now)
+	pair.EditMonorailSummary(1, "Edited in monorail", now.Add(time.Minute))
+	mustSync(t, s)
+	checkSummary(t, pair, 1, "Edited in monorail")
+	if got := phase(s, "write-back").Issues; got != 0 {
+		t.Errorf("Wrote back %v issues, want 0", got)
+	}
+}
+
+func TestWriteBackReadOnlyField(t *testing.T) {
+	s, pair := newWriteBackSyncer(t)
+	pair.Monorail.ReadOnly = monorail.FieldSummary
+	summary := summaries(t, pair)[1]
+	pair.EditHansoftDescription(1, "Edited in hansoft", time.Now())
+	mustSync(t, s)
+	checkSummary(t, pair, 1, summary)
+	if got := phase(s, "write-back").Issues; got != 0 {
+		t.Errorf("Wrote back %v issues, want 0", got)
+	}
+}
+
+func TestWriteBackDisabled(t *testing.T) {
+	pair := newTestPair(10)
+	s := New(pair.Monorail, pair.Hansoft)
+	mustSync(t, s)
+	summary := summaries(t, pair)[1]
+	pair.EditHansoftDescription(1, "Edited in hansoft", time.Now())
+	mustSync(t, s)
+	checkSummary(t, pair, 1, summary)
+}
+
+func TestWriteBackStatePersisted(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "fingerprints.bin")
+	s, pair := newWriteBackSyncer(t)
+	if err := s.LoadFingerprints(path, time.Hour); err != nil {
+		t.Fatalf("LoadFingerprints() returned %v", err)
+	}
+	mustSync(t, s)
+	edited := time.Unix(0, time.Now().UnixNano())
+	s.recordHansoftEdits(2, hansoft.FieldTimes{hansoft.FieldStatus: edited})
+	if err := s.SaveFingerprints(path); err != nil {
+		t.Fatalf("SaveFingerprints() returned %v", err)
+	}
+
+	loaded := New(pair.Monorail, pair.Hansoft)
+	loaded.SetWriteBack(true)
+	if err := loaded.LoadFingerprints(path, time.Hour); err != nil {
+		t.Fatalf("LoadFingerprints() returned %v", err)
+	}
+	if len(loaded.synced) != 10 || !reflect.DeepEqual(loaded.synced, s.synced) {
+		t.Errorf("Loaded synced fields %v, want %v", loaded.synced, s.synced)
+	}
+	if got := loaded.hansoftEdits[2][hansoft.FieldStatus]; !got.Equal(edited) {
+		t.Errorf("Loaded hansoft edit time %v, want %v", got, edited)
+	}
+
+	disabled := New(pair.Monorail, pair.Hansoft)
+	if err := disabled.LoadFingerprints(path, time.Hour); err != nil {
+		t.Fatalf("LoadFingerprints() returned %v", err)
+	}
+	if disabled.synced != nil || disabled.hansoftEdits != nil {
+		t.Errorf("Loaded the write-back state with write-back disabled")
+	}
+}